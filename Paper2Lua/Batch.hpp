@@ -0,0 +1,126 @@
+#ifndef PAPERLUA_BATCH_HPP
+#define PAPERLUA_BATCH_HPP
+
+#include <Paper2/Document.hpp>
+#include <Paper2/Path.hpp>
+#include <Paper2Lua/Parallel.hpp>
+
+namespace paperLua
+{
+    namespace detail
+    {
+        using namespace paper;
+
+        //reserves room for _count segments in _path, so appending them one by one doesn't grow
+        //the segment and curve arrays over and over. Versions of paper without
+        //Path::reserveSegmentCapacity take the overload below, which does nothing.
+        template<class P>
+        inline auto reserveSegments(P * _path, Size _count, int) -> decltype(_path->reserveSegmentCapacity(_count), void())
+        {
+            _path->reserveSegmentCapacity(_count);
+        }
+
+        template<class P>
+        inline void reserveSegments(P *, Size, long)
+        {
+        }
+
+        inline void reserveSegments(Path * _path, Size _count)
+        {
+            reserveSegments(_path, _count, 0);
+        }
+
+        struct SegmentData
+        {
+            Vec2f position;
+            Vec2f handleIn;
+            Vec2f handleOut;
+        };
+
+        //plain copy of the geometry of a path, so it can be processed without touching the
+        //document the path belongs to.
+        struct PathData
+        {
+            void read(Path * _path)
+            {
+                Size count = _path->segmentCount();
+                segments.resize(count);
+                for (Size i = 0; i < count; ++i)
+                {
+                    Segment seg = _path->segment(i);
+                    segments[i] = SegmentData{seg.position(), seg.handleIn(), seg.handleOut()};
+                }
+                bClosed = _path->isClosed();
+            }
+
+            //replaces the segments of _path with the ones stored here
+            void write(Path * _path) const
+            {
+                Size count = segments.count();
+                Size existing = _path->segmentCount();
+                if (count > existing)
+                    reserveSegments(_path, count);
+                for (Size i = 0; i < count; ++i)
+                {
+                    const SegmentData & data = segments[i];
+                    if (i < existing)
+                    {
+                        Segment seg = _path->segment(i);
+                        seg.setPosition(data.position);
+                        seg.setHandleIn(data.handleIn);
+                        seg.setHandleOut(data.handleOut);
+                    }
+                    else
+                        _path->addSegment(data.position, data.handleIn, data.handleOut);
+                }
+                if (existing > count)
+                    _path->removeSegments(count);
+                if (bClosed && !_path->isClosed())
+                    _path->closePath();
+            }
+
+            stick::DynamicArray<SegmentData> segments;
+            bool bClosed;
+        };
+
+        //Runs _op(Path *) on every entry of _paths on up to _threadCount threads of _pool and
+        //stores the results back into _paths. The paths are rebuilt from the copied data on a
+        //scratch document that is private to each worker, so the documents the data came from
+        //are never touched off the calling thread. Every path is processed independently from the
+        //same input, so the results don't depend on the number of threads.
+        template<class F>
+        inline void batchProcess(WorkerPool & _pool, stick::DynamicArray<PathData> & _paths, Size _threadCount, F _op)
+        {
+            //chunks of a few paths, so workers don't fight over the counter
+            static const Size grainSize = 8;
+
+            Size count = _paths.count();
+            _threadCount = std::min(_threadCount, (count + grainSize - 1) / grainSize);
+            std::atomic<Size> next(0);
+            auto worker = [&](Size)
+            {
+                Document scratch;
+                for (;;)
+                {
+                    Size begin = next.fetch_add(grainSize);
+                    if (begin >= count)
+                        break;
+                    for (Size i = begin; i < std::min(begin + grainSize, count); ++i)
+                    {
+                        Path * tmp = scratch.createPath();
+                        for (const SegmentData & data : _paths[i].segments)
+                            tmp->addSegment(data.position, data.handleIn, data.handleOut);
+                        if (_paths[i].bClosed)
+                            tmp->closePath();
+                        _op(tmp);
+                        _paths[i].read(tmp);
+                        tmp->remove();
+                    }
+                }
+            };
+            _pool.run(_threadCount, worker);
+        }
+    }
+}
+
+#endif //PAPERLUA_BATCH_HPP
@@ -0,0 +1,685 @@
+#ifndef PAPERLUA_BINARYFORMAT_HPP
+#define PAPERLUA_BINARYFORMAT_HPP
+
+#include <Paper2/Document.hpp>
+#include <Paper2/Group.hpp>
+#include <Paper2/Path.hpp>
+#include <Paper2Lua/MappedFile.hpp>
+#include <Stick/DynamicArray.hpp>
+#include <Stick/HashMap.hpp>
+#include <Stick/String.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+//Binary document format
+//
+//A fixed size header followed by sections of fixed size records, each section starts at an
+//8 byte aligned offset stored in the header:
+//items     one BinaryItem per group or path in pre order, so parents come before their children
+//styles    deduplicated BinaryStyle records referenced by the items
+//segments  six floats per segment (position, handleIn, handleOut), contiguous per path
+//stops     gradient stops referenced by the paints of the styles
+//floats    dash arrays referenced by the styles
+//chars     item names referenced by the items
+//The records are plain data in native byte order. The header contains a byte order mark, files
+//written on a machine with a different byte order are rejected. Loading maps the file and reads
+//the records in place.
+
+namespace paperLua
+{
+    namespace detail
+    {
+        using namespace paper;
+
+        static const char s_binaryMagic[4] = {'P', 'L', 'B', 'D'};
+        static const stick::UInt32 s_binaryByteOrderMark = 0x01020304;
+        //bump when the layout of any record changes, older files are rejected
+        static const stick::UInt32 s_binaryVersion = 2;
+        static const stick::UInt32 s_binaryNone = 0xFFFFFFFF;
+
+        enum BinarySection
+        {
+            BinarySectionItems,
+            BinarySectionStyles,
+            BinarySectionSegments,
+            BinarySectionStops,
+            BinarySectionFloats,
+            BinarySectionChars,
+            BinarySectionCount
+        };
+
+        struct BinaryHeader
+        {
+            char magic[4];
+            stick::UInt32 byteOrderMark;
+            stick::UInt32 version;
+            stick::UInt32 headerSize;
+            float width;
+            float height;
+            stick::UInt64 offsets[BinarySectionCount];
+            stick::UInt64 counts[BinarySectionCount];
+        };
+
+        enum BinaryItemType : stick::UInt8
+        {
+            BinaryItemGroup,
+            BinaryItemPath
+        };
+
+        enum BinaryItemFlags : stick::UInt8
+        {
+            BinaryItemVisible = 1,
+            BinaryItemClosed = 2,
+            BinaryItemClipped = 4
+        };
+
+        struct BinaryItem
+        {
+            stick::UInt8 type;
+            stick::UInt8 flags;
+            stick::UInt16 reserved;
+            //index of the parent item, s_binaryNone for children of the document
+            stick::UInt32 parent;
+            stick::UInt32 style;
+            stick::UInt32 nameOffset;
+            stick::UInt32 nameLength;
+            stick::UInt32 firstSegment;
+            stick::UInt32 segmentCount;
+            float transform[6];
+        };
+
+        enum BinaryPaintType : stick::UInt32
+        {
+            BinaryPaintNone,
+            BinaryPaintColor,
+            BinaryPaintLinearGradient,
+            BinaryPaintRadialGradient
+        };
+
+        struct BinaryPaint
+        {
+            stick::UInt32 type;
+            float color[4];
+            float origin[2];
+            float destination[2];
+            float focalPointOffset[2];
+            float ratio;
+            stick::UInt32 firstStop;
+            stick::UInt32 stopCount;
+        };
+
+        struct BinaryStyle
+        {
+            BinaryPaint fill;
+            BinaryPaint stroke;
+            float strokeWidth;
+            float miterLimit;
+            float dashOffset;
+            stick::UInt32 firstDash;
+            stick::UInt32 dashCount;
+            stick::UInt8 strokeJoin;
+            stick::UInt8 strokeCap;
+            stick::UInt8 windingRule;
+            stick::UInt8 bScaleStroke;
+        };
+
+        struct BinaryStop
+        {
+            float color[4];
+            float offset;
+        };
+
+        //appends _count bytes to a byte array
+        inline void appendBytes(stick::DynamicArray<char> & _array, const void * _data, Size _count)
+        {
+            if (!_count)
+                return;
+            Size offset = _array.count();
+            _array.resize(offset + _count);
+            std::memcpy(&_array[offset], _data, _count);
+        }
+
+        template<class T>
+        inline const T * arrayData(const stick::DynamicArray<T> & _array)
+        {
+            return _array.count() ? &_array[0] : nullptr;
+        }
+
+        inline stick::String formatError(const char * _format, const char * _arg)
+        {
+            char buf[512];
+            std::snprintf(buf, sizeof(buf), _format, _arg);
+            return stick::String(buf);
+        }
+
+        class BinaryWriter
+        {
+        public:
+
+            bool save(Document * _document, const char * _path, stick::String & _outError)
+            {
+                m_items.clear();
+                m_styles.clear();
+                m_styleIndices.clear();
+                m_segments.clear();
+                m_stops.clear();
+                m_floats.clear();
+                m_chars.clear();
+
+                collect(_document, s_binaryNone);
+
+                BinaryHeader header;
+                std::memset(&header, 0, sizeof(header));
+                std::memcpy(header.magic, s_binaryMagic, sizeof(s_binaryMagic));
+                header.byteOrderMark = s_binaryByteOrderMark;
+                header.version = s_binaryVersion;
+                header.headerSize = sizeof(BinaryHeader);
+                header.width = _document->width();
+                header.height = _document->height();
+
+                const void * data[BinarySectionCount] =
+                {
+                    arrayData(m_items), arrayData(m_styles), arrayData(m_segments), arrayData(m_stops),
+                    arrayData(m_floats), arrayData(m_chars)
+                };
+                Size byteCounts[BinarySectionCount] =
+                {
+                    m_items.count() * sizeof(BinaryItem), m_styles.count() * sizeof(BinaryStyle),
+                    m_segments.count() * sizeof(float), m_stops.count() * sizeof(BinaryStop),
+                    m_floats.count() * sizeof(float), m_chars.count()
+                };
+                header.counts[BinarySectionItems] = m_items.count();
+                header.counts[BinarySectionStyles] = m_styles.count();
+                header.counts[BinarySectionSegments] = m_segments.count() / 6;
+                header.counts[BinarySectionStops] = m_stops.count();
+                header.counts[BinarySectionFloats] = m_floats.count();
+                header.counts[BinarySectionChars] = m_chars.count();
+
+                stick::UInt64 offset = alignOffset(sizeof(BinaryHeader));
+                for (Int32 i = 0; i < BinarySectionCount; ++i)
+                {
+                    header.offsets[i] = offset;
+                    offset = alignOffset(offset + byteCounts[i]);
+                }
+
+                FILE * file = std::fopen(_path, "wb");
+                if (!file)
+                {
+                    _outError = formatError("could not open %s for writing", _path);
+                    return false;
+                }
+
+                static const char s_padding[8] = {0};
+                bool bOk = std::fwrite(&header, sizeof(header), 1, file) == 1;
+                stick::UInt64 written = sizeof(header);
+                for (Int32 i = 0; bOk && i < BinarySectionCount; ++i)
+                {
+                    bOk = std::fwrite(s_padding, 1, header.offsets[i] - written, file) == header.offsets[i] - written;
+                    if (bOk && byteCounts[i])
+                        bOk = std::fwrite(data[i], 1, byteCounts[i], file) == byteCounts[i];
+                    written = header.offsets[i] + byteCounts[i];
+                }
+
+                if (std::fclose(file) != 0)
+                    bOk = false;
+                if (!bOk)
+                    _outError = formatError("writing %s failed", _path);
+                return bOk;
+            }
+
+        private:
+
+            static stick::UInt64 alignOffset(stick::UInt64 _offset)
+            {
+                return (_offset + 7) & ~(stick::UInt64)7;
+            }
+
+            void collect(Item * _item, stick::UInt32 _parent)
+            {
+                for (Item * child : _item->children())
+                {
+                    ItemType type = child->itemType();
+                    if (type != ItemType::Group && type != ItemType::Path)
+                        continue;
+
+                    BinaryItem record;
+                    std::memset(&record, 0, sizeof(record));
+                    record.type = type == ItemType::Group ? BinaryItemGroup : BinaryItemPath;
+                    record.flags = child->isVisible() ? BinaryItemVisible : 0;
+                    record.parent = _parent;
+                    record.style = styleIndex(child);
+                    const Mat32f & transform = child->transform();
+                    for (Int32 i = 0; i < 3; ++i)
+                    {
+                        record.transform[i * 2] = transform[i].x;
+                        record.transform[i * 2 + 1] = transform[i].y;
+                    }
+                    const stick::String & name = child->name();
+                    record.nameOffset = (stick::UInt32)m_chars.count();
+                    record.nameLength = (stick::UInt32)name.length();
+                    appendBytes(m_chars, name.cString(), name.length());
+
+                    if (type == ItemType::Group)
+                    {
+                        if (static_cast<Group *>(child)->isClipped())
+                            record.flags |= BinaryItemClipped;
+                    }
+                    else
+                    {
+                        Path * path = static_cast<Path *>(child);
+                        if (path->isClosed())
+                            record.flags |= BinaryItemClosed;
+                        record.firstSegment = (stick::UInt32)(m_segments.count() / 6);
+                        record.segmentCount = (stick::UInt32)path->segmentCount();
+                        for (Size i = 0; i < path->segmentCount(); ++i)
+                        {
+                            Segment seg = path->segment(i);
+                            Vec2f data[3] = {seg.position(), seg.handleIn(), seg.handleOut()};
+                            for (const Vec2f & v : data)
+                            {
+                                m_segments.append(v.x);
+                                m_segments.append(v.y);
+                            }
+                        }
+                    }
+
+                    stick::UInt32 index = (stick::UInt32)m_items.count();
+                    m_items.append(record);
+                    if (type == ItemType::Group)
+                        collect(child, index);
+                }
+            }
+
+            void writeColor(float * _out, const ColorRGBA & _color)
+            {
+                _out[0] = _color.r;
+                _out[1] = _color.g;
+                _out[2] = _color.b;
+                _out[3] = _color.a;
+            }
+
+            //stops are stored per use, equal styles still end up sharing them through the
+            //style deduplication
+            BinaryPaint paint(bool _bHasPaint, const Paint & _paint)
+            {
+                BinaryPaint ret;
+                std::memset(&ret, 0, sizeof(ret));
+                ret.type = BinaryPaintNone;
+                if (!_bHasPaint)
+                    return ret;
+
+                BaseGradient * gradient = nullptr;
+                if (_paint.is<ColorRGBA>())
+                {
+                    ret.type = BinaryPaintColor;
+                    writeColor(ret.color, _paint.get<ColorRGBA>());
+                }
+                else if (_paint.is<LinearGradientPtr>())
+                {
+                    ret.type = BinaryPaintLinearGradient;
+                    gradient = _paint.get<LinearGradientPtr>().get();
+                }
+                else if (_paint.is<RadialGradientPtr>())
+                {
+                    RadialGradient * radial = _paint.get<RadialGradientPtr>().get();
+                    ret.type = BinaryPaintRadialGradient;
+                    ret.focalPointOffset[0] = radial->focalPointOffset().x;
+                    ret.focalPointOffset[1] = radial->focalPointOffset().y;
+                    ret.ratio = radial->ratio();
+                    gradient = radial;
+                }
+
+                if (gradient)
+                {
+                    ret.origin[0] = gradient->origin().x;
+                    ret.origin[1] = gradient->origin().y;
+                    ret.destination[0] = gradient->destination().x;
+                    ret.destination[1] = gradient->destination().y;
+                    ret.firstStop = (stick::UInt32)m_stops.count();
+                    for (const ColorStop & stop : gradient->stops())
+                    {
+                        BinaryStop s;
+                        writeColor(s.color, stop.color);
+                        s.offset = stop.offset;
+                        m_stops.append(s);
+                    }
+                    ret.stopCount = (stick::UInt32)(m_stops.count() - ret.firstStop);
+                }
+                return ret;
+            }
+
+            //groups have a style of their own as well, so every item gets one
+            stick::UInt32 styleIndex(Item * _item)
+            {
+                BinaryStyle style;
+                std::memset(&style, 0, sizeof(style));
+                Size stopCount = m_stops.count();
+                style.fill = paint(_item->hasFill(), _item->fill());
+                style.stroke = paint(_item->hasStroke(), _item->stroke());
+                style.strokeWidth = _item->strokeWidth();
+                style.miterLimit = _item->miterLimit();
+                style.dashOffset = _item->dashOffset();
+                style.strokeJoin = (stick::UInt8)_item->strokeJoin();
+                style.strokeCap = (stick::UInt8)_item->strokeCap();
+                style.windingRule = (stick::UInt8)_item->windingRule();
+                style.bScaleStroke = _item->scaleStroke();
+                Size floatCount = m_floats.count();
+                style.firstDash = (stick::UInt32)floatCount;
+                for (Float dash : _item->dashArray())
+                    m_floats.append(dash);
+                style.dashCount = (stick::UInt32)(m_floats.count() - floatCount);
+
+                //styles are looked up by a hash of everything but the array offsets, which differ
+                //for every new style, and compared in full on a hit
+                BinaryStyle key = withoutOffsets(style);
+                stick::UInt64 hash = 14695981039346656037ULL;
+                mixHash(hash, &key, sizeof(key));
+                mixHash(hash, arrayData(m_stops) + stopCount, (m_stops.count() - stopCount) * sizeof(BinaryStop));
+                mixHash(hash, arrayData(m_floats) + floatCount, (m_floats.count() - floatCount) * sizeof(float));
+
+                auto it = m_styleIndices.find(hash);
+                if (it != m_styleIndices.end() && sameStyle(m_styles[it->value], style))
+                {
+                    m_stops.resize(stopCount);
+                    m_floats.resize(floatCount);
+                    return it->value;
+                }
+
+                stick::UInt32 ret = (stick::UInt32)m_styles.count();
+                m_styles.append(style);
+                //on a hash collision the first style keeps the entry, the other one is just not shared
+                if (it == m_styleIndices.end())
+                    m_styleIndices.insert(hash, ret);
+                return ret;
+            }
+
+            static BinaryStyle withoutOffsets(const BinaryStyle & _style)
+            {
+                BinaryStyle ret = _style;
+                ret.fill.firstStop = ret.stroke.firstStop = ret.firstDash = 0;
+                return ret;
+            }
+
+            static void mixHash(stick::UInt64 & _hash, const void * _data, Size _byteCount)
+            {
+                const stick::UInt8 * bytes = static_cast<const stick::UInt8 *>(_data);
+                for (Size i = 0; i < _byteCount; ++i)
+                {
+                    _hash ^= bytes[i];
+                    _hash *= 1099511628211ULL;
+                }
+            }
+
+            //_b is the style that was just added, its stops and dashes are at the end of the arrays
+            bool sameStyle(const BinaryStyle & _a, const BinaryStyle & _b) const
+            {
+                BinaryStyle a = withoutOffsets(_a);
+                BinaryStyle b = withoutOffsets(_b);
+                return std::memcmp(&a, &b, sizeof(a)) == 0 &&
+                       sameRange(m_stops, _a.fill.firstStop, _b.fill.firstStop, _a.fill.stopCount) &&
+                       sameRange(m_stops, _a.stroke.firstStop, _b.stroke.firstStop, _a.stroke.stopCount) &&
+                       sameRange(m_floats, _a.firstDash, _b.firstDash, _a.dashCount);
+            }
+
+            template<class T>
+            static bool sameRange(const stick::DynamicArray<T> & _array, Size _a, Size _b, Size _count)
+            {
+                return !_count || std::memcmp(&_array[_a], &_array[_b], _count * sizeof(T)) == 0;
+            }
+
+            stick::DynamicArray<BinaryItem> m_items;
+            stick::DynamicArray<BinaryStyle> m_styles;
+            stick::HashMap<stick::UInt64, stick::UInt32> m_styleIndices;
+            stick::DynamicArray<float> m_segments;
+            stick::DynamicArray<BinaryStop> m_stops;
+            stick::DynamicArray<float> m_floats;
+            stick::DynamicArray<char> m_chars;
+        };
+
+        //generic lambdas would need C++14, so the paints are applied through these functors
+        struct BinaryFillSetter
+        {
+            template<class P>
+            void operator()(const P & _paint) const { item->setFill(_paint); }
+
+            Item * item;
+        };
+
+        struct BinaryStrokeSetter
+        {
+            template<class P>
+            void operator()(const P & _paint) const { item->setStroke(_paint); }
+
+            Item * item;
+        };
+
+        class BinaryReader
+        {
+        public:
+
+            //the temporary arrays of load are allocated with _alloc
+            explicit BinaryReader(stick::Allocator & _alloc = stick::defaultAllocator()) :
+                m_alloc(&_alloc)
+            {
+            }
+
+            //adds the items stored in _path to _document
+            bool load(Document * _document, const char * _path, stick::String & _outError)
+            {
+                if (!m_file.open(_path))
+                {
+                    _outError = formatError("could not open %s", _path);
+                    return false;
+                }
+
+                if (!validate(_outError))
+                    return false;
+
+                const BinaryHeader & header = *reinterpret_cast<const BinaryHeader *>(m_file.data());
+                _document->setSize(header.width, header.height);
+
+                const BinaryItem * items = section<BinaryItem>(BinarySectionItems);
+                Size itemCount = header.counts[BinarySectionItems];
+                stick::DynamicArray<Item *> created(*m_alloc);
+                created.resize(itemCount);
+                for (Size i = 0; i < itemCount; ++i)
+                {
+                    const BinaryItem & record = items[i];
+                    Item * item;
+                    if (record.type == BinaryItemGroup)
+                    {
+                        Group * group = _document->createGroup();
+                        group->setClipped(record.flags & BinaryItemClipped);
+                        item = group;
+                    }
+                    else
+                    {
+                        Path * path = _document->createPath();
+                        const float * seg = section<float>(BinarySectionSegments) + (Size)record.firstSegment * 6;
+                        for (Size j = 0; j < record.segmentCount; ++j, seg += 6)
+                            path->addSegment(Vec2f(seg[0], seg[1]), Vec2f(seg[2], seg[3]), Vec2f(seg[4], seg[5]));
+                        if (record.flags & BinaryItemClosed)
+                            path->closePath();
+                        item = path;
+                    }
+
+                    //parents come first in the file, so their style is set before children are added
+                    applyStyle(item, section<BinaryStyle>(BinarySectionStyles)[record.style]);
+
+                    if (record.nameLength)
+                        item->setName(stick::String(section<char>(BinarySectionChars) + record.nameOffset, (Size)record.nameLength));
+                    item->setTransform(Mat32f(Vec2f(record.transform[0], record.transform[1]),
+                                              Vec2f(record.transform[2], record.transform[3]),
+                                              Vec2f(record.transform[4], record.transform[5])));
+                    if (!(record.flags & BinaryItemVisible))
+                        item->setVisible(false);
+                    if (record.parent != s_binaryNone)
+                        created[record.parent]->addChild(item);
+                    created[i] = item;
+                }
+
+                m_file.close();
+                return true;
+            }
+
+        private:
+
+            template<class T>
+            const T * section(BinarySection _section) const
+            {
+                const BinaryHeader & header = *reinterpret_cast<const BinaryHeader *>(m_file.data());
+                return reinterpret_cast<const T *>(m_file.data() + header.offsets[_section]);
+            }
+
+            //checks the header and that every reference in the file points into its section, so
+            //corrupt files can't make the loader read out of bounds.
+            bool validate(stick::String & _outError) const
+            {
+                if (m_file.size() < sizeof(BinaryHeader))
+                {
+                    _outError = "file too small";
+                    return false;
+                }
+                const BinaryHeader & header = *reinterpret_cast<const BinaryHeader *>(m_file.data());
+                if (std::memcmp(header.magic, s_binaryMagic, sizeof(s_binaryMagic)) != 0)
+                {
+                    _outError = "not a binary paper document";
+                    return false;
+                }
+                if (header.byteOrderMark != s_binaryByteOrderMark)
+                {
+                    _outError = "the file was written with a different byte order";
+                    return false;
+                }
+                if (header.version != s_binaryVersion || header.headerSize != sizeof(BinaryHeader))
+                {
+                    char version[16];
+                    std::snprintf(version, sizeof(version), "%u", (unsigned)header.version);
+                    _outError = formatError("unsupported format version %s", version);
+                    return false;
+                }
+
+                static const Size s_recordSizes[BinarySectionCount] =
+                {
+                    sizeof(BinaryItem), sizeof(BinaryStyle), sizeof(float) * 6, sizeof(BinaryStop), sizeof(float), 1
+                };
+                for (Int32 i = 0; i < BinarySectionCount; ++i)
+                {
+                    stick::UInt64 offset = header.offsets[i];
+                    if (offset % 8 || offset > m_file.size() ||
+                            header.counts[i] > (m_file.size() - offset) / s_recordSizes[i])
+                    {
+                        _outError = "corrupt section table";
+                        return false;
+                    }
+                }
+
+                const stick::UInt64 * counts = header.counts;
+                const BinaryItem * items = section<BinaryItem>(BinarySectionItems);
+                for (Size i = 0; i < counts[BinarySectionItems]; ++i)
+                {
+                    const BinaryItem & item = items[i];
+                    bool bOk = item.type <= BinaryItemPath &&
+                               (item.parent == s_binaryNone || (item.parent < i && items[item.parent].type == BinaryItemGroup)) &&
+                               (stick::UInt64)item.nameOffset + item.nameLength <= counts[BinarySectionChars] &&
+                               item.style < counts[BinarySectionStyles];
+                    if (item.type == BinaryItemPath)
+                        bOk = bOk && (stick::UInt64)item.firstSegment + item.segmentCount <= counts[BinarySectionSegments];
+                    if (!bOk)
+                    {
+                        _outError = "corrupt item";
+                        return false;
+                    }
+                }
+
+                const BinaryStyle * styles = section<BinaryStyle>(BinarySectionStyles);
+                for (Size i = 0; i < counts[BinarySectionStyles]; ++i)
+                {
+                    const BinaryStyle & style = styles[i];
+                    if ((stick::UInt64)style.fill.firstStop + style.fill.stopCount > counts[BinarySectionStops] ||
+                            (stick::UInt64)style.stroke.firstStop + style.stroke.stopCount > counts[BinarySectionStops] ||
+                            (stick::UInt64)style.firstDash + style.dashCount > counts[BinarySectionFloats])
+                    {
+                        _outError = "corrupt style";
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            static ColorRGBA readColor(const float * _color)
+            {
+                return ColorRGBA(_color[0], _color[1], _color[2], _color[3]);
+            }
+
+            template<class G>
+            void addStops(G & _gradient, const BinaryPaint & _paint) const
+            {
+                const BinaryStop * stops = section<BinaryStop>(BinarySectionStops) + _paint.firstStop;
+                for (Size i = 0; i < _paint.stopCount; ++i)
+                    _gradient->addStop(readColor(stops[i].color), stops[i].offset);
+            }
+
+            //calls _setter with the paint, or returns false if there is none
+            template<class F>
+            bool readPaint(const BinaryPaint & _paint, F _setter) const
+            {
+                Vec2f origin(_paint.origin[0], _paint.origin[1]);
+                Vec2f destination(_paint.destination[0], _paint.destination[1]);
+                switch (_paint.type)
+                {
+                case BinaryPaintColor:
+                    _setter(readColor(_paint.color));
+                    return true;
+                case BinaryPaintLinearGradient:
+                {
+                    LinearGradientPtr gradient = createLinearGradient(origin, destination);
+                    addStops(gradient, _paint);
+                    _setter(gradient);
+                    return true;
+                }
+                case BinaryPaintRadialGradient:
+                {
+                    RadialGradientPtr gradient = createRadialGradient(origin, destination);
+                    gradient->setFocalPointOffset(Vec2f(_paint.focalPointOffset[0], _paint.focalPointOffset[1]));
+                    gradient->setRatio(_paint.ratio);
+                    addStops(gradient, _paint);
+                    _setter(gradient);
+                    return true;
+                }
+                default:
+                    return false;
+                }
+            }
+
+            void applyStyle(Item * _item, const BinaryStyle & _style) const
+            {
+                if (!readPaint(_style.fill, BinaryFillSetter{_item}))
+                    _item->removeFill();
+                if (!readPaint(_style.stroke, BinaryStrokeSetter{_item}))
+                    _item->removeStroke();
+                _item->setStrokeWidth(_style.strokeWidth);
+                _item->setMiterLimit(_style.miterLimit);
+                _item->setStrokeJoin((StrokeJoin)_style.strokeJoin);
+                _item->setStrokeCap((StrokeCap)_style.strokeCap);
+                _item->setWindingRule((WindingRule)_style.windingRule);
+                _item->setScaleStroke(_style.bScaleStroke);
+                if (_style.dashCount)
+                {
+                    const float * dashes = section<float>(BinarySectionFloats) + _style.firstDash;
+                    DashArray dashArray;
+                    for (Size i = 0; i < _style.dashCount; ++i)
+                        dashArray.append(dashes[i]);
+                    _item->setDashArray(dashArray);
+                    _item->setDashOffset(_style.dashOffset);
+                }
+            }
+
+            MappedFile m_file;
+            stick::Allocator * m_alloc;
+        };
+    }
+}
+
+#endif //PAPERLUA_BINARYFORMAT_HPP
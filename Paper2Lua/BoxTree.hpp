@@ -0,0 +1,243 @@
+#ifndef PAPERLUA_BOXTREE_HPP
+#define PAPERLUA_BOXTREE_HPP
+
+#include <Paper2/Path.hpp>
+#include <Stick/DynamicArray.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace paperLua
+{
+    namespace detail
+    {
+        using namespace paper;
+
+        struct Box
+        {
+            Float minX, minY, maxX, maxY;
+
+            static Box fromRect(const Rect & _rect)
+            {
+                return Box{_rect.min().x, _rect.min().y, _rect.max().x, _rect.max().y};
+            }
+
+            //bounds of _rect after transforming it by _transform
+            static Box fromTransformedRect(const Rect & _rect, const Mat32f & _transform)
+            {
+                Vec2f corners[4] =
+                {
+                    _transform * _rect.min(),
+                    _transform * Vec2f(_rect.max().x, _rect.min().y),
+                    _transform * _rect.max(),
+                    _transform * Vec2f(_rect.min().x, _rect.max().y)
+                };
+                Box ret = {corners[0].x, corners[0].y, corners[0].x, corners[0].y};
+                for (Int32 i = 1; i < 4; ++i)
+                    ret.merge(Box{corners[i].x, corners[i].y, corners[i].x, corners[i].y});
+                return ret;
+            }
+
+            void merge(const Box & _other)
+            {
+                minX = std::min(minX, _other.minX);
+                minY = std::min(minY, _other.minY);
+                maxX = std::max(maxX, _other.maxX);
+                maxY = std::max(maxY, _other.maxY);
+            }
+
+            bool overlaps(const Box & _other) const
+            {
+                return minX <= _other.maxX && maxX >= _other.minX && minY <= _other.maxY && maxY >= _other.minY;
+            }
+
+            bool contains(const Box & _other) const
+            {
+                return minX <= _other.minX && maxX >= _other.maxX && minY <= _other.minY && maxY >= _other.maxY;
+            }
+
+            bool operator != (const Box & _other) const
+            {
+                return minX != _other.minX || minY != _other.minY || maxX != _other.maxX || maxY != _other.maxY;
+            }
+
+            Float distanceSquared(const Vec2f & _point) const
+            {
+                Float dx = std::max(std::max(minX - _point.x, _point.x - maxX), (Float)0);
+                Float dy = std::max(std::max(minY - _point.y, _point.y - maxY), (Float)0);
+                return dx * dx + dy * dy;
+            }
+        };
+
+        //Bounding volume hierarchy over an array of boxes, built top down with median splits.
+        //refit updates the node bounds for moved boxes without changing the tree topology.
+        class BoxTree
+        {
+        public:
+
+            explicit BoxTree(stick::Allocator & _alloc = stick::defaultAllocator()) :
+                m_order(_alloc),
+                m_nodes(_alloc)
+            {
+            }
+
+            void build(const stick::DynamicArray<Box> & _boxes)
+            {
+                Size count = _boxes.count();
+                m_order.resize(count);
+                for (Size i = 0; i < count; ++i)
+                    m_order[i] = i;
+                m_nodes.clear();
+                if (count)
+                {
+                    m_nodes.reserve(count);
+                    m_nodes.append(Node());
+                    buildNode(_boxes, 0, 0, count);
+                }
+            }
+
+            void refit(const stick::DynamicArray<Box> & _boxes)
+            {
+                //children always come after their parent, so walking backwards visits them first
+                for (Size i = m_nodes.count(); i-- > 0;)
+                {
+                    Node & node = m_nodes[i];
+                    if (node.count)
+                    {
+                        node.bounds = _boxes[m_order[node.first]];
+                        for (Size j = node.first + 1; j < node.first + node.count; ++j)
+                            node.bounds.merge(_boxes[m_order[j]]);
+                    }
+                    else
+                    {
+                        node.bounds = m_nodes[node.first].bounds;
+                        node.bounds.merge(m_nodes[node.first + 1].bounds);
+                    }
+                }
+            }
+
+            //calls _func(index) for every box that overlaps _box. _boxes must be the array
+            //the tree was built or last refitted with.
+            template<class F>
+            void query(const stick::DynamicArray<Box> & _boxes, const Box & _box, F _func) const
+            {
+                if (!m_nodes.count())
+                    return;
+
+                Size stack[64];
+                Size stackSize = 0;
+                stack[stackSize++] = 0;
+                while (stackSize)
+                {
+                    const Node & node = m_nodes[stack[--stackSize]];
+                    if (!node.bounds.overlaps(_box))
+                        continue;
+
+                    if (node.count)
+                    {
+                        for (Size i = node.first; i < node.first + node.count; ++i)
+                        {
+                            if (_boxes[m_order[i]].overlaps(_box))
+                                _func(m_order[i]);
+                        }
+                    }
+                    else
+                    {
+                        stack[stackSize++] = node.first;
+                        stack[stackSize++] = node.first + 1;
+                    }
+                }
+            }
+
+            //branch and bound search for the element closest to _point. _func(index, best) is
+            //called for every box closer than the squared distance best and may lower best.
+            template<class F>
+            void nearest(const stick::DynamicArray<Box> & _boxes, const Vec2f & _point, Float & _best, F _func) const
+            {
+                if (!m_nodes.count())
+                    return;
+
+                Size stack[64];
+                Size stackSize = 0;
+                stack[stackSize++] = 0;
+                while (stackSize)
+                {
+                    const Node & node = m_nodes[stack[--stackSize]];
+                    if (node.bounds.distanceSquared(_point) > _best)
+                        continue;
+
+                    if (node.count)
+                    {
+                        for (Size i = node.first; i < node.first + node.count; ++i)
+                        {
+                            if (_boxes[m_order[i]].distanceSquared(_point) <= _best)
+                                _func(m_order[i], _best);
+                        }
+                    }
+                    else
+                    {
+                        //visit the closer child first so the other one is more likely to be pruned
+                        Size a = node.first;
+                        Size b = node.first + 1;
+                        if (m_nodes[a].bounds.distanceSquared(_point) < m_nodes[b].bounds.distanceSquared(_point))
+                            std::swap(a, b);
+                        stack[stackSize++] = a;
+                        stack[stackSize++] = b;
+                    }
+                }
+            }
+
+        private:
+
+            //inner nodes have a count of zero and their two children at first and first + 1,
+            //leaves reference count boxes starting at first in m_order.
+            struct Node
+            {
+                Box bounds;
+                Size first;
+                Size count;
+            };
+
+            void buildNode(const stick::DynamicArray<Box> & _boxes, Size _nodeIndex, Size _first, Size _count)
+            {
+                static const Size leafSize = 4;
+
+                Box box = _boxes[m_order[_first]];
+                for (Size i = _first + 1; i < _first + _count; ++i)
+                    box.merge(_boxes[m_order[i]]);
+                m_nodes[_nodeIndex].bounds = box;
+
+                if (_count <= leafSize)
+                {
+                    m_nodes[_nodeIndex].first = _first;
+                    m_nodes[_nodeIndex].count = _count;
+                    return;
+                }
+
+                //median split along the longer axis of the box
+                bool bSplitX = box.maxX - box.minX > box.maxY - box.minY;
+                Size * begin = &m_order[_first];
+                Size half = _count / 2;
+                std::nth_element(begin, begin + half, begin + _count, [&_boxes, bSplitX](Size _a, Size _b)
+                {
+                    const Box & a = _boxes[_a];
+                    const Box & b = _boxes[_b];
+                    return bSplitX ? a.minX + a.maxX < b.minX + b.maxX : a.minY + a.maxY < b.minY + b.maxY;
+                });
+
+                Size left = m_nodes.count();
+                m_nodes.append(Node());
+                m_nodes.append(Node());
+                m_nodes[_nodeIndex].first = left;
+                m_nodes[_nodeIndex].count = 0;
+                buildNode(_boxes, left, _first, half);
+                buildNode(_boxes, left + 1, _first + half, _count - half);
+            }
+
+            stick::DynamicArray<Size> m_order;
+            stick::DynamicArray<Node> m_nodes;
+        };
+    }
+}
+
+#endif //PAPERLUA_BOXTREE_HPP
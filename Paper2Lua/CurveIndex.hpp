@@ -0,0 +1,231 @@
+#ifndef PAPERLUA_CURVEINDEX_HPP
+#define PAPERLUA_CURVEINDEX_HPP
+
+#include <Paper2Lua/BoxTree.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace paperLua
+{
+    namespace detail
+    {
+        using namespace paper;
+
+        struct CubicData
+        {
+            Vec2f p0, c0, c1, p1;
+
+            Vec2f position(Float _t) const
+            {
+                Float mt = 1 - _t;
+                Float a = mt * mt * mt;
+                Float b = 3 * mt * mt * _t;
+                Float c = 3 * mt * _t * _t;
+                Float d = _t * _t * _t;
+                return Vec2f(a * p0.x + b * c0.x + c * c1.x + d * p1.x,
+                             a * p0.y + b * c0.y + c * c1.y + d * p1.y);
+            }
+
+            Vec2f derivative(Float _t) const
+            {
+                Float mt = 1 - _t;
+                Float a = 3 * mt * mt;
+                Float b = 6 * mt * _t;
+                Float c = 3 * _t * _t;
+                return Vec2f(a * (c0.x - p0.x) + b * (c1.x - c0.x) + c * (p1.x - c1.x),
+                             a * (c0.y - p0.y) + b * (c1.y - c0.y) + c * (p1.y - c1.y));
+            }
+
+            Vec2f secondDerivative(Float _t) const
+            {
+                Float mt = 1 - _t;
+                return Vec2f(6 * mt * (c1.x - 2 * c0.x + p0.x) + 6 * _t * (p1.x - 2 * c1.x + c0.x),
+                             6 * mt * (c1.y - 2 * c0.y + p0.y) + 6 * _t * (p1.y - 2 * c1.y + c0.y));
+            }
+
+            //closest parameter to _point: the best of a coarse uniform scan is refined with newton
+            //iterations on (B(t) - p) . B'(t) = 0.
+            Float closestParameter(const Vec2f & _point, Float & _outDistanceSquared) const
+            {
+                static const Int32 sampleCount = 16;
+
+                Float bestT = 0;
+                Float bestDist = std::numeric_limits<Float>::max();
+                for (Int32 i = 0; i <= sampleCount; ++i)
+                {
+                    Float t = (Float)i / sampleCount;
+                    Vec2f d = position(t) - _point;
+                    Float dist = d.x * d.x + d.y * d.y;
+                    if (dist < bestDist)
+                    {
+                        bestDist = dist;
+                        bestT = t;
+                    }
+                }
+
+                Float t = bestT;
+                for (Int32 i = 0; i < 8; ++i)
+                {
+                    Vec2f d = position(t) - _point;
+                    Vec2f d1 = derivative(t);
+                    Vec2f d2 = secondDerivative(t);
+                    Float numerator = d.x * d1.x + d.y * d1.y;
+                    Float denominator = d1.x * d1.x + d1.y * d1.y + d.x * d2.x + d.y * d2.y;
+                    if (std::abs(denominator) < std::numeric_limits<Float>::epsilon())
+                        break;
+                    Float nt = std::min(std::max(t - numerator / denominator, (Float)0), (Float)1);
+                    if (std::abs(nt - t) < 1e-6)
+                    {
+                        t = nt;
+                        break;
+                    }
+                    t = nt;
+                }
+
+                Vec2f d = position(t) - _point;
+                Float dist = d.x * d.x + d.y * d.y;
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    bestT = t;
+                }
+
+                _outDistanceSquared = bestDist;
+                return bestT;
+            }
+        };
+
+        struct ClosestPointResult
+        {
+            Vec2f position;
+            Float distance;
+            Size curveIndex;
+            Float parameter;
+        };
+
+        //Bounding volume hierarchy over the curves of a path. It copies the curve data, so once
+        //built, queries don't touch the path anymore and can safely run on several threads at once.
+        //The index remembers a fingerprint of the segment data it was built from to find out if it
+        //is outdated, and the mutation generation it was last checked at so the fingerprint is
+        //only computed again once something may have changed.
+        class CurveIndex
+        {
+        public:
+
+            //the copied curve data and the tree are allocated with _alloc
+            explicit CurveIndex(stick::Allocator & _alloc = stick::defaultAllocator()) :
+                m_fingerprint(0),
+                m_generation(0),
+                m_curves(_alloc),
+                m_bounds(_alloc),
+                m_tree(_alloc)
+            {
+            }
+
+            static stick::UInt64 computeFingerprint(Path * _path)
+            {
+                //FNV-1a over the raw segment data and the closed flag
+                stick::UInt64 hash = 14695981039346656037ULL;
+                auto mix = [&hash](const void * _data, Size _byteCount)
+                {
+                    const stick::UInt8 * bytes = static_cast<const stick::UInt8 *>(_data);
+                    for (Size i = 0; i < _byteCount; ++i)
+                    {
+                        hash ^= bytes[i];
+                        hash *= 1099511628211ULL;
+                    }
+                };
+
+                bool bClosed = _path->isClosed();
+                mix(&bClosed, sizeof(bClosed));
+                Size count = _path->segmentCount();
+                mix(&count, sizeof(count));
+                for (Size i = 0; i < count; ++i)
+                {
+                    Segment seg = _path->segment(i);
+                    Float data[6] =
+                    {
+                        seg.position().x, seg.position().y,
+                        seg.handleIn().x, seg.handleIn().y,
+                        seg.handleOut().x, seg.handleOut().y
+                    };
+                    mix(data, sizeof(data));
+                }
+                return hash;
+            }
+
+            stick::UInt64 fingerprint() const
+            {
+                return m_fingerprint;
+            }
+
+            stick::UInt64 generation() const
+            {
+                return m_generation;
+            }
+
+            void setGeneration(stick::UInt64 _generation)
+            {
+                m_generation = _generation;
+            }
+
+            void rebuild(Path * _path, stick::UInt64 _fingerprint)
+            {
+                m_fingerprint = _fingerprint;
+                Size count = _path->curveCount();
+                m_curves.resize(count);
+                m_bounds.resize(count);
+
+                for (Size i = 0; i < count; ++i)
+                {
+                    Curve c = _path->curve(i);
+                    CubicData & data = m_curves[i];
+                    data.p0 = c.positionOne();
+                    data.c0 = c.handleOneAbsolute();
+                    data.c1 = c.handleTwoAbsolute();
+                    data.p1 = c.positionTwo();
+                    m_bounds[i] = Box::fromRect(c.bounds());
+                }
+
+                m_tree.build(m_bounds);
+            }
+
+            ClosestPointResult closestPoint(const Vec2f & _point) const
+            {
+                ClosestPointResult ret = {_point, std::numeric_limits<Float>::max(), 0, 0};
+                if (!m_curves.count())
+                    return ret;
+
+                Float best = std::numeric_limits<Float>::max();
+                m_tree.nearest(m_bounds, _point, best, [&](Size _index, Float & _best)
+                {
+                    Float dist;
+                    Float t = m_curves[_index].closestParameter(_point, dist);
+                    //ties go to the lower curve index so the result doesn't depend on traversal order
+                    if (dist < _best || (dist == _best && _index < ret.curveIndex))
+                    {
+                        _best = dist;
+                        ret.curveIndex = _index;
+                        ret.parameter = t;
+                    }
+                });
+
+                ret.position = m_curves[ret.curveIndex].position(ret.parameter);
+                ret.distance = std::sqrt(best);
+                return ret;
+            }
+
+        private:
+
+            stick::UInt64 m_fingerprint;
+            stick::UInt64 m_generation;
+            stick::DynamicArray<CubicData> m_curves;
+            stick::DynamicArray<Box> m_bounds;
+            BoxTree m_tree;
+        };
+    }
+}
+
+#endif //PAPERLUA_CURVEINDEX_HPP
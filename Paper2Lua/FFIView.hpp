@@ -0,0 +1,164 @@
+#ifndef PAPERLUA_FFIVIEW_HPP
+#define PAPERLUA_FFIVIEW_HPP
+
+#include <Paper2/Path.hpp>
+#include <Paper2Lua/Batch.hpp>
+#include <Paper2Lua/PathSnapshot.hpp>
+
+#include <stdint.h>
+#include <type_traits>
+
+//C structs handed to LuaJIT's FFI. Each one is written down once in a macro, which is both
+//compiled below and turned into the string ffiCdef returns, so the two can't drift apart.
+
+//Segments copied out of a path by path:segmentBuffer. Segment i starts at data[i * stride] and
+//holds x, y, handleIn x, handleIn y, handleOut x, handleOut y, the handles relative to the
+//position like path:segmentData.
+#define PAPERLUA_FFI_SEGMENT_BUFFER \
+    typedef struct PaperLuaSegmentBuffer \
+    { \
+        float * data; \
+        uint32_t count; \
+        uint32_t stride; \
+    } PaperLuaSegmentBuffer;
+
+//Read only view of a PathSnapshot. Curve i uses the points 3 * i to 3 * i + 3 of x and y.
+//lengths holds the cumulative arc length at the start of each of the samplesPerCurve sample
+//intervals per curve, plus the total length at the end.
+#define PAPERLUA_FFI_SNAPSHOT_VIEW \
+    typedef struct PaperLuaSnapshotView \
+    { \
+        const float * x; \
+        const float * y; \
+        const float * lengths; \
+        uint32_t pointCount; \
+        uint32_t curveCount; \
+        uint32_t sampleCount; \
+        uint32_t samplesPerCurve; \
+        uint32_t closed; \
+    } PaperLuaSnapshotView;
+
+#define PAPERLUA_FFI_STRING_IMPL(_x) #_x
+#define PAPERLUA_FFI_STRING(_x) PAPERLUA_FFI_STRING_IMPL(_x)
+
+extern "C"
+{
+    PAPERLUA_FFI_SEGMENT_BUFFER
+    PAPERLUA_FFI_SNAPSHOT_VIEW
+}
+
+namespace paperLua
+{
+    //declarations of the FFI structs for ffi.cdef
+    inline const char * ffiCdef()
+    {
+        return PAPERLUA_FFI_STRING(PAPERLUA_FFI_SEGMENT_BUFFER PAPERLUA_FFI_SNAPSHOT_VIEW);
+    }
+
+    namespace detail
+    {
+        using namespace paper;
+
+        static_assert(std::is_same<Float, float>::value, "the FFI views expect paper::Float to be float");
+
+        //Flat copy of the segments of a path that scripts read and write through the FFI.
+        //Filling it and writing it back are one binding call each, no matter how many segments
+        //there are. The storage is reused when the buffer is refilled with as many or fewer
+        //segments, so a script that keeps its buffer around doesn't allocate every frame.
+        class SegmentBuffer
+        {
+        public:
+
+            static const Size stride = 6;
+
+            SegmentBuffer()
+            {
+                m_view.data = nullptr;
+                m_view.count = 0;
+                m_view.stride = stride;
+            }
+
+            SegmentBuffer(const SegmentBuffer &) = delete;
+            SegmentBuffer & operator = (const SegmentBuffer &) = delete;
+
+            void read(Path * _path)
+            {
+                Size count = _path->segmentCount();
+                m_data.resize(count * stride);
+                Float * data = count ? &m_data[0] : nullptr;
+                for (Size i = 0; i < count; ++i)
+                {
+                    Segment seg = _path->segment(i);
+                    Vec2f pos = seg.position();
+                    Vec2f hi = seg.handleIn();
+                    Vec2f ho = seg.handleOut();
+                    Float * s = data + i * stride;
+                    s[0] = pos.x;
+                    s[1] = pos.y;
+                    s[2] = hi.x;
+                    s[3] = hi.y;
+                    s[4] = ho.x;
+                    s[5] = ho.y;
+                }
+                m_view.data = data;
+                m_view.count = (uint32_t)count;
+            }
+
+            //overwrites the segments of _path starting at _from and appends new segments for
+            //the part of the buffer that reaches past the last segment, like path:setSegmentData
+            void write(Path * _path, Size _from) const
+            {
+                Size segCount = _path->segmentCount();
+                if (_from + m_view.count > segCount)
+                    reserveSegments(_path, _from + m_view.count);
+                for (Size i = 0; i < m_view.count; ++i)
+                {
+                    const Float * s = m_view.data + i * stride;
+                    Vec2f pos(s[0], s[1]);
+                    Vec2f hi(s[2], s[3]);
+                    Vec2f ho(s[4], s[5]);
+
+                    Size segIdx = _from + i;
+                    if (segIdx < segCount)
+                    {
+                        Segment seg = _path->segment(segIdx);
+                        seg.setPosition(pos);
+                        seg.setHandleIn(hi);
+                        seg.setHandleOut(ho);
+                    }
+                    else
+                        _path->addSegment(pos, hi, ho);
+                }
+            }
+
+            Size count() const
+            {
+                return m_view.count;
+            }
+
+            PaperLuaSegmentBuffer & view()
+            {
+                return m_view;
+            }
+
+        private:
+
+            stick::DynamicArray<Float> m_data;
+            PaperLuaSegmentBuffer m_view;
+        };
+
+        inline void fillSnapshotView(const PathSnapshot & _snapshot, PaperLuaSnapshotView & _outView)
+        {
+            _outView.x = _snapshot.xData();
+            _outView.y = _snapshot.yData();
+            _outView.lengths = _snapshot.lengthData();
+            _outView.pointCount = (uint32_t)_snapshot.pointCount();
+            _outView.curveCount = (uint32_t)_snapshot.curveCount();
+            _outView.sampleCount = (uint32_t)_snapshot.sampleCount();
+            _outView.samplesPerCurve = (uint32_t)PathSnapshot::subdivisionCount;
+            _outView.closed = _snapshot.isClosed() ? 1 : 0;
+        }
+    }
+}
+
+#endif //PAPERLUA_FFIVIEW_HPP
@@ -0,0 +1,301 @@
+#ifndef PAPERLUA_ITEMINDEX_HPP
+#define PAPERLUA_ITEMINDEX_HPP
+
+#include <Paper2/Document.hpp>
+#include <Paper2/Group.hpp>
+#include <Paper2Lua/BoxTree.hpp>
+
+#include <algorithm>
+#include <functional>
+
+namespace paperLua
+{
+    namespace detail
+    {
+        using namespace paper;
+
+        //Spatial index over the paths of a document, in document space.
+        //sync() walks the item tree and compares it against the indexed state: if only the bounds
+        //of some paths changed (i.e. because they were transformed), the tree is refitted in place,
+        //if paths were added, removed or reordered it is rebuilt. update() only looks at the items
+        //that changed in place, see MutationCounter. Like CurveIndex, the index remembers the
+        //mutation generation it was last synced at, so callers only touch it again once something
+        //may have changed.
+        class ItemIndex
+        {
+        public:
+
+            explicit ItemIndex(stick::Allocator & _alloc = stick::defaultAllocator()) :
+                m_paths(_alloc),
+                m_boxes(_alloc),
+                m_transforms(_alloc),
+                m_tree(_alloc),
+                m_strokeWidths(_alloc),
+                m_maxStrokeWidth(0),
+                m_entries(_alloc),
+                m_scratchPaths(_alloc),
+                m_scratchBoxes(_alloc),
+                m_scratchTransforms(_alloc),
+                m_generation(0),
+                m_rebuildCount(0),
+                m_refitCount(0)
+            {
+            }
+
+            void sync(Document * _document)
+            {
+                m_scratchPaths.clear();
+                m_scratchBoxes.clear();
+                m_scratchTransforms.clear();
+                m_strokeWidths.clear();
+                m_entries.clear();
+                m_entries.append({_document, s_groupEntry});
+                collect(_document, Mat32f::identity());
+                std::sort(m_entries.begin(), m_entries.end(), compareEntries);
+                updateMaxStrokeWidth();
+
+                bool bSamePaths = m_scratchPaths.count() == m_paths.count() &&
+                                  std::equal(m_paths.begin(), m_paths.end(), m_scratchPaths.begin());
+                m_transforms = m_scratchTransforms;
+                if (!bSamePaths)
+                {
+                    m_paths = m_scratchPaths;
+                    m_boxes = m_scratchBoxes;
+                    m_tree.build(m_boxes);
+                    ++m_rebuildCount;
+                    return;
+                }
+
+                Size changed = 0;
+                for (Size i = 0; i < m_boxes.count(); ++i)
+                {
+                    if (m_boxes[i] != m_scratchBoxes[i])
+                    {
+                        m_boxes[i] = m_scratchBoxes[i];
+                        ++changed;
+                    }
+                }
+                refitOrRebuild(changed);
+            }
+
+            //updates the index for _items, which only changed in place since the last sync (i.e.
+            //were transformed or got new segments), without walking the rest of the document. The
+            //bounds of changed paths and of all paths below changed groups are recomputed and the
+            //tree is refitted. Items that are not indexed belong to other documents and are skipped.
+            //Returns false if a changed group does not match the index anymore, sync has to run then.
+            bool update(Item * const * _items, Size _count)
+            {
+                Size changed = 0;
+                bool bChanged = false;
+                for (Size i = 0; i < _count; ++i)
+                {
+                    const Entry * entry = findEntry(_items[i]);
+                    if (!entry)
+                        continue;
+                    bChanged = true;
+                    if (entry->index != s_groupEntry)
+                        changed += updatePath(entry->index, childTransform(_items[i]->parent()));
+                    else if (!updateChildren(_items[i], childTransform(_items[i]), changed))
+                        return false;
+                }
+                if (bChanged)
+                    updateMaxStrokeWidth();
+                refitOrRebuild(changed);
+                return true;
+            }
+
+            //calls _func(index) for every path whose bounds overlap _box.
+            template<class F>
+            void query(const Box & _box, F _func) const
+            {
+                m_tree.query(m_boxes, _box, _func);
+            }
+
+            Size count() const
+            {
+                return m_paths.count();
+            }
+
+            //paths are indexed in paint order, higher indices are painted on top
+            Path * path(Size _index) const
+            {
+                return m_paths[_index];
+            }
+
+            const Box & bounds(Size _index) const
+            {
+                return m_boxes[_index];
+            }
+
+            //transform from the path's local space to document space
+            const Mat32f & transform(Size _index) const
+            {
+                return m_transforms[_index];
+            }
+
+            //widest stroke of all indexed paths that have one, in their local space
+            Float maxStrokeWidth() const
+            {
+                return m_maxStrokeWidth;
+            }
+
+            stick::UInt64 generation() const
+            {
+                return m_generation;
+            }
+
+            void setGeneration(stick::UInt64 _generation)
+            {
+                m_generation = _generation;
+            }
+
+            Size rebuildCount() const
+            {
+                return m_rebuildCount;
+            }
+
+            Size refitCount() const
+            {
+                return m_refitCount;
+            }
+
+        private:
+
+            //entry of an indexed group in m_entries, paths store their index instead
+            static constexpr Size s_groupEntry = static_cast<Size>(-1);
+
+            struct Entry
+            {
+                const Item * item;
+                Size index;
+            };
+
+            static bool compareEntries(const Entry & _a, const Entry & _b)
+            {
+                return std::less<const Item *>()(_a.item, _b.item);
+            }
+
+            //looks _item up by address only, it is not dereferenced unless it is indexed
+            const Entry * findEntry(const Item * _item) const
+            {
+                Entry key = {_item, 0};
+                auto it = std::lower_bound(m_entries.begin(), m_entries.end(), key, compareEntries);
+                return it != m_entries.end() && it->item == _item ? &*it : nullptr;
+            }
+
+            //maps the local space of the children of _item to document space, the product collect
+            //builds on the way down
+            static Mat32f childTransform(Item * _item)
+            {
+                Mat32f ret = Mat32f::identity();
+                for (Item * it = _item; it && it->itemType() != ItemType::Document; it = it->parent())
+                    ret = it->transform() * ret;
+                return ret;
+            }
+
+            static Float strokeWidth(Path * _path)
+            {
+                return _path->hasStroke() ? _path->strokeWidth() : 0;
+            }
+
+            //returns 1 if the bounds of the path at _index changed, 0 otherwise
+            Size updatePath(Size _index, const Mat32f & _parentTransform)
+            {
+                Path * p = m_paths[_index];
+                m_strokeWidths[_index] = strokeWidth(p);
+                m_transforms[_index] = _parentTransform * p->transform();
+                Box box = Box::fromTransformedRect(p->bounds(), _parentTransform);
+                if (box == m_boxes[_index])
+                    return 0;
+                m_boxes[_index] = box;
+                return 1;
+            }
+
+            bool updateChildren(Item * _item, const Mat32f & _parentTransform, Size & _outChanged)
+            {
+                for (Item * child : _item->children())
+                {
+                    const Entry * entry = findEntry(child);
+                    if (!entry)
+                        return false;
+                    if (entry->index == s_groupEntry)
+                    {
+                        if (!updateChildren(child, _parentTransform * child->transform(), _outChanged))
+                            return false;
+                    }
+                    else
+                        _outChanged += updatePath(entry->index, _parentTransform);
+                }
+                return true;
+            }
+
+            void updateMaxStrokeWidth()
+            {
+                m_maxStrokeWidth = 0;
+                for (Float w : m_strokeWidths)
+                    m_maxStrokeWidth = std::max(m_maxStrokeWidth, w);
+            }
+
+            void refitOrRebuild(Size _changed)
+            {
+                if (!_changed)
+                    return;
+
+                //refitting degrades the tree if too much moved, rebuild in that case
+                if (_changed > m_boxes.count() / 4)
+                {
+                    m_tree.build(m_boxes);
+                    ++m_rebuildCount;
+                }
+                else
+                {
+                    m_tree.refit(m_boxes);
+                    ++m_refitCount;
+                }
+            }
+
+            //_parentTransform maps the local space of _item to document space
+            void collect(Item * _item, const Mat32f & _parentTransform)
+            {
+                for (Item * child : _item->children())
+                {
+                    if (child->itemType() == ItemType::Group)
+                    {
+                        m_entries.append({child, s_groupEntry});
+                        collect(child, _parentTransform * child->transform());
+                    }
+                    else if (child->itemType() == ItemType::Path)
+                    {
+                        Path * p = static_cast<Path *>(child);
+                        m_entries.append({child, m_scratchPaths.count()});
+                        m_scratchPaths.append(p);
+                        m_strokeWidths.append(strokeWidth(p));
+                        m_scratchBoxes.append(Box::fromTransformedRect(child->bounds(), _parentTransform));
+                        m_scratchTransforms.append(_parentTransform * child->transform());
+                    }
+                }
+            }
+
+            stick::DynamicArray<Path *> m_paths;
+            stick::DynamicArray<Box> m_boxes;
+            stick::DynamicArray<Mat32f> m_transforms;
+            BoxTree m_tree;
+            //stroke width of every path, 0 if it has none
+            stick::DynamicArray<Float> m_strokeWidths;
+            Float m_maxStrokeWidth;
+            //indexed paths and groups sorted by address, for update
+            stick::DynamicArray<Entry> m_entries;
+
+            stick::DynamicArray<Path *> m_scratchPaths;
+            stick::DynamicArray<Box> m_scratchBoxes;
+            stick::DynamicArray<Mat32f> m_scratchTransforms;
+
+            stick::UInt64 m_generation;
+
+            Size m_rebuildCount;
+            Size m_refitCount;
+        };
+    }
+}
+
+#endif //PAPERLUA_ITEMINDEX_HPP
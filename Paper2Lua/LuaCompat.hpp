@@ -0,0 +1,76 @@
+#ifndef PAPERLUA_LUACOMPAT_HPP
+#define PAPERLUA_LUACOMPAT_HPP
+
+#include <Luanatic/Luanatic.hpp>
+
+//The lua 5.2 functions the bindings use that can be implemented on top of the 5.1 API, so that
+//Paper2Lua also builds against LuaJIT. They live in namespace paperLua, where they are found
+//before any global versions a lua distribution or another compatibility layer might provide.
+//The rest is handled where it is used: C functions can't yield before 5.2, so the sliced
+//functions always run to completion there (see luaRunSliced), and ScriptRunner sets the
+//environment of a job with lua_setfenv instead of its _ENV upvalue.
+#if LUA_VERSION_NUM < 502
+
+namespace paperLua
+{
+    inline int lua_absindex(lua_State * _state, int _index)
+    {
+        return _index > 0 || _index <= LUA_REGISTRYINDEX ? _index : lua_gettop(_state) + _index + 1;
+    }
+
+    inline size_t lua_rawlen(lua_State * _state, int _index)
+    {
+        return lua_objlen(_state, _index);
+    }
+
+    inline void lua_rawgetp(lua_State * _state, int _index, const void * _key)
+    {
+        _index = lua_absindex(_state, _index);
+        lua_pushlightuserdata(_state, const_cast<void *>(_key));
+        lua_rawget(_state, _index);
+    }
+
+    inline void lua_rawsetp(lua_State * _state, int _index, const void * _key)
+    {
+        _index = lua_absindex(_state, _index);
+        lua_pushlightuserdata(_state, const_cast<void *>(_key));
+        lua_insert(_state, -2);
+        lua_rawset(_state, _index);
+    }
+
+#ifndef lua_pushglobaltable
+    inline void lua_pushglobaltable(lua_State * _state)
+    {
+        lua_pushvalue(_state, LUA_GLOBALSINDEX);
+    }
+#endif //lua_pushglobaltable
+
+    //like the 5.2 version, minus the __name field of the metatable which 5.1 doesn't know
+    inline const char * luaL_tolstring(lua_State * _state, int _index, size_t * _outLength)
+    {
+        if (!luaL_callmeta(_state, _index, "__tostring"))
+        {
+            switch (lua_type(_state, _index))
+            {
+            case LUA_TNUMBER:
+            case LUA_TSTRING:
+                lua_pushvalue(_state, _index);
+                break;
+            case LUA_TBOOLEAN:
+                lua_pushstring(_state, lua_toboolean(_state, _index) ? "true" : "false");
+                break;
+            case LUA_TNIL:
+                lua_pushliteral(_state, "nil");
+                break;
+            default:
+                lua_pushfstring(_state, "%s: %p", luaL_typename(_state, _index), lua_topointer(_state, _index));
+                break;
+            }
+        }
+        return lua_tolstring(_state, -1, _outLength);
+    }
+}
+
+#endif //LUA_VERSION_NUM < 502
+
+#endif //PAPERLUA_LUACOMPAT_HPP
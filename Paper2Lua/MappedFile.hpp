@@ -0,0 +1,88 @@
+#ifndef PAPERLUA_MAPPEDFILE_HPP
+#define PAPERLUA_MAPPEDFILE_HPP
+
+#include <Stick/String.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace paperLua
+{
+    namespace detail
+    {
+        //Read only memory mapping of a whole file. The pages are only read from disk when they
+        //are touched, and nothing is copied into a separate buffer.
+        class MappedFile
+        {
+        public:
+
+            MappedFile() :
+                m_data(nullptr),
+                m_size(0)
+            {
+            }
+
+            ~MappedFile()
+            {
+                close();
+            }
+
+            MappedFile(const MappedFile &) = delete;
+            MappedFile & operator = (const MappedFile &) = delete;
+
+            bool open(const char * _path)
+            {
+                close();
+
+                int fd = ::open(_path, O_RDONLY);
+                if (fd < 0)
+                    return false;
+
+                struct stat info;
+                bool bOk = fstat(fd, &info) == 0;
+                if (bOk && info.st_size > 0)
+                {
+                    void * data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (data == MAP_FAILED)
+                        bOk = false;
+                    else
+                    {
+                        //parsers read front to back
+                        madvise(data, info.st_size, MADV_SEQUENTIAL);
+                        m_data = static_cast<const char *>(data);
+                        m_size = info.st_size;
+                    }
+                }
+                ::close(fd);
+                return bOk;
+            }
+
+            void close()
+            {
+                if (m_data)
+                    munmap(const_cast<char *>(m_data), m_size);
+                m_data = nullptr;
+                m_size = 0;
+            }
+
+            const char * data() const
+            {
+                return m_data;
+            }
+
+            stick::Size size() const
+            {
+                return m_size;
+            }
+
+        private:
+
+            const char * m_data;
+            stick::Size m_size;
+        };
+    }
+}
+
+#endif //PAPERLUA_MAPPEDFILE_HPP
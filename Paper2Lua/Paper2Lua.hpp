@@ -7,6 +7,28 @@
 #include <Paper2/Group.hpp>
 #include <Paper2/Tarp/TarpRenderer.hpp>
 #include <Stick/Path.hpp>
+#include <Paper2Lua/Batch.hpp>
+#include <Paper2Lua/BinaryFormat.hpp>
+#include <Paper2Lua/CurveIndex.hpp>
+#include <Paper2Lua/FFIView.hpp>
+#include <Paper2Lua/ItemIndex.hpp>
+#include <Paper2Lua/LuaCompat.hpp>
+#include <Paper2Lua/MappedFile.hpp>
+#include <Paper2Lua/Parallel.hpp>
+#include <Paper2Lua/PathSnapshot.hpp>
+#include <Paper2Lua/PoolAllocator.hpp>
+#include <Paper2Lua/SVGStream.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace luanatic
 {
@@ -30,437 +52,3947 @@ namespace luanatic
     };
 }
 
+#define PAPERLUA_NUMBERS_FUNCTION(_func) &paperLua::detail::NumbersFunction<decltype(_func), _func>::func
+#define PAPERLUA_NUMBERS_FUNCTION_OVERLOAD(_sig, _func) &paperLua::detail::NumbersFunction<_sig, _func>::func
+#define PAPERLUA_UNCHECKED_FUNCTION(_func) &paperLua::detail::UncheckedFunction<decltype(_func), _func>::func
+#define PAPERLUA_UNCHECKED_FUNCTION_OVERLOAD(_sig, _func) &paperLua::detail::UncheckedFunction<_sig, _func>::func
+
+//Member functions that take or return a single Vec2f. Each entry is registered twice, once
+//with the regular Vec2f signature and once with an XY suffix that takes and returns plain
+//x, y numbers (e.g. curve:positionAtXY(offset) -> x, y). Registering both from these lists
+//keeps the two surfaces from drifting apart.
+#define PAPERLUA_SEGMENT_VEC2F_BINDINGS(_X, _XO) \
+    _X(Segment, setPosition) \
+    _X(Segment, setHandleIn) \
+    _X(Segment, setHandleOut) \
+    _X(Segment, position) \
+    _X(Segment, handleIn) \
+    _X(Segment, handleOut) \
+    _X(Segment, handleInAbsolute) \
+    _X(Segment, handleOutAbsolute)
+
+#define PAPERLUA_CURVE_LOCATION_VEC2F_BINDINGS(_X, _XO) \
+    _X(CurveLocation, position) \
+    _X(CurveLocation, normal) \
+    _X(CurveLocation, tangent)
+
+#define PAPERLUA_CURVE_VEC2F_BINDINGS(_X, _XO) \
+    _X(Curve, setPositionOne) \
+    _X(Curve, setHandleOne) \
+    _X(Curve, setPositionTwo) \
+    _X(Curve, setHandleTwo) \
+    _X(Curve, positionOne) \
+    _X(Curve, positionTwo) \
+    _X(Curve, handleOne) \
+    _X(Curve, handleOneAbsolute) \
+    _X(Curve, handleTwo) \
+    _X(Curve, handleTwoAbsolute) \
+    _X(Curve, positionAt) \
+    _X(Curve, normalAt) \
+    _X(Curve, tangentAt) \
+    _X(Curve, positionAtParameter) \
+    _X(Curve, normalAtParameter) \
+    _X(Curve, tangentAtParameter)
+
+#define PAPERLUA_BASE_GRADIENT_VEC2F_BINDINGS(_X, _XO) \
+    _X(BaseGradient, setOrigin) \
+    _X(BaseGradient, setDestination) \
+    _X(BaseGradient, origin) \
+    _X(BaseGradient, destination)
+
+#define PAPERLUA_ITEM_VEC2F_BINDINGS(_X, _XO) \
+    _X(Item, setPosition) \
+    _X(Item, setPivot) \
+    _X(Item, position) \
+    _X(Item, pivot) \
+    _XO(Item, translateTransform, void(Item::*)(const Vec2f &)) \
+    _XO(Item, translate, void(Item::*)(const Vec2f &))
+
+#define PAPERLUA_PATH_VEC2F_BINDINGS(_X, _XO) \
+    _X(Path, positionAt) \
+    _X(Path, normalAt) \
+    _X(Path, tangentAt)
+
+#define PAPERLUA_PATH_SNAPSHOT_VEC2F_BINDINGS(_X, _XO) \
+    _X(PathSnapshot, positionAt) \
+    _X(PathSnapshot, normalAt) \
+    _X(PathSnapshot, tangentAt)
+
+#define PAPERLUA_ADD_VEC2F_BINDING(_class, _name) \
+    addMemberFunction(#_name, LUANATIC_FUNCTION(&_class::_name)). \
+    addMemberFunction(#_name "XY", PAPERLUA_NUMBERS_FUNCTION(&_class::_name)).
+
+#define PAPERLUA_ADD_VEC2F_BINDING_OVERLOAD(_class, _name, _sig) \
+    addMemberFunction(#_name, LUANATIC_FUNCTION_OVERLOAD(_sig, &_class::_name)). \
+    addMemberFunction(#_name "XY", PAPERLUA_NUMBERS_FUNCTION_OVERLOAD(_sig, &_class::_name)).
+
+//Hot typed entry points that registerPaper<BindingPolicy::Unchecked> replaces with an
+//UncheckedFunction. Entries of _XO are (class, binding name, member function, signature).
+//The Item entries are also used for the classes deriving from Item.
+#define PAPERLUA_ITEM_UNCHECKED_BINDINGS(_X, _XO) \
+    _XO(Item, setFillColor, setFill, void(Item::*)(const ColorRGBA &)) \
+    _XO(Item, setStrokeColor, setStroke, void(Item::*)(const ColorRGBA &)) \
+    _X(Item, setStrokeWidth) \
+    _X(Item, setMiterLimit) \
+    _X(Item, setVisible) \
+    _X(Item, setPosition) \
+    _XO(Item, translate, translate, void(Item::*)(const Vec2f &)) \
+    _XO(Item, scale, scale, void(Item::*)(const Vec2f &)) \
+    _XO(Item, rotate, rotate, void(Item::*)(Float)) \
+    _XO(Item, rotateAround, rotate, void(Item::*)(Float, const Vec2f &)) \
+    _X(Item, strokeWidth) \
+    _X(Item, miterLimit) \
+    _X(Item, isVisible)
+
+#define PAPERLUA_PATH_UNCHECKED_BINDINGS(_X, _XO) \
+    _X(Path, length) \
+    _X(Path, area) \
+    _X(Path, isClosed) \
+    _X(Path, segmentCount) \
+    _X(Path, curveCount)
+
+#define PAPERLUA_SEGMENT_UNCHECKED_BINDINGS(_X, _XO) \
+    _X(Segment, setPosition) \
+    _X(Segment, setHandleIn) \
+    _X(Segment, setHandleOut)
+
+#define PAPERLUA_UNCHECKED_REG(_class, _name) \
+    {#_name, PAPERLUA_UNCHECKED_FUNCTION(&_class::_name)},
+
+#define PAPERLUA_UNCHECKED_REG_OVERLOAD(_class, _name, _func, _sig) \
+    {#_name, PAPERLUA_UNCHECKED_FUNCTION_OVERLOAD(_sig, &_class::_func)},
+
 namespace paperLua
 {
-    STICK_API inline void registerPaper(lua_State * _state, const stick::String & _namespace = "");
+    enum class BindingPolicy
+    {
+        //arguments are type checked and overloads resolved on every call
+        Checked,
+        //the typed entry points listed in PAPERLUA_*_UNCHECKED_BINDINGS convert their arguments
+        //without type checks, with the conversion picked at compile time. Only meant for trusted
+        //(i.e. generated) scripts, passing a wrong type is undefined behavior. Builds without
+        //NDEBUG keep the checks. Everything else, including overload sets like setFill, stays
+        //checked.
+        Unchecked
+    };
+
+    enum class RegistrationMode
+    {
+        //everything is registered right away
+        Eager,
+        //classes, functions and constants are registered the first time a script accesses the
+        //namespace table with a key it does not contain yet. Classes of objects pushed from C++
+        //are only known after that, so push them after the script touched the namespace or
+        //register eagerly. An empty namespace (the globals table) is always registered eagerly,
+        //otherwise every access to an undefined global would go through the lazy lookup.
+        Lazy
+    };
+
+    template<BindingPolicy Policy = BindingPolicy::Checked>
+    STICK_API inline void registerPaper(lua_State * _state, const stick::String & _namespace = "",
+                                        RegistrationMode _mode = RegistrationMode::Eager);
+
+    //tells the caches kept for _state (e.g. the curve indices used by path:closestPoints) that
+    //paper data was changed from C++. Changes made through the Lua bindings are tracked
+    //automatically.
+    STICK_API inline void invalidateCaches(lua_State * _state);
 
     namespace detail
     {
         using namespace paper;
 
+        template<class T>
+        inline Int32 luaDestructUserData(lua_State * _state)
+        {
+            static_cast<T *>(lua_touserdata(_state, 1))->~T();
+            return 0;
+        }
+
+        //pushes the metatable for userdata holding a plain C++ object of type T.
+        //It only has a __gc metamethod that calls the destructor.
+        template<class T>
+        inline void luaPushDestructorMetatable(lua_State * _state)
+        {
+            //the address of this static is unique per T and serves as the registry key
+            static char s_registryKey;
+            lua_rawgetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            if (lua_isnil(_state, -1))
+            {
+                lua_pop(_state, 1);
+                lua_createtable(_state, 0, 1);
+                lua_pushcfunction(_state, luaDestructUserData<T>);
+                lua_setfield(_state, -2, "__gc");
+                lua_pushvalue(_state, -1);
+                lua_rawsetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            }
+        }
+
+        //constructs a T inside a new full userdata that is left on the stack. The object is
+        //destructed when the userdata gets collected.
+        template<class T, class...Args>
+        inline T * luaNewUserData(lua_State * _state, Args && ..._args)
+        {
+            void * mem = lua_newuserdata(_state, sizeof(T));
+            T * ret = new (mem) T(std::forward<Args>(_args)...);
+            luaPushDestructorMetatable<T>(_state);
+            lua_setmetatable(_state, -2);
+            return ret;
+        }
+
+        //pushes the registry table that keeps values alive for as long as their owner is. Its
+        //keys are weak, so an entry goes away together with its owner.
+        inline void luaPushAnchorTable(lua_State * _state)
+        {
+            static char s_registryKey;
+            lua_rawgetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            if (lua_isnil(_state, -1))
+            {
+                lua_pop(_state, 1);
+                lua_newtable(_state);
+                lua_createtable(_state, 0, 1);
+                lua_pushliteral(_state, "k");
+                lua_setfield(_state, -2, "__mode");
+                lua_setmetatable(_state, -2);
+                lua_pushvalue(_state, -1);
+                lua_rawsetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            }
+        }
+
+        //keeps the value at _valueIndex alive for as long as the value at _ownerIndex is, i.e.
+        //the userdata that a non owning luanatic object points into.
+        inline void luaAnchor(lua_State * _state, Int32 _ownerIndex, Int32 _valueIndex)
+        {
+            _ownerIndex = lua_absindex(_state, _ownerIndex);
+            _valueIndex = lua_absindex(_state, _valueIndex);
+            luaPushAnchorTable(_state);
+            lua_pushvalue(_state, _ownerIndex);
+            lua_pushvalue(_state, _valueIndex);
+            lua_rawset(_state, -3);
+            lua_pop(_state, 1);
+        }
+
+        //pushes the registry table of documents created through the bindings, keyed by their
+        //address. Its values are weak, so an entry goes away together with its document.
+        inline void luaPushDocumentRegistry(lua_State * _state)
+        {
+            static char s_registryKey;
+            lua_rawgetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            if (lua_isnil(_state, -1))
+            {
+                lua_pop(_state, 1);
+                lua_newtable(_state);
+                lua_createtable(_state, 0, 1);
+                lua_pushliteral(_state, "v");
+                lua_setfield(_state, -2, "__mode");
+                lua_setmetatable(_state, -2);
+                lua_pushvalue(_state, -1);
+                lua_rawsetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            }
+        }
+
+        //remembers the value at _index as the one that keeps _document alive
+        inline void luaRegisterDocument(lua_State * _state, Int32 _index, Document * _document)
+        {
+            _index = lua_absindex(_state, _index);
+            luaPushDocumentRegistry(_state);
+            lua_pushvalue(_state, _index);
+            lua_rawsetp(_state, -2, _document);
+            lua_pop(_state, 1);
+        }
+
+        //Items don't keep their document alive. Pushes the value that does if the document was
+        //created through the bindings, nil otherwise.
+        inline void luaPushDocumentOwner(lua_State * _state, Document * _document)
+        {
+            luaPushDocumentRegistry(_state);
+            lua_rawgetp(_state, -1, _document);
+            lua_remove(_state, -2);
+        }
+
+        //returns the T that luaNewUserData constructed at _index, or nullptr if the value there
+        //is something else.
+        template<class T>
+        inline T * luaToUserData(lua_State * _state, Int32 _index)
+        {
+            if (!lua_getmetatable(_state, _index))
+                return nullptr;
+            luaPushDestructorMetatable<T>(_state);
+            bool bSame = lua_rawequal(_state, -1, -2);
+            lua_pop(_state, 2);
+            return bSame ? static_cast<T *>(lua_touserdata(_state, _index)) : nullptr;
+        }
+
+        //returns the instance of T that belongs to this lua_State, creating it on first use.
+        template<class T>
+        inline T & luaStateInstance(lua_State * _state)
+        {
+            static char s_registryKey;
+            lua_rawgetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            T * ret = static_cast<T *>(lua_touserdata(_state, -1));
+            lua_pop(_state, 1);
+            if (!ret)
+            {
+                ret = luaNewUserData<T>(_state);
+                lua_rawsetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            }
+            return *ret;
+        }
+
+        //Counts the calls of bindings that may change paper data in a lua_State, see
+        //luaWrapMutatingBindings. Caches derived from paper data remember the generation they
+        //were checked at and only look at the data again once it moved on.
+        //Bindings that only change one item in place (i.e. transform it or edit its segments) log
+        //that item, so ItemIndex can update just the changed items. Anything else (items added,
+        //removed or reordered, or a change of unknown scope) moves unknownGeneration instead.
+        struct MutationCounter
+        {
+            static constexpr Size logCapacity = 256;
+
+            MutationCounter() :
+                generation(1),
+                unknownGeneration(1),
+                logBase(0),
+                logCount(0)
+            {
+            }
+
+            void markUnknown()
+            {
+                ++generation;
+                unknownGeneration = generation;
+                logBase = generation;
+                logCount = 0;
+            }
+
+            //_item changed in place, nullptr if that is not known
+            void markItem(Item * _item)
+            {
+                if (!_item)
+                    return markUnknown();
+
+                ++generation;
+                //a loop over one item only needs one entry
+                if (logCount && logItems[logCount - 1] == _item)
+                {
+                    logGenerations[logCount - 1] = generation;
+                    return;
+                }
+                //drop the older half, caches synced before it was logged need a full walk then
+                if (logCount == logCapacity)
+                {
+                    Size half = logCapacity / 2;
+                    logBase = logGenerations[half - 1];
+                    std::copy(logItems + half, logItems + logCount, logItems);
+                    std::copy(logGenerations + half, logGenerations + logCount, logGenerations);
+                    logCount -= half;
+                }
+                logItems[logCount] = _item;
+                logGenerations[logCount++] = generation;
+            }
+
+            //sets _outItems to the items changed in place after _generation, returns false if
+            //something else changed since then or the log does not reach back that far
+            bool changedSince(stick::UInt64 _generation, Item * const *& _outItems, Size & _outCount) const
+            {
+                if (_generation < unknownGeneration || _generation < logBase)
+                    return false;
+                Size first = std::upper_bound(logGenerations, logGenerations + logCount, _generation) - logGenerations;
+                _outItems = logItems + first;
+                _outCount = logCount - first;
+                return true;
+            }
+
+            stick::UInt64 generation;
+            stick::UInt64 unknownGeneration;
+            stick::UInt64 logBase;
+            Size logCount;
+            stick::UInt64 logGenerations[logCapacity];
+            Item * logItems[logCapacity];
+        };
+
+        //the item a change of a T is logged for in MutationCounter, nullptr if unknown
+        template<class T, bool bItem = std::is_base_of<Item, T>::value>
+        struct MutatedItem
+        {
+            static Item * get(T *)
+            {
+                return nullptr;
+            }
+        };
+
+        template<class T>
+        struct MutatedItem<T, true>
+        {
+            static Item * get(T * _self)
+            {
+                return _self;
+            }
+        };
+
+        template<>
+        struct MutatedItem<Segment, false>
+        {
+            static Item * get(Segment * _self)
+            {
+                return _self->path();
+            }
+        };
+
+        template<>
+        struct MutatedItem<Curve, false>
+        {
+            static Item * get(Curve * _self)
+            {
+                return _self->path();
+            }
+        };
+
+        inline stick::UInt64 luaMutationGeneration(lua_State * _state)
+        {
+            return luaStateInstance<MutationCounter>(_state).generation;
+        }
+
+        inline void luaMarkMutation(lua_State * _state)
+        {
+            luaStateInstance<MutationCounter>(_state).markUnknown();
+        }
+
+        //_self changed in place
+        template<class T>
+        inline void luaMarkMutation(lua_State * _state, T * _self)
+        {
+            luaStateInstance<MutationCounter>(_state).markItem(MutatedItem<T>::get(_self));
+        }
+
+        //Segment, Curve and CurveLocation handles pushed through luaPushInterned are cached in
+        //this per state table with weak values, keyed by what identifies the handle. Pushing the
+        //same handle again returns the same userdata as long as it is alive, so handles compare
+        //equal with == and work as table keys, and hot loops don't create garbage.
+        inline void luaPushHandleCache(lua_State * _state)
+        {
+            static char s_registryKey;
+            lua_rawgetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            if (lua_isnil(_state, -1))
+            {
+                lua_pop(_state, 1);
+                lua_newtable(_state);
+                lua_createtable(_state, 0, 1);
+                lua_pushstring(_state, "v");
+                lua_setfield(_state, -2, "__mode");
+                lua_setmetatable(_state, -2);
+                lua_pushvalue(_state, -1);
+                lua_rawsetp(_state, LUA_REGISTRYINDEX, &s_registryKey);
+            }
+        }
+
+        enum HandleKind : char
+        {
+            HandleSegment,
+            HandleCurve,
+            HandleCurveLocation
+        };
+
+        //the key is a short binary string, lua interns those so a lookup that hits doesn't allocate.
+        //Curve locations copy data that depends on the geometry (i.e. their offset), so their keys
+        //include the mutation generation and a location pushed after a change is a new one.
+        struct HandleKey
+        {
+            HandleKey(HandleKind _kind, const Path * _path, Size _index, Float _parameter = 0, stick::UInt64 _generation = 0)
+            {
+                std::memset(data, 0, sizeof(data));
+                char * ptr = data;
+                *ptr++ = _kind;
+                std::memcpy(ptr, &_path, sizeof(_path));
+                ptr += sizeof(_path);
+                std::memcpy(ptr, &_index, sizeof(_index));
+                ptr += sizeof(_index);
+                std::memcpy(ptr, &_parameter, sizeof(_parameter));
+                ptr += sizeof(_parameter);
+                std::memcpy(ptr, &_generation, sizeof(_generation));
+            }
+
+            char data[1 + sizeof(Path *) + sizeof(Size) + sizeof(Float) + sizeof(stick::UInt64)];
+        };
+
+        template<class T>
+        inline void luaPushInterned(lua_State * _state, const HandleKey & _key, const T & _handle)
+        {
+            luaPushHandleCache(_state);
+            lua_pushlstring(_state, _key.data, sizeof(_key.data));
+            lua_pushvalue(_state, -1);
+            lua_rawget(_state, -3);
+            if (!lua_isnil(_state, -1))
+            {
+                lua_replace(_state, -3);
+                lua_pop(_state, 1);
+                return;
+            }
+            lua_pop(_state, 1);
+            luanatic::pushValueType<T>(_state, _handle);
+            lua_pushvalue(_state, -1);
+            lua_insert(_state, -4);
+            lua_rawset(_state, -3);
+            lua_pop(_state, 1);
+        }
+
+        inline void luaPushSegmentHandle(lua_State * _state, Path * _path, Size _index)
+        {
+            luaPushInterned(_state, HandleKey(HandleSegment, _path, _index), _path->segment(_index));
+        }
+
+        inline void luaPushCurveHandle(lua_State * _state, Path * _path, Size _index)
+        {
+            luaPushInterned(_state, HandleKey(HandleCurve, _path, _index), _path->curve(_index));
+        }
+
+        inline void luaPushCurveLocationHandle(lua_State * _state, const CurveLocation & _location)
+        {
+            if (!_location.isValid())
+            {
+                luanatic::pushValueType<CurveLocation>(_state, _location);
+                return;
+            }
+            Curve curve = _location.curve();
+            luaPushInterned(_state, HandleKey(HandleCurveLocation, curve.path(), curve.index(), _location.parameter(),
+                                              luaMutationGeneration(_state)), _location);
+        }
+
+        //Lua: path:segment(index) -> segment
+        inline Int32 luaSegmentHandle(lua_State * _state)
+        {
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            lua_Integer index = luaL_checkinteger(_state, 2);
+            luaL_argcheck(_state, index >= 0 && (Size)index < p->segmentCount(), 2, "segment index out of range");
+            luaPushSegmentHandle(_state, p, (Size)index);
+            return 1;
+        }
+
+        //Lua: path:curve(index) -> curve
+        inline Int32 luaCurveHandle(lua_State * _state)
+        {
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            lua_Integer index = luaL_checkinteger(_state, 2);
+            luaL_argcheck(_state, index >= 0 && (Size)index < p->curveCount(), 2, "curve index out of range");
+            luaPushCurveHandle(_state, p, (Size)index);
+            return 1;
+        }
+
+        //Lua: path:curveLocationAt(offset) -> curveLocation
+        inline Int32 luaPathCurveLocationAt(lua_State * _state)
+        {
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            luaPushCurveLocationHandle(_state, p->curveLocationAt(luaL_checknumber(_state, 2)));
+            return 1;
+        }
+
+        //Lua: curve:curveLocationAt(offset) -> curveLocation
+        inline Int32 luaCurveCurveLocationAt(lua_State * _state)
+        {
+            Curve * c = luanatic::convertToTypeAndCheck<Curve>(_state, 1);
+            luaPushCurveLocationHandle(_state, c->curveLocationAt(luaL_checknumber(_state, 2)));
+            return 1;
+        }
+
+        //Lua: path:extrema() -> array of curveLocations
+        inline Int32 luaExtrema(lua_State * _state)
+        {
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            lua_newtable(_state);
+            {
+                auto extrema = p->extrema();
+                for (Size i = 0; i < extrema.count(); ++i)
+                {
+                    luaPushCurveLocationHandle(_state, extrema[i]);
+                    lua_rawseti(_state, -2, (Int32)i + 1);
+                }
+            }
+            return 1;
+        }
+
         inline Int32 luaClosestCurveLocation(lua_State * _state)
         {
             Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
             Float dist;
             auto cl = p->closestCurveLocation(luanatic::detail::Converter<const Vec2f &>::convert(_state, 2), dist);
-            luanatic::pushValueType<CurveLocation>(_state, cl);
+            luaPushCurveLocationHandle(_state, cl);
             lua_pushnumber(_state, dist);
             return 2;
         }
 
-        inline Int32 luaIntersections(lua_State * _state)
+        template<class A>
+        struct NumbersArgument
         {
-            Path * a = luanatic::convertToTypeAndCheck<Path>(_state, 1);
-            Path * b = luanatic::convertToTypeAndCheck<Path>(_state, 2);
-            auto inter = a->intersections(b);
-            if (inter.count())
+            static A read(lua_State * _state, Int32 & _index)
             {
-                lua_createtable(_state, inter.count(), 0);
-                for (stick::Int32 i = 0; i < inter.count(); ++i)
-                {
-                    lua_pushinteger(_state, i + 1);
-                    lua_newtable(_state);
-                    luanatic::pushValueType<CurveLocation>(_state, inter[i].location);
-                    lua_setfield(_state, -2, "location");
-                    luanatic::pushValueType<Vec2f>(_state, inter[i].position);
-                    lua_setfield(_state, -2, "position");
-                    lua_settable(_state, -3);
-                }
+                return (A)luaL_checknumber(_state, _index++);
             }
-            else
-                lua_pushnil(_state);
+        };
+
+        template<>
+        struct NumbersArgument<const Vec2f &>
+        {
+            static Vec2f read(lua_State * _state, Int32 & _index)
+            {
+                Float x = (Float)luaL_checknumber(_state, _index++);
+                Float y = (Float)luaL_checknumber(_state, _index++);
+                return Vec2f(x, y);
+            }
+        };
+
+        inline Int32 luaPushNumbers(lua_State * _state, const Vec2f & _value)
+        {
+            lua_pushnumber(_state, _value.x);
+            lua_pushnumber(_state, _value.y);
+            return 2;
+        }
+
+        inline Int32 luaPushNumbers(lua_State * _state, Float _value)
+        {
+            lua_pushnumber(_state, _value);
             return 1;
         }
 
+        template<class R>
+        struct NumbersReturn
+        {
+            template<class T, class F, class...Args>
+            static Int32 invoke(lua_State * _state, T * _self, F _func, Args && ..._args)
+            {
+                return luaPushNumbers(_state, (_self->*_func)(std::forward<Args>(_args)...));
+            }
+        };
 
-        template<class CV>
-        struct LuaContainerViewSession
+        template<>
+        struct NumbersReturn<void>
         {
-            CV view;
-            typename CV::ValueType tmp;
-            typename CV::Iter iter;
+            template<class T, class F, class...Args>
+            static Int32 invoke(lua_State * _state, T * _self, F _func, Args && ..._args)
+            {
+                (_self->*_func)(std::forward<Args>(_args)...);
+                return 0;
+            }
         };
 
-        template<class CV>
-        inline Int32 luaContainerViewIteratorFunction(lua_State * _state)
+        //turns a member function that returns and/or takes a Vec2f into a lua_CFunction
+        //that returns and/or takes plain x, y numbers instead, so no Vec2f userdata is created.
+        //Non const member functions mark the mutation themselves, so they don't need the
+        //wrapper of luaWrapMutatingBindings.
+        template<class F, F Func>
+        struct NumbersFunction;
+
+        template<class T, class R, R(T::*Func)() const>
+        struct NumbersFunction<R(T::*)() const, Func>
         {
-            STICK_ASSERT(lua_isuserdata(_state, lua_upvalueindex(1)));
-            LuaContainerViewSession<CV> * session = static_cast<LuaContainerViewSession<CV> *>(lua_touserdata(_state, lua_upvalueindex(1)));
-            STICK_ASSERT(session);
-            if (session->iter != session->view.end())
+            static Int32 func(lua_State * _state)
             {
-                session->tmp = *session->iter++;
-                luanatic::push<typename CV::ValueType>(_state, &session->tmp, false);
+                T * self = luanatic::convertToTypeAndCheck<T>(_state, 1);
+                return NumbersReturn<R>::invoke(_state, self, Func);
             }
-            else
+        };
+
+        template<class T, class R, R(T::*Func)()>
+        struct NumbersFunction<R(T::*)(), Func>
+        {
+            static Int32 func(lua_State * _state)
             {
-                //we reached the end
-                lua_pushnil(_state);
-                stick::defaultAllocator().destroy(session);
+                T * self = luanatic::convertToTypeAndCheck<T>(_state, 1);
+                luaMarkMutation(_state, self);
+                return NumbersReturn<R>::invoke(_state, self, Func);
             }
+        };
 
-            return 1;
-        }
+        template<class T, class R, class A, R(T::*Func)(A) const>
+        struct NumbersFunction<R(T::*)(A) const, Func>
+        {
+            static Int32 func(lua_State * _state)
+            {
+                T * self = luanatic::convertToTypeAndCheck<T>(_state, 1);
+                Int32 idx = 2;
+                auto arg = NumbersArgument<A>::read(_state, idx);
+                return NumbersReturn<R>::invoke(_state, self, Func, arg);
+            }
+        };
 
-        template<class CV, CV(Path::*Getter)()>
-        inline Int32 luaPushContainerView(lua_State * _state)
+        template<class T, class R, class A, R(T::*Func)(A)>
+        struct NumbersFunction<R(T::*)(A), Func>
         {
-            Path * path = luanatic::convertToTypeAndCheck<Path>(_state, 1);
-            LuaContainerViewSession<CV> * session = stick::defaultAllocator().create<LuaContainerViewSession<CV>>();
-            session->view = (path->*Getter)();
-            session->iter = session->view.begin();
-            lua_pushlightuserdata(_state, session);
-            lua_pushcclosure(_state, luaContainerViewIteratorFunction<CV>, 1);
-            return 1;
-        }
-    }
+            static Int32 func(lua_State * _state)
+            {
+                T * self = luanatic::convertToTypeAndCheck<T>(_state, 1);
+                Int32 idx = 2;
+                auto arg = NumbersArgument<A>::read(_state, idx);
+                luaMarkMutation(_state, self);
+                return NumbersReturn<R>::invoke(_state, self, Func, arg);
+            }
+        };
 
-    inline void registerPaper(lua_State * _state, const stick::String & _namespace)
-    {
-        using namespace luanatic;
-        using namespace paper;
-        using namespace stick;
-
-        LuaValue g = globalsTable(_state);
-        LuaValue namespaceTable = g;
-        if (!_namespace.isEmpty())
-        {
-            auto tokens = path::segments(_namespace, '.');
-            for (const String & token : tokens)
-            {
-                LuaValue table = namespaceTable.findOrCreateTable(token);
-                namespaceTable = table;
-            }
-        }
-
-        //register constants
-        LuaValue strokeJoinTable = namespaceTable.findOrCreateTable("StrokeJoin");
-        strokeJoinTable["Miter"].set(StrokeJoin::Miter);
-        strokeJoinTable["Round"].set(StrokeJoin::Round);
-        strokeJoinTable["Bevel"].set(StrokeJoin::Bevel);
-
-        LuaValue strokeCapTable = namespaceTable.findOrCreateTable("StrokeCap");
-        strokeCapTable["Round"].set(StrokeCap::Round);
-        strokeCapTable["Square"].set(StrokeCap::Square);
-        strokeCapTable["Butt"].set(StrokeCap::Butt);
-
-        LuaValue windingRuleTable = namespaceTable.findOrCreateTable("WindingRule");
-        windingRuleTable["EvenOdd"].set(WindingRule::EvenOdd);
-        windingRuleTable["NonZero"].set(WindingRule::NonZero);
-
-        LuaValue smoothingTypeTable = namespaceTable.findOrCreateTable("Smoothing");
-        smoothingTypeTable["Continuous"].set(Smoothing::Continuous);
-        smoothingTypeTable["Asymmetric"].set(Smoothing::Asymmetric);
-        smoothingTypeTable["CatmullRom"].set(Smoothing::CatmullRom);
-        smoothingTypeTable["Geometric"].set(Smoothing::Geometric);
-
-        LuaValue itemTypeTable = namespaceTable.findOrCreateTable("ItemType");
-        itemTypeTable["Document"].set(ItemType::Document);
-        itemTypeTable["Group"].set(ItemType::Group);
-        itemTypeTable["Path"].set(ItemType::Path);
-        itemTypeTable["Symbol"].set(ItemType::Symbol);
-        itemTypeTable["Unknown"].set(ItemType::Unknown);
-
-        ClassWrapper<Segment> segmentCW("Segment");
-        segmentCW.
-        addMemberFunction("setPosition", LUANATIC_FUNCTION(&Segment::setPosition)).
-        addMemberFunction("setHandleIn", LUANATIC_FUNCTION(&Segment::setHandleIn)).
-        addMemberFunction("setHandleOut", LUANATIC_FUNCTION(&Segment::setHandleOut)).
-        addMemberFunction("position", LUANATIC_FUNCTION(&Segment::position)).
-        addMemberFunction("handleIn", LUANATIC_FUNCTION(&Segment::handleIn)).
-        addMemberFunction("handleOut", LUANATIC_FUNCTION(&Segment::handleOut)).
-        addMemberFunction("handleInAbsolute", LUANATIC_FUNCTION(&Segment::handleInAbsolute)).
-        addMemberFunction("handleOutAbsolute", LUANATIC_FUNCTION(&Segment::handleOutAbsolute)).
-        addMemberFunction("isLinear", LUANATIC_FUNCTION(&Segment::isLinear)).
-        addMemberFunction("remove", LUANATIC_FUNCTION(&Segment::remove));
-
-        namespaceTable.registerClass(segmentCW);
-
-        ClassWrapper<CurveLocation> curveLocationCW("CurveLocation");
-        curveLocationCW.
-        addMemberFunction("position", LUANATIC_FUNCTION(&CurveLocation::position)).
-        addMemberFunction("normal", LUANATIC_FUNCTION(&CurveLocation::normal)).
-        addMemberFunction("tangent", LUANATIC_FUNCTION(&CurveLocation::tangent)).
-        addMemberFunction("curvature", LUANATIC_FUNCTION(&CurveLocation::curvature)).
-        addMemberFunction("angle", LUANATIC_FUNCTION(&CurveLocation::angle)).
-        addMemberFunction("parameter", LUANATIC_FUNCTION(&CurveLocation::parameter)).
-        addMemberFunction("offset", LUANATIC_FUNCTION(&CurveLocation::offset)).
-        addMemberFunction("isValid", LUANATIC_FUNCTION(&CurveLocation::isValid)).
-        addMemberFunction("curve", LUANATIC_FUNCTION(&CurveLocation::curve));
-
-        namespaceTable.registerClass(curveLocationCW);
-
-        ClassWrapper<Curve> curveCW("Curve");
-        curveCW.
-        addMemberFunction("path", LUANATIC_FUNCTION(&Curve::path)).
-        addMemberFunction("setPositionOne", LUANATIC_FUNCTION(&Curve::setPositionOne)).
-        addMemberFunction("setHandleOne", LUANATIC_FUNCTION(&Curve::setHandleOne)).
-        addMemberFunction("setPositionTwo", LUANATIC_FUNCTION(&Curve::setPositionTwo)).
-        addMemberFunction("setHandleTwo", LUANATIC_FUNCTION(&Curve::setHandleTwo)).
-        addMemberFunction("positionOne", LUANATIC_FUNCTION(&Curve::positionOne)).
-        addMemberFunction("positionTwo", LUANATIC_FUNCTION(&Curve::positionTwo)).
-        addMemberFunction("handleOne", LUANATIC_FUNCTION(&Curve::handleOne)).
-        addMemberFunction("handleOneAbsolute", LUANATIC_FUNCTION(&Curve::handleOneAbsolute)).
-        addMemberFunction("handleTwo", LUANATIC_FUNCTION(&Curve::handleTwo)).
-        addMemberFunction("handleTwoAbsolute", LUANATIC_FUNCTION(&Curve::handleTwoAbsolute)).
-        addMemberFunction("positionAt", LUANATIC_FUNCTION(&Curve::positionAt)).
-        addMemberFunction("normalAt", LUANATIC_FUNCTION(&Curve::normalAt)).
-        addMemberFunction("tangentAt", LUANATIC_FUNCTION(&Curve::tangentAt)).
-        addMemberFunction("curvatureAt", LUANATIC_FUNCTION(&Curve::curvatureAt)).
-        addMemberFunction("angleAt", LUANATIC_FUNCTION(&Curve::angleAt)).
-        addMemberFunction("positionAtParameter", LUANATIC_FUNCTION(&Curve::positionAtParameter)).
-        addMemberFunction("normalAtParameter", LUANATIC_FUNCTION(&Curve::normalAtParameter)).
-        addMemberFunction("tangentAtParameter", LUANATIC_FUNCTION(&Curve::tangentAtParameter)).
-        addMemberFunction("curvatureAtParameter", LUANATIC_FUNCTION(&Curve::curvatureAtParameter)).
-        addMemberFunction("angleAtParameter", LUANATIC_FUNCTION(&Curve::angleAtParameter)).
-        addMemberFunction("parameterAtOffset", LUANATIC_FUNCTION(&Curve::parameterAtOffset)).
-        addMemberFunction("closestParameter", LUANATIC_FUNCTION_OVERLOAD(Float(Curve::*)(const Vec2f &)const, &Curve::closestParameter)).
-        addMemberFunction("lengthBetween", LUANATIC_FUNCTION(&Curve::lengthBetween)).
-        addMemberFunction("pathOffset", LUANATIC_FUNCTION(&Curve::pathOffset)).
-        addMemberFunction("closestCurveLocation", LUANATIC_FUNCTION(&Curve::closestCurveLocation)).
-        addMemberFunction("curveLocationAt", LUANATIC_FUNCTION(&Curve::curveLocationAt)).
-        addMemberFunction("curveLocationAtParameter", LUANATIC_FUNCTION(&Curve::curveLocationAtParameter)).
-        addMemberFunction("isLinear", LUANATIC_FUNCTION(&Curve::isLinear)).
-        addMemberFunction("isStraight", LUANATIC_FUNCTION(&Curve::isStraight)).
-        addMemberFunction("isArc", LUANATIC_FUNCTION(&Curve::isArc)).
-        addMemberFunction("isOrthogonal", LUANATIC_FUNCTION(&Curve::isOrthogonal)).
-        addMemberFunction("isCollinear", LUANATIC_FUNCTION(&Curve::isCollinear)).
-        addMemberFunction("length", LUANATIC_FUNCTION(&Curve::length)).
-        addMemberFunction("area", LUANATIC_FUNCTION(&Curve::area)).
-        addMemberFunction("divideAt", LUANATIC_FUNCTION(&Curve::divideAt)).
-        addMemberFunction("divideAtParameter", LUANATIC_FUNCTION(&Curve::divideAtParameter)).
-        addMemberFunction("bounds", LUANATIC_FUNCTION_OVERLOAD(const Rect & (Curve::*)()const, &Curve::bounds)).
-        addMemberFunction("boundsWithPadding", LUANATIC_FUNCTION_OVERLOAD(Rect(Curve::*)(Float)const, &Curve::bounds));
-
-        namespaceTable.registerClass(curveCW);
-
-        ClassWrapper<NoPaint> noPaintCW("NoPaint");
-        noPaintCW.
-        addConstructor<>();
-
-        namespaceTable.registerClass(noPaintCW);
-
-        ClassWrapper<BaseGradient> baseGradientCW("BaseGradient");
-        baseGradientCW.
-        addMemberFunction("setOrigin", LUANATIC_FUNCTION(&BaseGradient::setOrigin)).
-        addMemberFunction("setDestination", LUANATIC_FUNCTION(&BaseGradient::setDestination)).
-        addMemberFunction("addStop", LUANATIC_FUNCTION(&BaseGradient::addStop)).
-        addMemberFunction("origin", LUANATIC_FUNCTION(&BaseGradient::origin)).
-        addMemberFunction("destination", LUANATIC_FUNCTION(&BaseGradient::destination)).
-        addMemberFunction("stops", LUANATIC_FUNCTION(&BaseGradient::stops, ReturnIterator<ph::Result>));
-
-        namespaceTable.registerClass(baseGradientCW);
-
-        ClassWrapper<LinearGradient> linearGradientCW("LinearGradient");
-        linearGradientCW.
-        addBase<BaseGradient>();
-
-        namespaceTable.
-        registerClass(linearGradientCW).
-        addWrapper<LinearGradient, LinearGradientPtr>();
-
-        ClassWrapper<RadialGradient> radialGradientCW("RadialGradient");
-        radialGradientCW.
-        addBase<BaseGradient>().
-        addMemberFunction("setFocalPointOffset", LUANATIC_FUNCTION(&RadialGradient::setFocalPointOffset)).
-        addMemberFunction("setRatio", LUANATIC_FUNCTION(&RadialGradient::setRatio)).
-        addMemberFunction("focalPointOffset", LUANATIC_FUNCTION(&RadialGradient::focalPointOffset)).
-        addMemberFunction("ratio", LUANATIC_FUNCTION(&RadialGradient::ratio));
-
-        namespaceTable.
-        registerClass(radialGradientCW).
-        addWrapper<RadialGradient, RadialGradientPtr>();
-
-        ClassWrapper<Item> itemCW("Item");
-        itemCW.
-        addMemberFunction("addChild", LUANATIC_FUNCTION(&Item::addChild)).
-        addMemberFunction("insertAbove", LUANATIC_FUNCTION(&Item::insertAbove)).
-        addMemberFunction("insertBelow", LUANATIC_FUNCTION(&Item::insertBelow)).
-        addMemberFunction("sendToFront", LUANATIC_FUNCTION(&Item::sendToFront)).
-        addMemberFunction("sendToBack", LUANATIC_FUNCTION(&Item::sendToBack)).
-        addMemberFunction("reverseChildren", LUANATIC_FUNCTION(&Item::reverseChildren)).
-        addMemberFunction("remove", LUANATIC_FUNCTION(&Item::remove)).
-        addMemberFunction("removeChildren", LUANATIC_FUNCTION(&Item::removeChildren)).
-        addMemberFunction("name", LUANATIC_FUNCTION(&Item::name)).
-        addMemberFunction("parent", LUANATIC_FUNCTION(&Item::parent)).
-        addMemberFunction("setPosition", LUANATIC_FUNCTION(&Item::setPosition)).
-        addMemberFunction("setPivot", LUANATIC_FUNCTION(&Item::setPivot)).
-        addMemberFunction("setVisible", LUANATIC_FUNCTION(&Item::setVisible)).
-        addMemberFunction("setName", LUANATIC_FUNCTION(&Item::setName)).
-        addMemberFunction("setTransform", LUANATIC_FUNCTION(&Item::setTransform)).
-        addMemberFunction("translateTransform", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Vec2f &), &Item::translateTransform)).
-        addMemberFunction("scaleTransform", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Vec2f &), &Item::scaleTransform)).
-        addMemberFunction("scaleAroundTransform", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Vec2f &, const Vec2f &), &Item::scaleTransform)).
-        addMemberFunction("rotateTransform", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(Float), &Item::rotateTransform)).
-        addMemberFunction("rotateAroundTransform", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(Float, const Vec2f &), &Item::rotateTransform)).
-        addMemberFunction("transformItem", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Mat32f &), &Item::transform)).
-        addMemberFunction("translate", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Vec2f &), &Item::translate)).
-        addMemberFunction("scale", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Vec2f &), &Item::scale)).
-        addMemberFunction("rotate", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(Float), &Item::rotate)).
-        addMemberFunction("rotateAround", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(Float, const Vec2f &), &Item::rotate)).
-        addMemberFunction("applyTransform", LUANATIC_FUNCTION(&Item::applyTransform)).
-        addMemberFunction("transform", LUANATIC_FUNCTION_OVERLOAD(const Mat32f & (Item::*)()const, &Item::transform)).
-        addMemberFunction("rotation", LUANATIC_FUNCTION(&Item::rotation)).
-        addMemberFunction("translation", LUANATIC_FUNCTION(&Item::translation)).
-        addMemberFunction("scaling", LUANATIC_FUNCTION(&Item::scaling)).
-        addMemberFunction("absoluteRotation", LUANATIC_FUNCTION(&Item::absoluteRotation)).
-        addMemberFunction("absoluteTranslation", LUANATIC_FUNCTION(&Item::absoluteTranslation)).
-        addMemberFunction("absoluteScaling", LUANATIC_FUNCTION(&Item::absoluteScaling)).
-        addMemberFunction("bounds", LUANATIC_FUNCTION(&Item::bounds)).
-        addMemberFunction("handleBounds", LUANATIC_FUNCTION(&Item::handleBounds)).
-        addMemberFunction("strokeBounds", LUANATIC_FUNCTION(&Item::strokeBounds)).
-        addMemberFunction("position", LUANATIC_FUNCTION(&Item::position)).
-        addMemberFunction("pivot", LUANATIC_FUNCTION(&Item::pivot)).
-        addMemberFunction("isVisible", LUANATIC_FUNCTION(&Item::isVisible)).
-        addMemberFunction("setStrokeJoin", LUANATIC_FUNCTION(&Item::setStrokeJoin)).
-        addMemberFunction("setStrokeCap", LUANATIC_FUNCTION(&Item::setStrokeCap)).
-        addMemberFunction("setMiterLimit", LUANATIC_FUNCTION(&Item::setMiterLimit)).
-        addMemberFunction("setStrokeWidth", LUANATIC_FUNCTION(&Item::setStrokeWidth)).
-        addMemberFunction("setDashArray", LUANATIC_FUNCTION(&Item::setDashArray)).
-        addMemberFunction("setDashOffset", LUANATIC_FUNCTION(&Item::setDashOffset)).
-        addMemberFunction("setScaleStroke", LUANATIC_FUNCTION(&Item::setScaleStroke)).
-        addMemberFunction("setStrokeColor", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const ColorRGBA &), &Item::setStroke)).
-        addMemberFunction("setStrokeString", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const stick::String &), &Item::setStroke)).
-        addMemberFunction("setStrokeLinearGradient", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const LinearGradientPtr &), &Item::setStroke)).
-        addMemberFunction("setStrokeRadialGradient", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const RadialGradientPtr &), &Item::setStroke)).
-        addMemberFunction("setStroke", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const ColorRGBA &), &Item::setStroke)).
-        addMemberFunction("setStroke", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const stick::String &), &Item::setStroke)).
-        addMemberFunction("setStroke", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const LinearGradientPtr &), &Item::setStroke)).
-        addMemberFunction("setStroke", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const RadialGradientPtr &), &Item::setStroke)).
-        addMemberFunction("removeStroke", LUANATIC_FUNCTION(&Item::removeStroke)).
-        addMemberFunction("setFillColor", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const ColorRGBA &), &Item::setFill)).
-        addMemberFunction("setFillString", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const stick::String &), &Item::setFill)).
-        addMemberFunction("setFillLinearGradient", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const LinearGradientPtr &), &Item::setFill)).
-        addMemberFunction("setFillRadialGradient", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const RadialGradientPtr &), &Item::setFill)).
-        addMemberFunction("setFill", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const ColorRGBA &), &Item::setFill)).
-        addMemberFunction("setFill", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const stick::String &), &Item::setFill)).
-        addMemberFunction("setFill", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const LinearGradientPtr &), &Item::setFill)).
-        addMemberFunction("setFill", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const RadialGradientPtr &), &Item::setFill)).
-        addMemberFunction("removeFill", LUANATIC_FUNCTION(&Item::removeFill)).
-        addMemberFunction("setWindingRule", LUANATIC_FUNCTION(&Item::setWindingRule)).
-        addMemberFunction("strokeJoin", LUANATIC_FUNCTION(&Item::strokeJoin)).
-        addMemberFunction("strokeCap", LUANATIC_FUNCTION(&Item::strokeCap)).
-        addMemberFunction("miterLimit", LUANATIC_FUNCTION(&Item::miterLimit)).
-        addMemberFunction("strokeWidth", LUANATIC_FUNCTION(&Item::strokeWidth)).
-        addMemberFunction("dashArray", LUANATIC_FUNCTION(&Item::dashArray)).
-        addMemberFunction("dashOffset", LUANATIC_FUNCTION(&Item::dashOffset)).
-        addMemberFunction("windingRule", LUANATIC_FUNCTION(&Item::windingRule)).
-        addMemberFunction("scaleStroke", LUANATIC_FUNCTION(&Item::scaleStroke)).
-        addMemberFunction("fill", LUANATIC_FUNCTION(&Item::fill)).
-        addMemberFunction("stroke", LUANATIC_FUNCTION(&Item::stroke)).
-        addMemberFunction("hasStroke", LUANATIC_FUNCTION(&Item::hasStroke)).
-        addMemberFunction("hasFill", LUANATIC_FUNCTION(&Item::hasFill)).
-        addMemberFunction("clone", LUANATIC_FUNCTION(&Item::clone)).
-        addMemberFunction("document", LUANATIC_FUNCTION(&Item::document)).
-        addMemberFunction("itemType", LUANATIC_FUNCTION(&Item::itemType)).
-        addMemberFunction("children", LUANATIC_FUNCTION(&Item::children, ReturnIterator<ph::Result>)).
-        addMemberFunction("exportSVG", LUANATIC_FUNCTION(&Item::exportSVG)).
-        addMemberFunction("saveSVG", LUANATIC_FUNCTION(&Item::saveSVG));
-
-        namespaceTable.registerClass(itemCW);
-
-        ClassWrapper<Group> groupCW("Group");
-        groupCW.
-        addBase<Item>().
-        addMemberFunction("setClipped", LUANATIC_FUNCTION(&Group::setClipped)).
-        addMemberFunction("isClipped", LUANATIC_FUNCTION(&Group::isClipped));
-
-        namespaceTable.registerClass(groupCW);
-
-        ClassWrapper<Path> pathCW("Path");
-        pathCW.
-        addBase<Item>().
-        addMemberFunction("addPoint", LUANATIC_FUNCTION(&Path::addPoint)).
-        addMemberFunction("cubicCurveTo", LUANATIC_FUNCTION(&Path::cubicCurveTo)).
-        addMemberFunction("quadraticCurveTo", LUANATIC_FUNCTION(&Path::quadraticCurveTo)).
-        addMemberFunction("curveTo", LUANATIC_FUNCTION(&Path::curveTo)).
-        addMemberFunction("arcThrough", LUANATIC_FUNCTION_OVERLOAD(Error(Path::*)(const Vec2f &, const Vec2f &), &Path::arcTo)).
-        addMemberFunction("arcTo", LUANATIC_FUNCTION_OVERLOAD(Error(Path::*)(const Vec2f &, bool), &Path::arcTo)).
-        addMemberFunction("cubicCurveBy", LUANATIC_FUNCTION(&Path::cubicCurveBy)).
-        addMemberFunction("quadraticCurveBy", LUANATIC_FUNCTION(&Path::quadraticCurveBy)).
-        addMemberFunction("curveBy", LUANATIC_FUNCTION(&Path::curveBy)).
-        addMemberFunction("closePath", LUANATIC_FUNCTION(&Path::closePath)).
-        addMemberFunction("smooth", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(Smoothing, bool), &Path::smooth)).
-        addMemberFunction("smoothFromTo", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(Int64, Int64, Smoothing), &Path::smooth)).
-        addMemberFunction("simplify", LUANATIC_FUNCTION(&Path::simplify)).
-        addMemberFunction("addSegment", LUANATIC_FUNCTION(&Path::addSegment)).
-        addMemberFunction("removeSegment", LUANATIC_FUNCTION(&Path::removeSegment)).
-        addMemberFunction("removeSegmentsFrom", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(Size), &Path::removeSegments)).
-        addMemberFunction("removeSegmentsFromTo", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(Size, Size), &Path::removeSegments)).
-        addMemberFunction("removeSegments", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(), &Path::removeSegments)).
-        addMemberFunction("segments", detail::luaPushContainerView<SegmentView, &Path::segments>).
-        addMemberFunction("curves", detail::luaPushContainerView<CurveView, &Path::curves>).
-        addMemberFunction("positionAt", LUANATIC_FUNCTION(&Path::positionAt)).
-        addMemberFunction("normalAt", LUANATIC_FUNCTION(&Path::normalAt)).
-        addMemberFunction("tangentAt", LUANATIC_FUNCTION(&Path::tangentAt)).
-        addMemberFunction("curvatureAt", LUANATIC_FUNCTION(&Path::curvatureAt)).
-        addMemberFunction("angleAt", LUANATIC_FUNCTION(&Path::angleAt)).
-        addMemberFunction("reverse", LUANATIC_FUNCTION(&Path::reverse)).
-        addMemberFunction("setClockwise", LUANATIC_FUNCTION(&Path::setClockwise)).
-        addMemberFunction("flatten", LUANATIC_FUNCTION(&Path::flatten)).
-        addMemberFunction("flattenRegular", LUANATIC_FUNCTION(&Path::flattenRegular)).
-        addMemberFunction("regularOffset", LUANATIC_FUNCTION(&Path::regularOffset)).
-        addMemberFunction("closestCurveLocation", &detail::luaClosestCurveLocation).
-        addMemberFunction("curveLocationAt", LUANATIC_FUNCTION(&Path::curveLocationAt)).
-        addMemberFunction("length", LUANATIC_FUNCTION(&Path::length)).
-        addMemberFunction("area", LUANATIC_FUNCTION(&Path::area)).
-        addMemberFunction("extrema", LUANATIC_FUNCTION_OVERLOAD(stick::DynamicArray<CurveLocation> (Path::*)()const, &Path::extrema)).
-        addMemberFunction("isClosed", LUANATIC_FUNCTION(&Path::isClosed)).
-        addMemberFunction("isClockwise", LUANATIC_FUNCTION(&Path::isClockwise)).
-        addMemberFunction("contains", LUANATIC_FUNCTION(&Path::contains)).
-        addMemberFunction("segment", LUANATIC_FUNCTION_OVERLOAD(Segment (Path::*)(stick::Size), &Path::segment)).
-        addMemberFunction("curve", LUANATIC_FUNCTION_OVERLOAD(Curve (Path::*)(stick::Size), &Path::curve)).
-        addMemberFunction("segmentCount", LUANATIC_FUNCTION(&Path::segmentCount)).
-        addMemberFunction("curveCount", LUANATIC_FUNCTION(&Path::curveCount)).
-        addMemberFunction("intersections", detail::luaIntersections).
-        addMemberFunction("slice", LUANATIC_FUNCTION_OVERLOAD(Path * (Path::*)(CurveLocation, CurveLocation)const, &Path::slice)).
-        addMemberFunction("slice", LUANATIC_FUNCTION_OVERLOAD(Path * (Path::*)(Float, Float)const, &Path::slice));
-
-        namespaceTable.registerClass(pathCW);
-
-        ClassWrapper<Document> docCW("Document");
-        docCW.
-        addBase<Item>().
-        addConstructor<>().
-        addConstructor<const char *>().
-        addConstructor("new").
-        addConstructor<const char *>("newWithName").
-        addMemberFunction("createGroup", LUANATIC_FUNCTION(&Document::createGroup), "").
-        addMemberFunction("createPath", LUANATIC_FUNCTION(&Document::createPath), "").
-        addMemberFunction("createEllipse", LUANATIC_FUNCTION(&Document::createEllipse), "").
-        addMemberFunction("createCircle", LUANATIC_FUNCTION(&Document::createCircle), "").
-        addMemberFunction("createRectangle", LUANATIC_FUNCTION(&Document::createRectangle), "").
-        addMemberFunction("createRoundedRectangle", LUANATIC_FUNCTION(&Document::createRoundedRectangle), "").
-        addMemberFunction("setSize", LUANATIC_FUNCTION(&Document::setSize)).
-        addMemberFunction("width", LUANATIC_FUNCTION(&Document::width)).
-        addMemberFunction("height", LUANATIC_FUNCTION(&Document::height)).
-        addMemberFunction("size", LUANATIC_FUNCTION(&Document::size));
-        // addMemberFunction("parseSVG", detail::luaParseSVG).
-        // addMemberFunction("loadSVG", detail::luaLoadSVG);
-
-        namespaceTable.
-        registerClass(docCW).
-        registerFunction("createLinearGradient", LUANATIC_FUNCTION(&createLinearGradient)).
-        registerFunction("createRadialGradient", LUANATIC_FUNCTION(&createRadialGradient));
-
-        ClassWrapper<RenderInterface> rendererCW("RenderInterface");
-        rendererCW.
-        addMemberFunction("setViewport", LUANATIC_FUNCTION(&RenderInterface::setViewport)).
-        addMemberFunction("setProjection", LUANATIC_FUNCTION(&RenderInterface::setProjection)).
-        addMemberFunction("document", LUANATIC_FUNCTION(&RenderInterface::document)).
-        addMemberFunction("draw", LUANATIC_FUNCTION(&RenderInterface::draw));
-
-        namespaceTable.registerClass(rendererCW);
-
-        //TODO allow to specify which renderer to register via macro or template or possibly put
-        //it into a separate function?
-        ClassWrapper<tarp::TarpRenderer> tarpRendererCW("TarpRenderer");
-        tarpRendererCW.
-        addBase<RenderInterface>().
-        addConstructor<>().
-        addMemberFunction("init", LUANATIC_FUNCTION(&tarp::TarpRenderer::init));
-
-        namespaceTable.registerClass(tarpRendererCW);
+        //argument conversion of UncheckedFunction. Numbers and booleans are read straight off the
+        //stack, everything else (Vec2f, ColorRGBA) goes through luanatic's converter without the
+        //type check. Builds without NDEBUG check anyway.
+        template<class A, bool bNumber = std::is_arithmetic<typename std::decay<A>::type>::value>
+        struct UncheckedArgument
+        {
+            using ValueType = typename std::decay<A>::type;
+
+            static ValueType read(lua_State * _state, Int32 _index)
+            {
+#ifndef NDEBUG
+                return *luanatic::convertToTypeAndCheck<ValueType>(_state, _index);
+#else
+                return luanatic::detail::Converter<A>::convert(_state, _index);
+#endif
+            }
+        };
+
+        template<class A>
+        struct UncheckedArgument<A, true>
+        {
+            static A read(lua_State * _state, Int32 _index)
+            {
+#ifndef NDEBUG
+                return (A)luaL_checknumber(_state, _index);
+#else
+                return (A)lua_tonumber(_state, _index);
+#endif
+            }
+        };
+
+        template<>
+        struct UncheckedArgument<bool, true>
+        {
+            static bool read(lua_State * _state, Int32 _index)
+            {
+#ifndef NDEBUG
+                luaL_checktype(_state, _index, LUA_TBOOLEAN);
+#endif
+                return lua_toboolean(_state, _index) != 0;
+            }
+        };
+
+        //self still goes through luanatic so that Item functions called on a Path get the right
+        //pointer. Only the error reporting is skipped.
+        template<class T>
+        inline T * luaUncheckedSelf(lua_State * _state)
+        {
+#ifndef NDEBUG
+            return luanatic::convertToTypeAndCheck<T>(_state, 1);
+#else
+            return luanatic::convertToType<T>(_state, 1);
+#endif
+        }
+
+        template<class R>
+        struct UncheckedReturn
+        {
+            static_assert(std::is_arithmetic<R>::value, "unchecked bindings only return numbers and booleans");
+
+            template<class T, class F, class...Args>
+            static Int32 invoke(lua_State * _state, T * _self, F _func, Args && ..._args)
+            {
+                lua_pushnumber(_state, (lua_Number)(_self->*_func)(std::forward<Args>(_args)...));
+                return 1;
+            }
+        };
+
+        template<>
+        struct UncheckedReturn<bool>
+        {
+            template<class T, class F, class...Args>
+            static Int32 invoke(lua_State * _state, T * _self, F _func, Args && ..._args)
+            {
+                lua_pushboolean(_state, (_self->*_func)(std::forward<Args>(_args)...));
+                return 1;
+            }
+        };
+
+        template<>
+        struct UncheckedReturn<void>
+        {
+            template<class T, class F, class...Args>
+            static Int32 invoke(lua_State * _state, T * _self, F _func, Args && ..._args)
+            {
+                (_self->*_func)(std::forward<Args>(_args)...);
+                return 0;
+            }
+        };
+
+        //turns a member function with up to two arguments into a lua_CFunction whose argument
+        //conversion is fixed by the signature, see BindingPolicy::Unchecked.
+        template<class F, F Func>
+        struct UncheckedFunction;
+
+        template<class T, class R, R(T::*Func)() const>
+        struct UncheckedFunction<R(T::*)() const, Func>
+        {
+            static Int32 func(lua_State * _state)
+            {
+                return UncheckedReturn<R>::invoke(_state, luaUncheckedSelf<T>(_state), Func);
+            }
+        };
+
+        template<class T, class R, R(T::*Func)()>
+        struct UncheckedFunction<R(T::*)(), Func>
+        {
+            static Int32 func(lua_State * _state)
+            {
+                T * self = luaUncheckedSelf<T>(_state);
+                luaMarkMutation(_state, self);
+                return UncheckedReturn<R>::invoke(_state, self, Func);
+            }
+        };
+
+        template<class T, class R, class A, R(T::*Func)(A) const>
+        struct UncheckedFunction<R(T::*)(A) const, Func>
+        {
+            static Int32 func(lua_State * _state)
+            {
+                T * self = luaUncheckedSelf<T>(_state);
+                return UncheckedReturn<R>::invoke(_state, self, Func, UncheckedArgument<A>::read(_state, 2));
+            }
+        };
+
+        template<class T, class R, class A, R(T::*Func)(A)>
+        struct UncheckedFunction<R(T::*)(A), Func>
+        {
+            static Int32 func(lua_State * _state)
+            {
+                T * self = luaUncheckedSelf<T>(_state);
+                auto a = UncheckedArgument<A>::read(_state, 2);
+                luaMarkMutation(_state, self);
+                return UncheckedReturn<R>::invoke(_state, self, Func, a);
+            }
+        };
+
+        template<class T, class R, class A, class B, R(T::*Func)(A, B)>
+        struct UncheckedFunction<R(T::*)(A, B), Func>
+        {
+            static Int32 func(lua_State * _state)
+            {
+                T * self = luaUncheckedSelf<T>(_state);
+                auto a = UncheckedArgument<A>::read(_state, 2);
+                auto b = UncheckedArgument<B>::read(_state, 3);
+                luaMarkMutation(_state, self);
+                return UncheckedReturn<R>::invoke(_state, self, Func, a, b);
+            }
+        };
+
+        inline Float luaFlatArrayNumber(lua_State * _state, Int32 _tableIndex, Int32 _index)
+        {
+            lua_rawgeti(_state, _tableIndex, _index);
+            if (!lua_isnumber(_state, -1))
+                luaL_error(_state, "number expected at flat array index %d", _index);
+            Float ret = (Float)lua_tonumber(_state, -1);
+            lua_pop(_state, 1);
+            return ret;
+        }
+
+        //checks that every entry of the array at _tableIndex is a number and returns its length.
+        inline Size luaCheckNumberArray(lua_State * _state, Int32 _tableIndex)
+        {
+            luaL_checktype(_state, _tableIndex, LUA_TTABLE);
+            Size len = lua_rawlen(_state, _tableIndex);
+            for (Size i = 1; i <= len; ++i)
+            {
+                lua_rawgeti(_state, _tableIndex, (Int32)i);
+                if (!lua_isnumber(_state, -1))
+                    luaL_error(_state, "number expected at flat array index %d", (Int32)i);
+                lua_pop(_state, 1);
+            }
+            return len;
+        }
+
+        inline void luaSetFlatArrayNumber(lua_State * _state, Int32 _tableIndex, Int32 _index, Float _value)
+        {
+            _tableIndex = lua_absindex(_state, _tableIndex);
+            lua_pushnumber(_state, _value);
+            lua_rawseti(_state, _tableIndex, _index);
+        }
+
+        //writes the intersections as flat (x, y, curveIndex, parameter) tuples starting at the
+        //flat array index _start of the table at _tableIndex and returns the next free index.
+        template<class IA>
+        inline Int32 luaWriteFlatIntersections(lua_State * _state, Int32 _tableIndex, Int32 _start, const IA & _inter)
+        {
+            Int32 idx = _start;
+            for (Size i = 0; i < _inter.count(); ++i)
+            {
+                luaSetFlatArrayNumber(_state, _tableIndex, idx++, _inter[i].position.x);
+                luaSetFlatArrayNumber(_state, _tableIndex, idx++, _inter[i].position.y);
+                luaSetFlatArrayNumber(_state, _tableIndex, idx++, (Float)_inter[i].location.curve().index());
+                luaSetFlatArrayNumber(_state, _tableIndex, idx++, _inter[i].location.parameter());
+            }
+            return idx;
+        }
+
+        //clears the entries of a reused flat array that come after the ones just written.
+        inline void luaTruncateFlatArray(lua_State * _state, Int32 _tableIndex, Int32 _next)
+        {
+            Size len = lua_rawlen(_state, _tableIndex);
+            for (Size i = (Size)_next; i <= len; ++i)
+            {
+                lua_pushnil(_state);
+                lua_rawseti(_state, _tableIndex, (Int32)i);
+            }
+        }
+
+        //Lua: path:intersections(other) -> array of {location, position} or nil
+        //     path:intersections(other, out) -> out, count
+        //The second form writes flat (x, y, curveIndex, parameter) tuples into out instead of
+        //creating a table, CurveLocation and Vec2f per intersection. curveIndex and parameter refer
+        //to the curve of path.
+        inline Int32 luaIntersections(lua_State * _state)
+        {
+            Path * a = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            Path * b = luanatic::convertToTypeAndCheck<Path>(_state, 2);
+            if (lua_istable(_state, 3))
+            {
+                auto inter = a->intersections(b);
+                Int32 next = luaWriteFlatIntersections(_state, 3, 1, inter);
+                luaTruncateFlatArray(_state, 3, next);
+                lua_pushvalue(_state, 3);
+                lua_pushinteger(_state, inter.count());
+                return 2;
+            }
+
+            auto inter = a->intersections(b);
+            if (inter.count())
+            {
+                lua_createtable(_state, inter.count(), 0);
+                for (stick::Int32 i = 0; i < inter.count(); ++i)
+                {
+                    lua_pushinteger(_state, i + 1);
+                    lua_newtable(_state);
+                    luanatic::pushValueType<CurveLocation>(_state, inter[i].location);
+                    lua_setfield(_state, -2, "location");
+                    luanatic::pushValueType<Vec2f>(_state, inter[i].position);
+                    lua_setfield(_state, -2, "position");
+                    lua_settable(_state, -3);
+                }
+            }
+            else
+                lua_pushnil(_state);
+            return 1;
+        }
+
+        struct IntersectionCandidate
+        {
+            Path * path;
+            Size index;
+            Float minX, minY, maxX, maxY;
+        };
+
+        //finds all pairs of paths whose bounds overlap using a sweep along the x axis.
+        //The pairs are returned sorted by (first, second) index so the result does not
+        //depend on the sweep order.
+        inline void overlappingPathPairs(stick::DynamicArray<IntersectionCandidate> & _candidates,
+                                         stick::DynamicArray<std::pair<Size, Size>> & _outPairs)
+        {
+            std::sort(_candidates.begin(), _candidates.end(),
+                      [](const IntersectionCandidate & _a, const IntersectionCandidate & _b) { return _a.minX < _b.minX; });
+
+            stick::DynamicArray<Size> active;
+            for (Size i = 0; i < _candidates.count(); ++i)
+            {
+                const IntersectionCandidate & c = _candidates[i];
+                Size keep = 0;
+                for (Size j = 0; j < active.count(); ++j)
+                {
+                    const IntersectionCandidate & o = _candidates[active[j]];
+                    if (o.maxX < c.minX)
+                        continue;
+                    active[keep++] = active[j];
+                    if (o.maxY >= c.minY && o.minY <= c.maxY)
+                    {
+                        if (o.index < c.index)
+                            _outPairs.append(std::make_pair(o.index, c.index));
+                        else
+                            _outPairs.append(std::make_pair(c.index, o.index));
+                    }
+                }
+                active.resize(keep);
+                active.append(i);
+            }
+
+            std::sort(_outPairs.begin(), _outPairs.end());
+        }
+
+        //pairs of indices into _paths of the paths that might intersect, sorted like overlappingPathPairs
+        inline void pathIntersectionPairs(const stick::DynamicArray<Path *> & _paths,
+                                          stick::DynamicArray<std::pair<Size, Size>> & _outPairs)
+        {
+            stick::DynamicArray<IntersectionCandidate> candidates;
+            candidates.reserve(_paths.count());
+            for (Size i = 0; i < _paths.count(); ++i)
+            {
+                if (_paths[i]->segmentCount() < 2)
+                    continue;
+                const Rect & b = _paths[i]->bounds();
+                IntersectionCandidate c = {_paths[i], i, b.min().x, b.min().y, b.max().x, b.max().y};
+                candidates.append(c);
+            }
+            overlappingPathPairs(candidates, _outPairs);
+        }
+
+        //checks that the value at _index is an array of paths
+        inline void luaCheckPathArray(lua_State * _state, Int32 _index)
+        {
+            luaL_checktype(_state, _index, LUA_TTABLE);
+            Size count = lua_rawlen(_state, _index);
+            for (Size i = 1; i <= count; ++i)
+            {
+                lua_rawgeti(_state, _index, (Int32)i);
+                luanatic::convertToTypeAndCheck<Path>(_state, -1);
+                lua_pop(_state, 1);
+            }
+        }
+
+        //appends the paths of the array at _index, which has to be checked already, to _out
+        inline void luaReadPathArray(lua_State * _state, Int32 _index, stick::DynamicArray<Path *> & _out)
+        {
+            Size count = lua_rawlen(_state, _index);
+            _out.reserve(_out.count() + count);
+            for (Size i = 1; i <= count; ++i)
+            {
+                lua_rawgeti(_state, _index, (Int32)i);
+                _out.append(luanatic::convertToType<Path>(_state, -1));
+                lua_pop(_state, 1);
+            }
+        }
+
+        //Lua: paper.intersectAll(paths, [out]) -> out, count
+        //Intersects every pair of paths in the array. Pairs whose bounds don't overlap are culled
+        //with a sweep before the exact curve tests run. The result is a flat array of
+        //(indexA, indexB, x, y, curveIndex, parameter) tuples where indexA < indexB are indices into
+        //paths and curveIndex and parameter refer to the curve of paths[indexA].
+        inline Int32 luaIntersectAll(lua_State * _state)
+        {
+            //checked before anything is allocated, errors skip the destructors
+            luaCheckPathArray(_state, 1);
+
+            if (lua_istable(_state, 2))
+                lua_pushvalue(_state, 2);
+            else
+                lua_newtable(_state);
+            Int32 outIndex = lua_gettop(_state);
+
+            stick::DynamicArray<Path *> paths;
+            luaReadPathArray(_state, 1, paths);
+
+            stick::DynamicArray<std::pair<Size, Size>> pairs;
+            pathIntersectionPairs(paths, pairs);
+
+            Int32 idx = 1;
+            Size resultCount = 0;
+            for (const auto & pair : pairs)
+            {
+                auto inter = paths[pair.first]->intersections(paths[pair.second]);
+                for (Size i = 0; i < inter.count(); ++i)
+                {
+                    luaSetFlatArrayNumber(_state, outIndex, idx++, (Float)(pair.first + 1));
+                    luaSetFlatArrayNumber(_state, outIndex, idx++, (Float)(pair.second + 1));
+                    luaSetFlatArrayNumber(_state, outIndex, idx++, inter[i].position.x);
+                    luaSetFlatArrayNumber(_state, outIndex, idx++, inter[i].position.y);
+                    luaSetFlatArrayNumber(_state, outIndex, idx++, (Float)inter[i].location.curve().index());
+                    luaSetFlatArrayNumber(_state, outIndex, idx++, inter[i].location.parameter());
+                }
+                resultCount += inter.count();
+            }
+            luaTruncateFlatArray(_state, outIndex, idx);
+
+            lua_pushinteger(_state, resultCount);
+            return 2;
+        }
+
+        //Small least recently used cache that maps keys to allocated values. It keeps
+        //acceleration structures for paths and documents alive between calls from Lua.
+        template<class K, class V, Size MaxCount>
+        class LRUCache
+        {
+        public:
+
+            LRUCache() :
+                m_count(0),
+                m_tick(0)
+            {
+            }
+
+            ~LRUCache()
+            {
+                for (Size i = 0; i < m_count; ++i)
+                    m_entries[i].alloc->destroy(m_entries[i].value);
+            }
+
+            //returns the value for _key. If there is none yet, one is created with _alloc, which
+            //is passed on to its constructor, replacing the least recently used entry once the
+            //cache is full.
+            V & get(K _key, stick::Allocator & _alloc)
+            {
+                ++m_tick;
+                for (Size i = 0; i < m_count; ++i)
+                {
+                    if (m_entries[i].key == _key)
+                    {
+                        m_entries[i].lastUse = m_tick;
+                        return *m_entries[i].value;
+                    }
+                }
+
+                Entry * slot;
+                if (m_count < MaxCount)
+                {
+                    slot = &m_entries[m_count++];
+                }
+                else
+                {
+                    slot = &m_entries[0];
+                    for (Size i = 1; i < m_count; ++i)
+                    {
+                        if (m_entries[i].lastUse < slot->lastUse)
+                            slot = &m_entries[i];
+                    }
+                    slot->alloc->destroy(slot->value);
+                }
+
+                slot->key = _key;
+                slot->value = _alloc.create<V>(_alloc);
+                slot->alloc = &_alloc;
+                slot->lastUse = m_tick;
+                return *slot->value;
+            }
+
+            //destroys the value for _key if there is one
+            void remove(K _key)
+            {
+                for (Size i = 0; i < m_count; ++i)
+                {
+                    if (m_entries[i].key == _key)
+                    {
+                        m_entries[i].alloc->destroy(m_entries[i].value);
+                        m_entries[i] = m_entries[--m_count];
+                        return;
+                    }
+                }
+            }
+
+        private:
+
+            struct Entry
+            {
+                K key;
+                V * value;
+                stick::Allocator * alloc;
+                Size lastUse;
+            };
+
+            Entry m_entries[MaxCount];
+            Size m_count;
+            Size m_tick;
+        };
+
+        //per lua_State caches, see luaStateInstance
+        using CurveIndexCache = LRUCache<Path *, CurveIndex, 32>;
+        using ItemIndexCache = LRUCache<Document *, ItemIndex, 8>;
+
+        //returns the curve index of _path, rebuilding it if the path changed since it was built.
+        //The segments are only fingerprinted again if a mutating binding ran since the last check.
+        //The index is allocated from the state, see luaAllocator. If building it takes the state
+        //above its budget, the index is dropped again and a memory error raised.
+        inline const CurveIndex & luaCurveIndex(lua_State * _state, Path * _path)
+        {
+            CurveIndexCache & cache = luaStateInstance<CurveIndexCache>(_state);
+            CurveIndex & ret = cache.get(_path, luaAllocator(_state));
+            stick::UInt64 generation = luaMutationGeneration(_state);
+            if (ret.generation() == generation)
+                return ret;
+
+            stick::UInt64 fingerprint = CurveIndex::computeFingerprint(_path);
+            if (ret.fingerprint() != fingerprint)
+            {
+                ret.rebuild(_path, fingerprint);
+                if (luaOverBudget(_state))
+                {
+                    cache.remove(_path);
+                    luaL_error(_state, "not enough memory");
+                }
+            }
+            ret.setGeneration(generation);
+            return ret;
+        }
+
+        //the threads parallel bindings of the state run on, started once and reused by every call
+        inline WorkerPool & luaWorkerPool(lua_State * _state)
+        {
+            return luaStateInstance<WorkerPool>(_state);
+        }
+
+        //Lua: path:closestPoints(points, [out], [threadCount]) -> out
+        //points is a flat x, y array. For every point, out receives a flat
+        //(x, y, distance, curveIndex, parameter) tuple of the closest location on the path.
+        //The curves are looked up through a bounding volume hierarchy that is cached per path
+        //and rebuilt lazily once the path changes. Large batches are split across threads unless
+        //threadCount says otherwise.
+        inline Int32 luaClosestPoints(lua_State * _state)
+        {
+            static const Size parallelThreshold = 4096;
+
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            Size len = luaCheckNumberArray(_state, 2);
+            luaL_argcheck(_state, len % 2 == 0, 2, "array length must be a multiple of two");
+            lua_Integer threads = luaL_optinteger(_state, 4, 0);
+            if (!p->curveCount())
+                luaL_argerror(_state, 1, "path has no curves");
+
+            Size count = len / 2;
+            if (lua_istable(_state, 3))
+                lua_pushvalue(_state, 3);
+            else
+                lua_createtable(_state, (Int32)count * 5, 0);
+            Int32 outIndex = lua_gettop(_state);
+
+            const CurveIndex & index = luaCurveIndex(_state, p);
+            WorkerPool & pool = luaWorkerPool(_state);
+
+            stick::DynamicArray<Vec2f> points;
+            stick::DynamicArray<ClosestPointResult> results;
+            points.resize(count);
+            results.resize(count);
+            for (Size i = 0; i < count; ++i)
+            {
+                lua_rawgeti(_state, 2, (Int32)i * 2 + 1);
+                lua_rawgeti(_state, 2, (Int32)i * 2 + 2);
+                points[i] = Vec2f((Float)lua_tonumber(_state, -2), (Float)lua_tonumber(_state, -1));
+                lua_pop(_state, 2);
+            }
+
+            Size threadCount = threads > 0 ? (Size)threads : count >= parallelThreshold ? hardwareThreadCount() : 1;
+            parallelFor(pool, count, 256, threadCount, [&](Size _begin, Size _end)
+            {
+                for (Size i = _begin; i < _end; ++i)
+                    results[i] = index.closestPoint(points[i]);
+            });
+
+            Int32 idx = 1;
+            for (const ClosestPointResult & r : results)
+            {
+                luaSetFlatArrayNumber(_state, outIndex, idx++, r.position.x);
+                luaSetFlatArrayNumber(_state, outIndex, idx++, r.position.y);
+                luaSetFlatArrayNumber(_state, outIndex, idx++, r.distance);
+                luaSetFlatArrayNumber(_state, outIndex, idx++, (Float)r.curveIndex);
+                luaSetFlatArrayNumber(_state, outIndex, idx++, r.parameter);
+            }
+            luaTruncateFlatArray(_state, outIndex, idx);
+
+            return 1;
+        }
+
+        inline Box luaBoxArgument(lua_State * _state, Int32 & _index)
+        {
+            if (lua_isnumber(_state, _index))
+            {
+                Box ret;
+                ret.minX = (Float)luaL_checknumber(_state, _index++);
+                ret.minY = (Float)luaL_checknumber(_state, _index++);
+                ret.maxX = (Float)luaL_checknumber(_state, _index++);
+                ret.maxY = (Float)luaL_checknumber(_state, _index++);
+                return ret;
+            }
+            return Box::fromRect(luanatic::detail::Converter<const Rect &>::convert(_state, _index++));
+        }
+
+        inline bool luaOptionFlag(lua_State * _state, Int32 _index, const char * _name, bool _default)
+        {
+            if (!lua_istable(_state, _index))
+                return _default;
+            lua_getfield(_state, _index, _name);
+            bool ret = lua_isnil(_state, -1) ? _default : lua_toboolean(_state, -1);
+            lua_pop(_state, 1);
+            return ret;
+        }
+
+        inline Float luaOptionNumber(lua_State * _state, Int32 _index, const char * _name, Float _default)
+        {
+            if (!lua_istable(_state, _index))
+                return _default;
+            lua_getfield(_state, _index, _name);
+            Float ret = lua_isnumber(_state, -1) ? (Float)lua_tonumber(_state, -1) : _default;
+            lua_pop(_state, 1);
+            return ret;
+        }
+
+        //returns the item index of _document, synced with it if a mutating binding ran since
+        //the last sync. If all bindings since then only changed items in place, only those are
+        //updated, otherwise the document is walked again. Allocated from the state like
+        //luaCurveIndex.
+        inline ItemIndex & luaItemIndex(lua_State * _state, Document * _document)
+        {
+            ItemIndexCache & cache = luaStateInstance<ItemIndexCache>(_state);
+            ItemIndex & ret = cache.get(_document, luaAllocator(_state));
+            const MutationCounter & counter = luaStateInstance<MutationCounter>(_state);
+            stick::UInt64 generation = counter.generation;
+            if (ret.generation() != generation)
+            {
+                Item * const * changed;
+                Size changedCount;
+                if (!counter.changedSince(ret.generation(), changed, changedCount) || !ret.update(changed, changedCount))
+                    ret.sync(_document);
+                if (luaOverBudget(_state))
+                {
+                    cache.remove(_document);
+                    luaL_error(_state, "not enough memory");
+                }
+                ret.setGeneration(generation);
+            }
+            return ret;
+        }
+
+        //Lua: doc:hitTest(point, [options]) -> path or nil
+        //Returns the topmost path at point, a document space position. Options:
+        //fill (default true): hit if the point is inside the path.
+        //stroke (default false): hit if the point is on the stroke of a stroked path.
+        //tolerance (default 0): extra distance around the outline that still counts as a hit.
+        //all (default false): return an array of all hit paths, topmost first, instead.
+        //The candidates come from a spatial index of the document that is only synced with it
+        //again after a mutating binding ran, see luaWrapMutatingBindings.
+        inline Int32 luaHitTest(lua_State * _state)
+        {
+            Document * doc = luanatic::convertToTypeAndCheck<Document>(_state, 1);
+            Vec2f point = luanatic::detail::Converter<const Vec2f &>::convert(_state, 2);
+            bool bFill = luaOptionFlag(_state, 3, "fill", true);
+            bool bStroke = luaOptionFlag(_state, 3, "stroke", false);
+            bool bAll = luaOptionFlag(_state, 3, "all", false);
+            Float tolerance = luaOptionNumber(_state, 3, "tolerance", 0);
+
+            ItemIndex & index = luaItemIndex(_state, doc);
+
+            //strokes reach outside of the bounds, so the stroke test pads the query by the widest stroke
+            Float padding = tolerance;
+            if (bStroke)
+                padding += index.maxStrokeWidth() * 0.5f;
+
+            stick::DynamicArray<Size> candidates;
+            Box box = {point.x - padding, point.y - padding, point.x + padding, point.y + padding};
+            index.query(box, [&](Size _idx) { candidates.append(_idx); });
+            std::sort(candidates.begin(), candidates.end(), [](Size _a, Size _b) { return _a > _b; });
+
+            stick::DynamicArray<Path *> hits;
+            for (Size idx : candidates)
+            {
+                Path * p = index.path(idx);
+                if (!p->isVisible())
+                    continue;
+
+                Vec2f local = crunch::inverse(index.transform(idx)) * point;
+                bool bHit = bFill && p->contains(local);
+                if (!bHit && (tolerance > 0 || (bStroke && p->hasStroke())) && p->curveCount())
+                {
+                    Float dist;
+                    p->closestCurveLocation(local, dist);
+                    Float strokePadding = bStroke && p->hasStroke() ? p->strokeWidth() * 0.5f : 0;
+                    bHit = dist <= tolerance + strokePadding;
+                }
+
+                if (bHit)
+                {
+                    hits.append(p);
+                    if (!bAll)
+                        break;
+                }
+            }
+
+            if (bAll)
+            {
+                lua_createtable(_state, (Int32)hits.count(), 0);
+                for (Size i = 0; i < hits.count(); ++i)
+                {
+                    luanatic::push<Path>(_state, hits[i], false);
+                    lua_rawseti(_state, -2, (Int32)i + 1);
+                }
+            }
+            else if (hits.count())
+                luanatic::push<Path>(_state, hits[0], false);
+            else
+                lua_pushnil(_state);
+
+            return 1;
+        }
+
+        //Lua: doc:itemsInRect(rect, [options]) / doc:itemsInRect(minX, minY, maxX, maxY, [options]) -> array
+        //Returns all paths whose document space bounds overlap the rectangle, in paint order.
+        //If options.inside is true, only paths that lie completely inside of it are returned.
+        inline Int32 luaItemsInRect(lua_State * _state)
+        {
+            Document * doc = luanatic::convertToTypeAndCheck<Document>(_state, 1);
+            Int32 argIndex = 2;
+            Box box = luaBoxArgument(_state, argIndex);
+            bool bInside = luaOptionFlag(_state, argIndex, "inside", false);
+
+            ItemIndex & index = luaItemIndex(_state, doc);
+
+            stick::DynamicArray<Size> results;
+            index.query(box, [&](Size _idx)
+            {
+                if (!bInside || box.contains(index.bounds(_idx)))
+                    results.append(_idx);
+            });
+            std::sort(results.begin(), results.end());
+
+            lua_createtable(_state, (Int32)results.count(), 0);
+            for (Size i = 0; i < results.count(); ++i)
+            {
+                luanatic::push<Path>(_state, index.path(results[i]), false);
+                lua_rawseti(_state, -2, (Int32)i + 1);
+            }
+
+            return 1;
+        }
+
+        //resolves the optional (from, count) segment range arguments starting at _argIndex.
+        inline void luaSegmentRange(lua_State * _state, Path * _path, Int32 _argIndex, Size & _outFrom, Size & _outCount)
+        {
+            Size segCount = _path->segmentCount();
+            lua_Integer from = luaL_optinteger(_state, _argIndex, 0);
+            luaL_argcheck(_state, from >= 0 && (Size)from <= segCount, _argIndex, "segment index out of range");
+            _outFrom = (Size)from;
+            if (lua_isnoneornil(_state, _argIndex + 1))
+                _outCount = segCount - _outFrom;
+            else
+            {
+                lua_Integer count = luaL_checkinteger(_state, _argIndex + 1);
+                luaL_argcheck(_state, count >= 0, _argIndex + 1, "negative segment count");
+                _outCount = std::min((Size)count, segCount - _outFrom);
+            }
+        }
+
+        //Lua: path:segmentData([from], [count], [out]) / path:segmentPositions([from], [count], [out])
+        //Fills a flat number array with x, y pairs of the segment range. With handles enabled
+        //every segment takes six numbers: position, handleIn, handleOut.
+        //If a table is passed as out it is filled and returned instead of creating a new one.
+        template<bool WithHandles>
+        inline Int32 luaSegmentData(lua_State * _state)
+        {
+            static const Int32 stride = WithHandles ? 6 : 2;
+
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            Size from, count;
+            luaSegmentRange(_state, p, 2, from, count);
+
+            if (lua_istable(_state, 4))
+                lua_pushvalue(_state, 4);
+            else
+                lua_createtable(_state, (Int32)count * stride, 0);
+            Int32 tableIndex = lua_gettop(_state);
+
+            Int32 idx = 1;
+            for (Size i = from; i < from + count; ++i)
+            {
+                Segment seg = p->segment(i);
+                Vec2f pos = seg.position();
+                luaSetFlatArrayNumber(_state, tableIndex, idx++, pos.x);
+                luaSetFlatArrayNumber(_state, tableIndex, idx++, pos.y);
+                if (WithHandles)
+                {
+                    Vec2f hi = seg.handleIn();
+                    Vec2f ho = seg.handleOut();
+                    luaSetFlatArrayNumber(_state, tableIndex, idx++, hi.x);
+                    luaSetFlatArrayNumber(_state, tableIndex, idx++, hi.y);
+                    luaSetFlatArrayNumber(_state, tableIndex, idx++, ho.x);
+                    luaSetFlatArrayNumber(_state, tableIndex, idx++, ho.y);
+                }
+            }
+            luaTruncateFlatArray(_state, tableIndex, idx);
+
+            return 1;
+        }
+
+        //Lua: path:setSegmentData(array, [from]) / path:setSegmentPositions(array, [from])
+        //Counterpart of luaSegmentData. Overwrites the segments starting at from and appends
+        //new segments for the part of the array that reaches past the last segment.
+        template<bool WithHandles>
+        inline Int32 luaSetSegmentData(lua_State * _state)
+        {
+            static const Int32 stride = WithHandles ? 6 : 2;
+
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            luaL_checktype(_state, 2, LUA_TTABLE);
+            Size segCount = p->segmentCount();
+            lua_Integer from = luaL_optinteger(_state, 3, 0);
+            luaL_argcheck(_state, from >= 0 && (Size)from <= segCount, 3, "segment index out of range");
+
+            Size len = lua_rawlen(_state, 2);
+            luaL_argcheck(_state, len % stride == 0, 2, WithHandles ?
+                          "array length must be a multiple of six" :
+                          "array length must be a multiple of two");
+            Size count = len / stride;
+
+            //validate the whole array before touching the path so that a bad entry can't leave
+            //it half written.
+            luaCheckNumberArray(_state, 2);
+
+            //the appended segments are added one by one, make room for all of them up front
+            if ((Size)from + count > segCount)
+                reserveSegments(p, (Size)from + count);
+
+            Int32 idx = 1;
+            for (Size i = 0; i < count; ++i)
+            {
+                Vec2f data[3];
+                for (Int32 j = 0; j < stride / 2; ++j)
+                {
+                    data[j].x = luaFlatArrayNumber(_state, 2, idx++);
+                    data[j].y = luaFlatArrayNumber(_state, 2, idx++);
+                }
+
+                Size segIdx = (Size)from + i;
+                if (segIdx < segCount)
+                {
+                    Segment seg = p->segment(segIdx);
+                    seg.setPosition(data[0]);
+                    if (WithHandles)
+                    {
+                        seg.setHandleIn(data[1]);
+                        seg.setHandleOut(data[2]);
+                    }
+                }
+                else if (WithHandles)
+                    p->addSegment(data[0], data[1], data[2]);
+                else
+                    p->addPoint(data[0]);
+            }
+
+            return 0;
+        }
+
+
+        struct SampleOptions
+        {
+            bool bNormals;
+            bool bTangents;
+            bool bCurvature;
+        };
+
+        struct PathSamples
+        {
+            stick::DynamicArray<Float> x, y;
+            stick::DynamicArray<Float> dx, dy;
+            stick::DynamicArray<Float> ddx, ddy;
+            stick::DynamicArray<Vec2f> normals;
+        };
+
+        //evaluates a cubic bezier and its first two derivatives at many parameters.
+        //Kept as a plain loop over flat arrays in power basis so the compiler can vectorize it.
+        inline void evaluateCubicBatch(const Vec2f & _p0, const Vec2f & _c0, const Vec2f & _c1, const Vec2f & _p1,
+                                       const Float * _t, Size _count,
+                                       Float * _outX, Float * _outY,
+                                       Float * _outDx, Float * _outDy,
+                                       Float * _outDdx, Float * _outDdy)
+        {
+            const Float ax = -_p0.x + 3 * _c0.x - 3 * _c1.x + _p1.x;
+            const Float ay = -_p0.y + 3 * _c0.y - 3 * _c1.y + _p1.y;
+            const Float bx = 3 * _p0.x - 6 * _c0.x + 3 * _c1.x;
+            const Float by = 3 * _p0.y - 6 * _c0.y + 3 * _c1.y;
+            const Float cx = 3 * (_c0.x - _p0.x);
+            const Float cy = 3 * (_c0.y - _p0.y);
+            const Float dx = _p0.x;
+            const Float dy = _p0.y;
+
+            for (Size i = 0; i < _count; ++i)
+            {
+                const Float t = _t[i];
+                _outX[i] = ((ax * t + bx) * t + cx) * t + dx;
+                _outY[i] = ((ay * t + by) * t + cy) * t + dy;
+                _outDx[i] = (3 * ax * t + 2 * bx) * t + cx;
+                _outDy[i] = (3 * ay * t + 2 * by) * t + cy;
+                _outDdx[i] = 6 * ax * t + 2 * bx;
+                _outDdy[i] = 6 * ay * t + 2 * by;
+            }
+        }
+
+        //samples the path at the given offsets. The offsets are visited in sorted order so
+        //every curve is located and measured only once, which makes this O(n log n + curves)
+        //instead of O(n * curves) for n individual positionAt calls.
+        inline void samplePath(Path * _path, const stick::DynamicArray<Float> & _offsets,
+                               const SampleOptions & _options, PathSamples & _out)
+        {
+            Size count = _offsets.count();
+            _out.x.resize(count); _out.y.resize(count);
+            _out.dx.resize(count); _out.dy.resize(count);
+            _out.ddx.resize(count); _out.ddy.resize(count);
+            if (_options.bNormals)
+                _out.normals.resize(count);
+
+            stick::DynamicArray<Size> order;
+            order.resize(count);
+            for (Size i = 0; i < count; ++i)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [&_offsets](Size _a, Size _b) { return _offsets[_a] < _offsets[_b]; });
+
+            //per curve scratch, filled with the samples that fall onto the current curve
+            stick::DynamicArray<Size> indices;
+            stick::DynamicArray<Float> params;
+            stick::DynamicArray<Float> tmp;
+            indices.reserve(count);
+            params.reserve(count);
+
+            Size curveCount = _path->curveCount();
+            Size curveIndex = 0;
+            Curve curve = _path->curve(0);
+            Float curveStart = 0;
+            Float curveLength = curve.length();
+
+            auto flush = [&]()
+            {
+                Size n = indices.count();
+                if (!n)
+                    return;
+                tmp.resize(n * 6);
+                evaluateCubicBatch(curve.positionOne(), curve.handleOneAbsolute(),
+                                   curve.handleTwoAbsolute(), curve.positionTwo(),
+                                   &params[0], n, &tmp[0], &tmp[n], &tmp[n * 2],
+                                   &tmp[n * 3], &tmp[n * 4], &tmp[n * 5]);
+                for (Size i = 0; i < n; ++i)
+                {
+                    Size idx = indices[i];
+                    _out.x[idx] = tmp[i];
+                    _out.y[idx] = tmp[n + i];
+                    _out.dx[idx] = tmp[n * 2 + i];
+                    _out.dy[idx] = tmp[n * 3 + i];
+                    _out.ddx[idx] = tmp[n * 4 + i];
+                    _out.ddy[idx] = tmp[n * 5 + i];
+                    if (_options.bNormals)
+                        _out.normals[idx] = curve.normalAtParameter(params[i]);
+                }
+                indices.clear();
+                params.clear();
+            };
+
+            for (Size i = 0; i < count; ++i)
+            {
+                Size idx = order[i];
+                Float offset = _offsets[idx];
+                while (curveIndex + 1 < curveCount && offset > curveStart + curveLength)
+                {
+                    flush();
+                    curveStart += curveLength;
+                    curve = _path->curve(++curveIndex);
+                    curveLength = curve.length();
+                }
+                Float local = std::min(std::max(offset - curveStart, (Float)0), curveLength);
+                indices.append(idx);
+                params.append(curve.parameterAtOffset(local));
+            }
+            flush();
+        }
+
+        inline void luaPushSamples(lua_State * _state, const PathSamples & _samples, const SampleOptions & _options)
+        {
+            Size count = _samples.x.count();
+            lua_createtable(_state, (Int32)count * 2, 0);
+            for (Size i = 0; i < count; ++i)
+            {
+                luaSetFlatArrayNumber(_state, -1, (Int32)i * 2 + 1, _samples.x[i]);
+                luaSetFlatArrayNumber(_state, -1, (Int32)i * 2 + 2, _samples.y[i]);
+            }
+
+            if (_options.bNormals)
+            {
+                lua_createtable(_state, (Int32)count * 2, 0);
+                for (Size i = 0; i < count; ++i)
+                {
+                    luaSetFlatArrayNumber(_state, -1, (Int32)i * 2 + 1, _samples.normals[i].x);
+                    luaSetFlatArrayNumber(_state, -1, (Int32)i * 2 + 2, _samples.normals[i].y);
+                }
+            }
+            else
+                lua_pushnil(_state);
+
+            if (_options.bTangents)
+            {
+                lua_createtable(_state, (Int32)count * 2, 0);
+                for (Size i = 0; i < count; ++i)
+                {
+                    Float len = std::sqrt(_samples.dx[i] * _samples.dx[i] + _samples.dy[i] * _samples.dy[i]);
+                    Float s = len > 0 ? 1 / len : 0;
+                    luaSetFlatArrayNumber(_state, -1, (Int32)i * 2 + 1, _samples.dx[i] * s);
+                    luaSetFlatArrayNumber(_state, -1, (Int32)i * 2 + 2, _samples.dy[i] * s);
+                }
+            }
+            else
+                lua_pushnil(_state);
+
+            if (_options.bCurvature)
+            {
+                lua_createtable(_state, (Int32)count, 0);
+                for (Size i = 0; i < count; ++i)
+                {
+                    Float dx = _samples.dx[i], dy = _samples.dy[i];
+                    Float d = dx * dx + dy * dy;
+                    Float curvature = d > 0 ? (dx * _samples.ddy[i] - dy * _samples.ddx[i]) / (d * std::sqrt(d)) : 0;
+                    luaSetFlatArrayNumber(_state, -1, (Int32)i + 1, curvature);
+                }
+            }
+            else
+                lua_pushnil(_state);
+        }
+
+        inline SampleOptions luaSampleOptions(lua_State * _state, Int32 _index)
+        {
+            SampleOptions ret = {false, false, false};
+            if (lua_istable(_state, _index))
+            {
+                lua_getfield(_state, _index, "normals");
+                ret.bNormals = lua_toboolean(_state, -1);
+                lua_getfield(_state, _index, "tangents");
+                ret.bTangents = lua_toboolean(_state, -1);
+                lua_getfield(_state, _index, "curvature");
+                ret.bCurvature = lua_toboolean(_state, -1);
+                lua_pop(_state, 3);
+            }
+            return ret;
+        }
+
+        //Lua: path:sampleAt(offsets, [options]) -> positions, normals, tangents, curvatures
+        //offsets is an array of path offsets in any order. positions (and normals and tangents if
+        //requested via options.normals / options.tangents) are flat x, y arrays in the order of
+        //offsets, curvatures a plain array if options.curvature is set. Not requested results are nil.
+        inline Int32 luaSampleAt(lua_State * _state)
+        {
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            Size count = luaCheckNumberArray(_state, 2);
+            SampleOptions options = luaSampleOptions(_state, 3);
+            if (!p->curveCount())
+                luaL_argerror(_state, 1, "path has no curves");
+
+            //the offsets get sorted, a NaN would break the ordering. Checked before anything is
+            //allocated since the error doesn't unwind.
+            for (Size i = 0; i < count; ++i)
+            {
+                lua_rawgeti(_state, 2, (Int32)i + 1);
+                bool bFinite = std::isfinite(lua_tonumber(_state, -1));
+                lua_pop(_state, 1);
+                if (!bFinite)
+                    luaL_argerror(_state, 2, "offsets must be finite");
+            }
+
+            stick::DynamicArray<Float> offsets;
+            offsets.resize(count);
+            for (Size i = 0; i < count; ++i)
+            {
+                lua_rawgeti(_state, 2, (Int32)i + 1);
+                offsets[i] = (Float)lua_tonumber(_state, -1);
+                lua_pop(_state, 1);
+            }
+
+            PathSamples samples;
+            samplePath(p, offsets, options, samples);
+            luaPushSamples(_state, samples, options);
+            return 4;
+        }
+
+        //Lua: path:sampleUniform(count, [options]) -> positions, normals, tangents, curvatures
+        //Same as sampleAt with count offsets evenly distributed from the start to the end of the path.
+        inline Int32 luaSampleUniform(lua_State * _state)
+        {
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            lua_Integer count = luaL_checkinteger(_state, 2);
+            luaL_argcheck(_state, count >= 0, 2, "negative sample count");
+            SampleOptions options = luaSampleOptions(_state, 3);
+            if (!p->curveCount())
+                luaL_argerror(_state, 1, "path has no curves");
+
+            Float length = p->length();
+            Float step = count > 1 ? length / (count - 1) : 0;
+            stick::DynamicArray<Float> offsets;
+            offsets.resize((Size)count);
+            for (Size i = 0; i < (Size)count; ++i)
+                offsets[i] = std::min(i * step, length);
+
+            PathSamples samples;
+            samplePath(p, offsets, options, samples);
+            luaPushSamples(_state, samples, options);
+            return 4;
+        }
+
+        //the iteration state lives inside a full userdata owned by the iterator closure,
+        //so it is released by the garbage collector no matter how the loop ends.
+        template<class CV>
+        struct LuaContainerViewSession
+        {
+            CV view;
+            typename CV::ValueType tmp;
+            typename CV::Iter iter;
+            bool bReuseProxy;
+        };
+
+        template<class CV>
+        inline Int32 luaContainerViewIteratorFunction(lua_State * _state)
+        {
+            STICK_ASSERT(lua_isuserdata(_state, lua_upvalueindex(1)));
+            LuaContainerViewSession<CV> * session = static_cast<LuaContainerViewSession<CV> *>(lua_touserdata(_state, lua_upvalueindex(1)));
+            STICK_ASSERT(session);
+            if (session->iter != session->view.end())
+            {
+                session->tmp = *session->iter++;
+                if (session->bReuseProxy)
+                    lua_pushvalue(_state, lua_upvalueindex(2));
+                else
+                    luanatic::pushValueType<typename CV::ValueType>(_state, session->tmp);
+            }
+            else
+            {
+                //we reached the end
+                lua_pushnil(_state);
+            }
+
+            return 1;
+        }
+
+        //Lua: path:segments([reuseProxy]) / path:curves([reuseProxy])
+        //If reuseProxy is true, every step of the loop yields the same proxy object which
+        //is updated in place, so it only describes the current element until the next step.
+        //The proxy keeps the loop's session alive, holding on to it after the loop is safe.
+        template<class CV, CV(Path::*Getter)()>
+        inline Int32 luaPushContainerView(lua_State * _state)
+        {
+            Path * path = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            bool bReuseProxy = lua_toboolean(_state, 2);
+            LuaContainerViewSession<CV> * session = luaNewUserData<LuaContainerViewSession<CV>>(_state);
+            session->view = (path->*Getter)();
+            session->iter = session->view.begin();
+            session->bReuseProxy = bReuseProxy;
+            if (bReuseProxy)
+            {
+                //the proxy points into the session
+                luanatic::push<typename CV::ValueType>(_state, &session->tmp, false);
+                luaAnchor(_state, -1, -2);
+            }
+            lua_pushcclosure(_state, luaContainerViewIteratorFunction<CV>, bReuseProxy ? 2 : 1);
+            return 1;
+        }
+
+        //a fill or stroke as read from a style table
+        struct StylePaint
+        {
+            enum Kind
+            {
+                Unset,
+                None,
+                Color,
+                String,
+                Linear,
+                Radial
+            };
+
+            StylePaint() :
+                kind(Unset)
+            {
+            }
+
+            Kind kind;
+            ColorRGBA color;
+            stick::String string;
+            LinearGradientPtr linear;
+            RadialGradientPtr radial;
+        };
+
+        enum StyleProperty
+        {
+            StyleStrokeWidth = 1 << 0,
+            StyleStrokeJoin = 1 << 1,
+            StyleStrokeCap = 1 << 2,
+            StyleMiterLimit = 1 << 3,
+            StyleDashArray = 1 << 4,
+            StyleDashOffset = 1 << 5,
+            StyleScaleStroke = 1 << 6,
+            StyleWindingRule = 1 << 7,
+            StyleVisible = 1 << 8
+        };
+
+        //Style table resolved once, so applying it to many items doesn't go through the lua
+        //type checks and overload dispatch of the individual setters for every item. Paints are
+        //shared by all items, i.e. a gradient is referenced, not copied.
+        struct ItemStyle
+        {
+            ItemStyle() :
+                properties(0)
+            {
+            }
+
+            void applyPaint(Item * _item, StylePaint & _paint, bool _bFill)
+            {
+                switch (_paint.kind)
+                {
+                case StylePaint::None:
+                    if (_bFill)
+                        _item->removeFill();
+                    else
+                        _item->removeStroke();
+                    break;
+                case StylePaint::Color:
+                    if (_bFill)
+                        _item->setFill(_paint.color);
+                    else
+                        _item->setStroke(_paint.color);
+                    break;
+                case StylePaint::String:
+                {
+                    if (_bFill)
+                        _item->setFill(_paint.string);
+                    else
+                        _item->setStroke(_paint.string);
+                    //parse the color string only once, the other items get the parsed color
+                    const Paint & parsed = _bFill ? _item->fill() : _item->stroke();
+                    if (parsed.is<ColorRGBA>())
+                    {
+                        _paint.kind = StylePaint::Color;
+                        _paint.color = parsed.get<ColorRGBA>();
+                    }
+                    break;
+                }
+                case StylePaint::Linear:
+                    if (_bFill)
+                        _item->setFill(_paint.linear);
+                    else
+                        _item->setStroke(_paint.linear);
+                    break;
+                case StylePaint::Radial:
+                    if (_bFill)
+                        _item->setFill(_paint.radial);
+                    else
+                        _item->setStroke(_paint.radial);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            void apply(Item * _item)
+            {
+                applyPaint(_item, fill, true);
+                applyPaint(_item, stroke, false);
+                if (!properties)
+                    return;
+                if (properties & StyleStrokeWidth)
+                    _item->setStrokeWidth(strokeWidth);
+                if (properties & StyleStrokeJoin)
+                    _item->setStrokeJoin(strokeJoin);
+                if (properties & StyleStrokeCap)
+                    _item->setStrokeCap(strokeCap);
+                if (properties & StyleMiterLimit)
+                    _item->setMiterLimit(miterLimit);
+                if (properties & StyleDashArray)
+                    _item->setDashArray(dashArray);
+                if (properties & StyleDashOffset)
+                    _item->setDashOffset(dashOffset);
+                if (properties & StyleScaleStroke)
+                    _item->setScaleStroke(bScaleStroke);
+                if (properties & StyleWindingRule)
+                    _item->setWindingRule(windingRule);
+                if (properties & StyleVisible)
+                    _item->setVisible(bVisible);
+            }
+
+            StylePaint fill;
+            StylePaint stroke;
+            stick::UInt32 properties;
+            Float strokeWidth;
+            StrokeJoin strokeJoin;
+            StrokeCap strokeCap;
+            Float miterLimit;
+            DashArray dashArray;
+            Float dashOffset;
+            bool bScaleStroke;
+            WindingRule windingRule;
+            bool bVisible;
+        };
+
+        //reads the paint at _index, false removes the paint
+        inline void luaReadStylePaint(lua_State * _state, Int32 _index, StylePaint & _out)
+        {
+            if (lua_isboolean(_state, _index) && !lua_toboolean(_state, _index))
+                _out.kind = StylePaint::None;
+            else if (lua_type(_state, _index) == LUA_TSTRING)
+            {
+                _out.kind = StylePaint::String;
+                _out.string = lua_tostring(_state, _index);
+            }
+            else if (luanatic::convertToType<LinearGradient>(_state, _index))
+            {
+                _out.kind = StylePaint::Linear;
+                _out.linear = luanatic::detail::Converter<const LinearGradientPtr &>::convert(_state, _index);
+            }
+            else if (luanatic::convertToType<RadialGradient>(_state, _index))
+            {
+                _out.kind = StylePaint::Radial;
+                _out.radial = luanatic::detail::Converter<const RadialGradientPtr &>::convert(_state, _index);
+            }
+            else if (luanatic::convertToType<NoPaint>(_state, _index))
+                _out.kind = StylePaint::None;
+            else
+            {
+                _out.kind = StylePaint::Color;
+                _out.color = luanatic::detail::Converter<const ColorRGBA &>::convert(_state, _index);
+            }
+        }
+
+        //Resolves the style table at _index into an ItemStyle, which is left on the stack in a
+        //userdata so it is cleaned up if a value in the table raises an error. Keys: fill, stroke
+        //(color, color string, gradient or false to remove it), strokeWidth, strokeJoin,
+        //strokeCap, miterLimit, dashArray (array of numbers), dashOffset, scaleStroke,
+        //windingRule, visible. Unknown keys are an error.
+        inline ItemStyle * luaResolveStyle(lua_State * _state, Int32 _index)
+        {
+            luaL_checktype(_state, _index, LUA_TTABLE);
+            _index = lua_absindex(_state, _index);
+            ItemStyle * style = luaNewUserData<ItemStyle>(_state);
+
+            lua_pushnil(_state);
+            while (lua_next(_state, _index))
+            {
+                const char * key = lua_type(_state, -2) == LUA_TSTRING ? lua_tostring(_state, -2) : "";
+                if (std::strcmp(key, "fill") == 0)
+                    luaReadStylePaint(_state, -1, style->fill);
+                else if (std::strcmp(key, "stroke") == 0)
+                    luaReadStylePaint(_state, -1, style->stroke);
+                else if (std::strcmp(key, "strokeWidth") == 0)
+                {
+                    style->strokeWidth = luaL_checknumber(_state, -1);
+                    style->properties |= StyleStrokeWidth;
+                }
+                else if (std::strcmp(key, "strokeJoin") == 0)
+                {
+                    style->strokeJoin = (StrokeJoin)luaL_checkinteger(_state, -1);
+                    style->properties |= StyleStrokeJoin;
+                }
+                else if (std::strcmp(key, "strokeCap") == 0)
+                {
+                    style->strokeCap = (StrokeCap)luaL_checkinteger(_state, -1);
+                    style->properties |= StyleStrokeCap;
+                }
+                else if (std::strcmp(key, "miterLimit") == 0)
+                {
+                    style->miterLimit = luaL_checknumber(_state, -1);
+                    style->properties |= StyleMiterLimit;
+                }
+                else if (std::strcmp(key, "dashArray") == 0)
+                {
+                    luaL_checktype(_state, -1, LUA_TTABLE);
+                    Size count = lua_rawlen(_state, -1);
+                    for (Size i = 1; i <= count; ++i)
+                    {
+                        lua_rawgeti(_state, -1, (Int32)i);
+                        style->dashArray.append(luaL_checknumber(_state, -1));
+                        lua_pop(_state, 1);
+                    }
+                    style->properties |= StyleDashArray;
+                }
+                else if (std::strcmp(key, "dashOffset") == 0)
+                {
+                    style->dashOffset = luaL_checknumber(_state, -1);
+                    style->properties |= StyleDashOffset;
+                }
+                else if (std::strcmp(key, "scaleStroke") == 0)
+                {
+                    style->bScaleStroke = lua_toboolean(_state, -1);
+                    style->properties |= StyleScaleStroke;
+                }
+                else if (std::strcmp(key, "windingRule") == 0)
+                {
+                    style->windingRule = (WindingRule)luaL_checkinteger(_state, -1);
+                    style->properties |= StyleWindingRule;
+                }
+                else if (std::strcmp(key, "visible") == 0)
+                {
+                    style->bVisible = lua_toboolean(_state, -1);
+                    style->properties |= StyleVisible;
+                }
+                else
+                {
+                    lua_pushvalue(_state, -2);
+                    luaL_error(_state, "unknown style property '%s'", luaL_tolstring(_state, -1, nullptr));
+                }
+                lua_pop(_state, 1);
+            }
+            return style;
+        }
+
+        //Lua: item:setStyle(style) -> item
+        //Sets all properties of the style table at once, see luaResolveStyle for the keys.
+        inline Int32 luaSetStyle(lua_State * _state)
+        {
+            Item * item = luanatic::convertToTypeAndCheck<Item>(_state, 1);
+            luaResolveStyle(_state, 2)->apply(item);
+            lua_pushvalue(_state, 1);
+            return 1;
+        }
+
+        //checks that the value at _index is an array of items and returns its length
+        inline Size luaCheckItemArray(lua_State * _state, Int32 _index)
+        {
+            luaL_checktype(_state, _index, LUA_TTABLE);
+            Size count = lua_rawlen(_state, _index);
+            for (Size i = 1; i <= count; ++i)
+            {
+                lua_rawgeti(_state, _index, (Int32)i);
+                luanatic::convertToTypeAndCheck<Item>(_state, -1);
+                lua_pop(_state, 1);
+            }
+            return count;
+        }
+
+        //Lua: paper.applyStyle(items, style)
+        //Resolves the style table once and applies it to every item of the array.
+        inline Int32 luaApplyStyle(lua_State * _state)
+        {
+            Size count = luaCheckItemArray(_state, 1);
+            ItemStyle * style = luaResolveStyle(_state, 2);
+            for (Size i = 1; i <= count; ++i)
+            {
+                lua_rawgeti(_state, 1, (Int32)i);
+                style->apply(luanatic::convertToTypeAndCheck<Item>(_state, -1));
+                lua_pop(_state, 1);
+            }
+            return 0;
+        }
+
+        //Lua: paper.transformItems(items, matrix)
+        //Same as calling item:transformItem(matrix) on every item of the array.
+        inline Int32 luaTransformItems(lua_State * _state)
+        {
+            Size count = luaCheckItemArray(_state, 1);
+            Mat32f matrix = luanatic::detail::Converter<const Mat32f &>::convert(_state, 2);
+            for (Size i = 1; i <= count; ++i)
+            {
+                lua_rawgeti(_state, 1, (Int32)i);
+                luanatic::convertToTypeAndCheck<Item>(_state, -1)->transform(matrix);
+                lua_pop(_state, 1);
+            }
+            return 0;
+        }
+
+        //Runs _op on copies of all paths in the array at argument 1 and writes the results back.
+        //_threadArg is the index of the optional thread count argument.
+        template<class F>
+        inline Int32 luaBatch(lua_State * _state, Int32 _threadArg, F _op)
+        {
+            luaL_checktype(_state, 1, LUA_TTABLE);
+            Size count = lua_rawlen(_state, 1);
+            lua_Integer threadCount = luaL_optinteger(_state, _threadArg, (lua_Integer)hardwareThreadCount());
+            luaL_argcheck(_state, threadCount > 0, _threadArg, "thread count must be positive");
+
+            //check all entries before allocating anything, lua errors skip destructors
+            for (Size i = 0; i < count; ++i)
+            {
+                lua_rawgeti(_state, 1, (Int32)i + 1);
+                luanatic::convertToTypeAndCheck<Path>(_state, -1);
+                lua_pop(_state, 1);
+            }
+            WorkerPool & pool = luaWorkerPool(_state);
+
+            stick::DynamicArray<Path *> paths;
+            stick::DynamicArray<PathData> data;
+            paths.resize(count);
+            data.resize(count);
+            for (Size i = 0; i < count; ++i)
+            {
+                lua_rawgeti(_state, 1, (Int32)i + 1);
+                paths[i] = luanatic::convertToTypeAndCheck<Path>(_state, -1);
+                lua_pop(_state, 1);
+                data[i].read(paths[i]);
+            }
+
+            batchProcess(pool, data, (Size)threadCount, _op);
+
+            for (Size i = 0; i < count; ++i)
+                data[i].write(paths[i]);
+
+            return 0;
+        }
+
+        //Lua: paper.batch.flatten(paths, angleTolerance, [threadCount])
+        inline Int32 luaBatchFlatten(lua_State * _state)
+        {
+            Float tolerance = luaL_checknumber(_state, 2);
+            return luaBatch(_state, 3, [tolerance](Path * _path) { _path->flatten(tolerance); });
+        }
+
+        //Lua: paper.batch.flattenRegular(paths, maxDistance, [threadCount])
+        inline Int32 luaBatchFlattenRegular(lua_State * _state)
+        {
+            Float maxDistance = luaL_checknumber(_state, 2);
+            return luaBatch(_state, 3, [maxDistance](Path * _path) { _path->flattenRegular(maxDistance); });
+        }
+
+        //Lua: paper.batch.regularOffset(paths, offset, tolerance, [threadCount])
+        inline Int32 luaBatchRegularOffset(lua_State * _state)
+        {
+            Float offset = luaL_checknumber(_state, 2);
+            Float tolerance = luaL_checknumber(_state, 3);
+            return luaBatch(_state, 4, [offset, tolerance](Path * _path) { _path->regularOffset(offset, tolerance); });
+        }
+
+        //Lua: paper.batch.simplify(paths, tolerance, [threadCount])
+        inline Int32 luaBatchSimplify(lua_State * _state)
+        {
+            Float tolerance = luaL_checknumber(_state, 2);
+            return luaBatch(_state, 3, [tolerance](Path * _path) { _path->simplify(tolerance); });
+        }
+
+        //Lua: paper.batch.smooth(paths, [smoothing], [flag], [threadCount])
+        //smoothing and flag are passed on to Path:smooth, smoothing defaults to Smoothing.Asymmetric.
+        inline Int32 luaBatchSmooth(lua_State * _state)
+        {
+            Smoothing type = (Smoothing)luaL_optinteger(_state, 2, (lua_Integer)Smoothing::Asymmetric);
+            bool bFlag = lua_toboolean(_state, 3);
+            return luaBatch(_state, 4, [type, bFlag](Path * _path) { _path->smooth(type, bFlag); });
+        }
+
+        //Work that can be split into small steps, see luaRunSliced. Tasks live in a userdata on
+        //the stack of the coroutine running them, so they are destructed even if the coroutine
+        //is never resumed again. The arguments stay on that stack below the task, which keeps
+        //their Lua values alive while the task is suspended. The paper items behind them are
+        //owned by their document though, so a task only continues if no mutating binding ran
+        //in between, see luaRunSliced.
+        struct SlicedTask
+        {
+            SlicedTask(Size _totalSteps, lua_Integer _budget, bool _bMutating) :
+                totalSteps(_totalSteps),
+                doneSteps(0),
+                budget(_budget),
+                bMutating(_bMutating),
+                generation(0),
+                bBlocking(false)
+            {
+            }
+
+            virtual ~SlicedTask()
+            {
+            }
+
+            //does one step of the work, returns false once there is nothing left to do
+            virtual bool step() = 0;
+
+            //pushes the results once step returned false
+            virtual Int32 pushResults(lua_State * _state) = 0;
+
+            Size totalSteps;
+            Size doneSteps;
+            //microseconds per slice
+            lua_Integer budget;
+            //true if the steps change paper data
+            bool bMutating;
+            //mutation generation when the task yielded, 0 before the first slice
+            stick::UInt64 generation;
+            //set once a yield failed, the task runs to completion then
+            bool bBlocking;
+        };
+
+        //keeps the documents of _items alive for as long as the task at _taskIndex is, the items
+        //would be freed together with their document while the task is suspended otherwise.
+        //Documents that weren't created through the bindings are owned by C++ and skipped.
+        template<class R>
+        inline void luaAnchorTaskDocuments(lua_State * _state, Int32 _taskIndex, const R & _items)
+        {
+            _taskIndex = lua_absindex(_state, _taskIndex);
+            lua_newtable(_state);
+            Document * last = nullptr;
+            for (Item * item : _items)
+            {
+                Document * doc = item->itemType() == ItemType::Document ?
+                                 static_cast<Document *>(item) : item->document();
+                if (!doc || doc == last)
+                    continue;
+                last = doc;
+                luaPushDocumentOwner(_state, doc);
+                if (lua_isnil(_state, -1))
+                    lua_pop(_state, 1);
+                else
+                {
+                    lua_pushboolean(_state, 1);
+                    lua_rawset(_state, -3);
+                }
+            }
+            luaAnchor(_state, _taskIndex, -1);
+            lua_pop(_state, 1);
+        }
+
+        inline Int32 luaRunSliced(lua_State * _state, Int32 _taskIndex);
+
+        //the continuation api changed between 5.2 and 5.3, the rest of the sliced code is the same
+#if LUA_VERSION_NUM >= 503
+        inline Int32 luaContinueSliced(lua_State * _state, Int32 _status, lua_KContext _ctx)
+        {
+            (void)_status;
+            return luaRunSliced(_state, (Int32)_ctx);
+        }
+
+        inline bool luaIsYieldable(lua_State * _state)
+        {
+            return lua_isyieldable(_state);
+        }
+#elif LUA_VERSION_NUM == 502
+        inline Int32 luaContinueSliced(lua_State * _state)
+        {
+            Int32 ctx = 0;
+            lua_getctx(_state, &ctx);
+            return luaRunSliced(_state, ctx);
+        }
+
+        //5.2 can't tell if a C call boundary is in the way, so this only rules out the main thread.
+        //luaRunSliced tries the yield in a protected call and runs the task to completion if
+        //that fails.
+        inline bool luaIsYieldable(lua_State * _state)
+        {
+            bool bMainThread = lua_pushthread(_state);
+            lua_pop(_state, 1);
+            return !bMainThread;
+        }
+
+        inline Int32 luaYieldProgress(lua_State * _state)
+        {
+            return lua_yield(_state, 1);
+        }
+#endif
+
+        //Runs the task at _taskIndex, which has to be the top of the stack of the calling C
+        //function, for up to task->budget microseconds. If the task is not done by then and the
+        //function was called from a coroutine, it yields the progress (0 - 1) to the resumer and
+        //continues with the next slice when resumed. Outside of a coroutine the task runs to
+        //completion, so the sliced functions also work like their blocking versions.
+        //If paper data was changed through the bindings while the task was suspended, the items
+        //it holds may be gone, so resuming it raises an error instead.
+        inline Int32 luaRunSliced(lua_State * _state, Int32 _taskIndex)
+        {
+            //drops whatever was passed to coroutine.resume
+            lua_settop(_state, _taskIndex);
+            SlicedTask * task = static_cast<SlicedTask *>(lua_touserdata(_state, _taskIndex));
+            if (task->generation && task->generation != luaMutationGeneration(_state))
+                return luaL_error(_state, "paper data changed while the sliced task was suspended");
+
+#if LUA_VERSION_NUM >= 502
+            bool bYieldable = !task->bBlocking && luaIsYieldable(_state);
+#else
+            bool bYieldable = false;
+#endif
+            //the steps may change paper data, see luaWrapMutatingBindings
+            if (task->bMutating)
+                luaMarkMutation(_state);
+            auto start = std::chrono::steady_clock::now();
+            bool bMore;
+            while ((bMore = task->step()))
+            {
+                ++task->doneSteps;
+                if (bYieldable && std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start).count() >= task->budget)
+                    break;
+            }
+
+            if (!bMore)
+                return task->pushResults(_state);
+
+#if LUA_VERSION_NUM >= 503
+            task->generation = luaMutationGeneration(_state);
+            lua_pushnumber(_state, task->totalSteps ? (lua_Number)task->doneSteps / task->totalSteps : 0);
+            return lua_yieldk(_state, 1, _taskIndex, luaContinueSliced);
+#elif LUA_VERSION_NUM == 502
+            //the yield happens in luaYieldProgress, resuming continues in luaContinueSliced. If
+            //a C call is in the way the yield raises an error, which ends up here instead.
+            task->generation = luaMutationGeneration(_state);
+            lua_pushcfunction(_state, luaYieldProgress);
+            lua_pushnumber(_state, task->totalSteps ? (lua_Number)task->doneSteps / task->totalSteps : 0);
+            if (lua_pcallk(_state, 1, 0, 0, _taskIndex, luaContinueSliced) != LUA_OK)
+                lua_pop(_state, 1);
+            task->bBlocking = true;
+            return luaRunSliced(_state, _taskIndex);
+#else
+            return 0;
+#endif
+        }
+
+        //reads the optional budget argument at _index, in microseconds
+        inline lua_Integer luaCheckBudget(lua_State * _state, Int32 _index)
+        {
+            lua_Integer ret = luaL_optinteger(_state, _index, 1000);
+            luaL_argcheck(_state, ret > 0, _index, "budget must be positive");
+            return ret;
+        }
+
+        //applies _op to one path per step
+        template<class F>
+        struct SlicedPathTask : public SlicedTask
+        {
+            SlicedPathTask(F _op, lua_Integer _budget) :
+                SlicedTask(0, _budget, true),
+                op(_op)
+            {
+            }
+
+            bool step() override
+            {
+                if (doneSteps >= paths.count())
+                    return false;
+                op(paths[doneSteps]);
+                return doneSteps + 1 < paths.count();
+            }
+
+            Int32 pushResults(lua_State * _state) override
+            {
+                lua_pushvalue(_state, 1);
+                return 1;
+            }
+
+            F op;
+            stick::DynamicArray<Path *> paths;
+        };
+
+        //_budgetArg is the index of the optional budget argument
+        template<class F>
+        inline Int32 luaSlicedPathOp(lua_State * _state, Int32 _budgetArg, F _op)
+        {
+            luaCheckPathArray(_state, 1);
+            lua_Integer budget = luaCheckBudget(_state, _budgetArg);
+            lua_settop(_state, _budgetArg);
+            SlicedPathTask<F> * task = luaNewUserData<SlicedPathTask<F>>(_state, _op, budget);
+            luaReadPathArray(_state, 1, task->paths);
+            luaAnchorTaskDocuments(_state, -1, task->paths);
+            task->totalSteps = task->paths.count();
+            return luaRunSliced(_state, lua_gettop(_state));
+        }
+
+        //Lua: paper.sliced.simplify(paths, tolerance, [budget]) -> paths
+        inline Int32 luaSlicedSimplify(lua_State * _state)
+        {
+            Float tolerance = luaL_checknumber(_state, 2);
+            return luaSlicedPathOp(_state, 3, [tolerance](Path * _path) { _path->simplify(tolerance); });
+        }
+
+        //Lua: paper.sliced.smooth(paths, [smoothing], [flag], [budget]) -> paths
+        inline Int32 luaSlicedSmooth(lua_State * _state)
+        {
+            Smoothing type = (Smoothing)luaL_optinteger(_state, 2, (lua_Integer)Smoothing::Asymmetric);
+            bool bFlag = lua_toboolean(_state, 3);
+            return luaSlicedPathOp(_state, 4, [type, bFlag](Path * _path) { _path->smooth(type, bFlag); });
+        }
+
+        //intersects one pair of paths per step
+        struct SlicedIntersectAllTask : public SlicedTask
+        {
+            SlicedIntersectAllTask(lua_Integer _budget) :
+                SlicedTask(0, _budget, false)
+            {
+            }
+
+            bool step() override
+            {
+                if (doneSteps >= pairs.count())
+                    return false;
+                const auto & pair = pairs[doneSteps];
+                auto inter = paths[pair.first]->intersections(paths[pair.second]);
+                for (Size i = 0; i < inter.count(); ++i)
+                {
+                    Float tuple[6] =
+                    {
+                        (Float)(pair.first + 1), (Float)(pair.second + 1),
+                        inter[i].position.x, inter[i].position.y,
+                        (Float)inter[i].location.curve().index(), inter[i].location.parameter()
+                    };
+                    results.insert(results.end(), tuple, tuple + 6);
+                }
+                return doneSteps + 1 < pairs.count();
+            }
+
+            Int32 pushResults(lua_State * _state) override
+            {
+                if (lua_istable(_state, 2))
+                    lua_pushvalue(_state, 2);
+                else
+                    lua_newtable(_state);
+                Int32 outIndex = lua_gettop(_state);
+                for (Size i = 0; i < results.size(); ++i)
+                    luaSetFlatArrayNumber(_state, outIndex, (Int32)i + 1, results[i]);
+                luaTruncateFlatArray(_state, outIndex, (Int32)results.size() + 1);
+                lua_pushinteger(_state, (lua_Integer)(results.size() / 6));
+                return 2;
+            }
+
+            stick::DynamicArray<Path *> paths;
+            stick::DynamicArray<std::pair<Size, Size>> pairs;
+            std::vector<Float> results;
+        };
+
+        //Lua: paper.sliced.intersectAll(paths, [out], [budget]) -> out, count
+        //Same results as paper.intersectAll, one pair of paths with overlapping bounds per step.
+        inline Int32 luaSlicedIntersectAll(lua_State * _state)
+        {
+            luaCheckPathArray(_state, 1);
+            lua_Integer budget = luaCheckBudget(_state, 3);
+            lua_settop(_state, 3);
+            SlicedIntersectAllTask * task = luaNewUserData<SlicedIntersectAllTask>(_state, budget);
+            luaReadPathArray(_state, 1, task->paths);
+            luaAnchorTaskDocuments(_state, -1, task->paths);
+            pathIntersectionPairs(task->paths, task->pairs);
+            task->totalSteps = task->pairs.count();
+            return luaRunSliced(_state, lua_gettop(_state));
+        }
+
+        //serializes one item per step
+        struct SlicedExportSVGTask : public SlicedTask
+        {
+            SlicedExportSVGTask(lua_Integer _budget) :
+                SlicedTask(0, _budget, false),
+                output([this](const char * _data, Size _count) -> bool
+                {
+                    appendText(svg, _data, _count);
+                    return true;
+                }, 65536),
+                writer(output, nullptr)
+            {
+            }
+
+            bool step() override
+            {
+                return writer.step();
+            }
+
+            Int32 pushResults(lua_State * _state) override
+            {
+                lua_pushlstring(_state, svg.count() ? &svg[0] : "", svg.count());
+                return 1;
+            }
+
+            SVGText svg;
+            SVGOutput output;
+            SVGStreamWriter writer;
+        };
+
+        inline Size itemTreeSize(Item * _item)
+        {
+            Size ret = 0;
+            for (Item * child : _item->children())
+                ret += 1 + itemTreeSize(child);
+            return ret;
+        }
+
+        //Lua: paper.sliced.exportSVG(item, [budget]) -> svg
+        //Produces the same svg as item:exportSVGStream, one item per step.
+        inline Int32 luaSlicedExportSVG(lua_State * _state)
+        {
+            Item * item = luanatic::convertToTypeAndCheck<Item>(_state, 1);
+            lua_Integer budget = luaCheckBudget(_state, 2);
+            lua_settop(_state, 2);
+            SlicedExportSVGTask * task = luaNewUserData<SlicedExportSVGTask>(_state, budget);
+            Item * items[] = {item};
+            luaAnchorTaskDocuments(_state, -1, items);
+            task->totalSteps = itemTreeSize(item);
+            task->writer.begin(item);
+            return luaRunSliced(_state, lua_gettop(_state));
+        }
+
+        //per lua_State, see luaStateInstance. Keyed by the exported item.
+        using SVGFragmentCaches = LRUCache<Item *, SVGFragmentCache, 4>;
+
+        //Lua: item:exportSVGStream(sink, [options]) -> byteCount, bComplete, [reusedCount, serializedCount]
+        //Writes the svg of the item (all of it for a document) to sink in chunks, without ever
+        //holding the whole string. sink is either a function that is called with every chunk and
+        //may return false to abort, a file descriptor or a file name. Options:
+        //chunkSize (default 65536): approximate size of the chunks in bytes.
+        //incremental (default false): keep the serialized items of this export around and only
+        //serialize the items that changed in the next incremental export of the same item. The
+        //cache takes about twice as much memory as the svg itself, see SVGFragmentCache. The
+        //counts of reused and serialized items are returned in this mode.
+        inline Int32 luaExportSVGStream(lua_State * _state)
+        {
+            Item * item = luanatic::convertToTypeAndCheck<Item>(_state, 1);
+            Int32 sinkType = lua_type(_state, 2);
+            luaL_argcheck(_state, sinkType == LUA_TFUNCTION || sinkType == LUA_TNUMBER || sinkType == LUA_TSTRING,
+                          2, "function, file descriptor or file name expected");
+            bool bIncremental = luaOptionFlag(_state, 3, "incremental", false);
+            Size chunkSize = (Size)std::max(luaOptionNumber(_state, 3, "chunkSize", 65536), (Float)1);
+            Int32 fd = sinkType == LUA_TNUMBER ? (Int32)lua_tointeger(_state, 2) : -1;
+
+            //everything that can raise a lua error happens before the C++ objects below exist
+            SVGFragmentCache * cache = bIncremental ? &luaStateInstance<SVGFragmentCaches>(_state).get(item, luaAllocator(_state)) : nullptr;
+            lua_settop(_state, 3);
+            //slot for an error raised by the sink function, it is rethrown at the end
+            lua_pushnil(_state);
+            Int32 errorIndex = lua_gettop(_state);
+
+            FILE * file = nullptr;
+            if (sinkType == LUA_TSTRING)
+            {
+                file = std::fopen(lua_tostring(_state, 2), "wb");
+                if (!file)
+                    return luaL_error(_state, "could not open %s for writing", lua_tostring(_state, 2));
+            }
+
+            bool bComplete;
+            Size byteCount;
+            {
+                SVGOutput output([&](const char * _data, Size _count) -> bool
+                {
+                    if (file)
+                        return std::fwrite(_data, 1, _count, file) == _count;
+                    if (fd >= 0)
+                        return writeToFileDescriptor(fd, _data, _count);
+
+                    lua_pushvalue(_state, 2);
+                    lua_pushlstring(_state, _data, _count);
+                    if (lua_pcall(_state, 1, 1, 0))
+                    {
+                        lua_replace(_state, errorIndex);
+                        return false;
+                    }
+                    bool bContinue = !lua_isboolean(_state, -1) || lua_toboolean(_state, -1);
+                    lua_pop(_state, 1);
+                    return bContinue;
+                }, chunkSize);
+
+                SVGStreamWriter writer(output, cache);
+                bComplete = writer.write(item);
+                byteCount = output.byteCount();
+            }
+
+            if (file && std::fclose(file) != 0)
+                bComplete = false;
+            if (!lua_isnil(_state, errorIndex))
+            {
+                lua_pushvalue(_state, errorIndex);
+                return lua_error(_state);
+            }
+            //the cache is allocated from the state, see luaCurveIndex
+            if (cache && luaOverBudget(_state))
+            {
+                luaStateInstance<SVGFragmentCaches>(_state).remove(item);
+                return luaL_error(_state, "not enough memory");
+            }
+
+            lua_pushnumber(_state, (lua_Number)byteCount);
+            lua_pushboolean(_state, bComplete);
+            if (!cache)
+                return 2;
+            lua_pushnumber(_state, (lua_Number)cache->reusedCount());
+            lua_pushnumber(_state, (lua_Number)cache->serializedCount());
+            return 4;
+        }
+
+        inline double secondsSince(std::chrono::steady_clock::time_point _start)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        }
+
+        //parses _size bytes of svg into a new group of _document. On success the group and a
+        //table with the timings are pushed, otherwise nil and the error message.
+        //Document::parseSVG only takes a stick::String, so the bytes are copied once into a
+        //string that is allocated with its final size, timed as copyTime. parseSVG parses and
+        //builds the items in one call, so parseTime covers both and can't be split from here.
+        inline Int32 luaPushParsedSVG(lua_State * _state, Document * _document, const char * _data, Size _size,
+                                      Size _dpi, double _mapTime)
+        {
+            Group * group = nullptr;
+            double copyTime, parseTime;
+            {
+                auto start = std::chrono::steady_clock::now();
+                stick::String svg(_data ? _data : "", _size);
+                copyTime = secondsSince(start);
+                start = std::chrono::steady_clock::now();
+                auto result = _document->parseSVG(svg, _dpi);
+                parseTime = secondsSince(start);
+                if (result.error())
+                {
+                    lua_pushnil(_state);
+                    lua_pushstring(_state, result.error().message().cString());
+                    return 2;
+                }
+                group = result.group();
+            }
+
+            luanatic::push<Group>(_state, group, false);
+            lua_createtable(_state, 0, 4);
+            lua_pushnumber(_state, _mapTime);
+            lua_setfield(_state, -2, "mapTime");
+            lua_pushnumber(_state, copyTime);
+            lua_setfield(_state, -2, "copyTime");
+            lua_pushnumber(_state, parseTime);
+            lua_setfield(_state, -2, "parseTime");
+            lua_pushnumber(_state, (lua_Number)_size);
+            lua_setfield(_state, -2, "bytes");
+            return 2;
+        }
+
+        //Lua: doc:parseSVG(svg, [dpi]) -> group, stats | nil, error
+        //stats has the time spent copying the input in copyTime, the time spent parsing it and
+        //building the items in parseTime (both in seconds) and the size of the input in bytes.
+        inline Int32 luaParseSVG(lua_State * _state)
+        {
+            Document * doc = luanatic::convertToTypeAndCheck<Document>(_state, 1);
+            size_t size;
+            const char * svg = luaL_checklstring(_state, 2, &size);
+            lua_Integer dpi = luaL_optinteger(_state, 3, 72);
+            return luaPushParsedSVG(_state, doc, svg, size, (Size)dpi, 0);
+        }
+
+        //Lua: doc:loadSVG(fileName, [dpi]) -> group, stats | nil, error
+        //Memory maps the file, so its size is known before anything is allocated and the content
+        //goes from the page cache into the string handed to the parser in a single copy, see
+        //luaPushParsedSVG. That only saves the read buffer and the regrowing of a read loop,
+        //the parser still works on a copy. stats is the one of parseSVG plus mapTime.
+        inline Int32 luaLoadSVG(lua_State * _state)
+        {
+            Document * doc = luanatic::convertToTypeAndCheck<Document>(_state, 1);
+            const char * path = luaL_checkstring(_state, 2);
+            lua_Integer dpi = luaL_optinteger(_state, 3, 72);
+
+            lua_settop(_state, 3);
+            MappedFile file;
+            auto start = std::chrono::steady_clock::now();
+            if (!file.open(path))
+            {
+                lua_pushnil(_state);
+                lua_pushfstring(_state, "could not open %s", path);
+                return 2;
+            }
+            double mapTime = secondsSince(start);
+            return luaPushParsedSVG(_state, doc, file.data(), file.size(), (Size)dpi, mapTime);
+        }
+
+        //Lua: path:snapshot() -> snapshot
+        //The snapshot is a userdata anchored to the luanatic object and its arrays are allocated
+        //from the state, see luaAllocator, so both count towards the budget of a pooled state.
+        inline Int32 luaSnapshot(lua_State * _state)
+        {
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            PathSnapshot * snapshot = luaNewUserData<PathSnapshot>(_state, p, luaAllocator(_state));
+            if (luaOverBudget(_state))
+            {
+                //give the arrays back right away instead of once the userdata is collected
+                snapshot->~PathSnapshot();
+                new (snapshot) PathSnapshot();
+                return luaL_error(_state, "not enough memory");
+            }
+            luanatic::push<PathSnapshot>(_state, snapshot, false);
+            luaAnchor(_state, -1, -2);
+            return 1;
+        }
+
+        //pushes a userdata holding a copy of _view, one of the FFI structs, and anchors the value
+        //at _ownerIndex that the pointers in it point into to it. ffi.cast on the userdata gives
+        //a pointer to the copy, so the owner stays alive for as long as the script holds the view.
+        template<class T>
+        inline void luaPushFFIView(lua_State * _state, Int32 _ownerIndex, const T & _view)
+        {
+            _ownerIndex = lua_absindex(_state, _ownerIndex);
+            new (lua_newuserdata(_state, sizeof(T))) T(_view);
+            luaAnchor(_state, -1, _ownerIndex);
+        }
+
+        //Lua: path:segmentBuffer([buffer]) -> buffer, view
+        //Copies the segments into buffer, or a new buffer if none is passed. view is a userdata
+        //holding the PaperLuaSegmentBuffer that describes the copy, i.e. for
+        //ffi.cast("PaperLuaSegmentBuffer *", view) after ffi.cdef(paper.ffiCdef()). It keeps the
+        //buffer alive, its data pointer stays valid until the buffer is refilled.
+        inline Int32 luaSegmentBuffer(lua_State * _state)
+        {
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            SegmentBuffer * buffer;
+            if (lua_isnoneornil(_state, 2))
+                buffer = luaNewUserData<SegmentBuffer>(_state);
+            else
+            {
+                buffer = luaToUserData<SegmentBuffer>(_state, 2);
+                if (!buffer)
+                    return luaL_argerror(_state, 2, "segment buffer expected");
+                lua_pushvalue(_state, 2);
+            }
+            buffer->read(p);
+            luaPushFFIView(_state, -1, buffer->view());
+            return 2;
+        }
+
+        //Lua: path:setSegmentBuffer(buffer, [from])
+        //Writes the (possibly modified) segments of buffer back, see SegmentBuffer::write.
+        inline Int32 luaSetSegmentBuffer(lua_State * _state)
+        {
+            Path * p = luanatic::convertToTypeAndCheck<Path>(_state, 1);
+            SegmentBuffer * buffer = luaToUserData<SegmentBuffer>(_state, 2);
+            if (!buffer)
+                return luaL_argerror(_state, 2, "segment buffer expected");
+            lua_Integer from = luaL_optinteger(_state, 3, 0);
+            luaL_argcheck(_state, from >= 0 && (Size)from <= p->segmentCount(), 3, "segment index out of range");
+            buffer->write(p, (Size)from);
+            return 0;
+        }
+
+        //Lua: snapshot:ffiView() -> view
+        //Userdata holding a PaperLuaSnapshotView, for ffi.cast("const PaperLuaSnapshotView *", view).
+        //The view keeps the snapshot alive, so the pointers in it stay valid for as long as the
+        //script holds on to it.
+        inline Int32 luaSnapshotFFIView(lua_State * _state)
+        {
+            PathSnapshot * snapshot = luanatic::convertToTypeAndCheck<PathSnapshot>(_state, 1);
+            PaperLuaSnapshotView view;
+            fillSnapshotView(*snapshot, view);
+            luaPushFFIView(_state, 1, view);
+            return 1;
+        }
+
+        //Lua: paper.ffiCdef() -> string
+        inline Int32 luaFFICdef(lua_State * _state)
+        {
+            lua_pushstring(_state, ffiCdef());
+            return 1;
+        }
+
+        //Lua: snapshot:curveLocationAt(offset) -> curveIndex, parameter
+        //The snapshot doesn't reference the path, so the location is returned as the index of the
+        //curve and the parameter on it instead of a CurveLocation.
+        inline Int32 luaSnapshotCurveLocationAt(lua_State * _state)
+        {
+            PathSnapshot * snapshot = luanatic::convertToTypeAndCheck<PathSnapshot>(_state, 1);
+            Float offset = (Float)luaL_checknumber(_state, 2);
+            Size curveIndex;
+            Float parameter;
+            snapshot->curveLocationAt(offset, curveIndex, parameter);
+            lua_pushinteger(_state, (lua_Integer)curveIndex);
+            lua_pushnumber(_state, parameter);
+            return 2;
+        }
+
+        //Lua: doc:saveBinary(fileName) -> true | nil, error
+        //Writes the groups and paths of doc in the binary format described in BinaryFormat.hpp.
+        inline Int32 luaSaveBinary(lua_State * _state)
+        {
+            Document * doc = luanatic::convertToTypeAndCheck<Document>(_state, 1);
+            const char * path = luaL_checkstring(_state, 2);
+
+            //the error is copied out so nothing with a destructor is alive once lua is called again
+            char error[256];
+            bool bOk;
+            {
+                stick::String msg;
+                BinaryWriter writer;
+                bOk = writer.save(doc, path, msg);
+                std::snprintf(error, sizeof(error), "%s", msg.cString());
+            }
+
+            if (!bOk)
+            {
+                lua_pushnil(_state);
+                lua_pushstring(_state, error);
+                return 2;
+            }
+            lua_pushboolean(_state, 1);
+            return 1;
+        }
+
+        //Lua: Document.loadBinary(fileName) -> document | nil, error
+        //Maps the file and builds a new document straight from the mapped records.
+        inline Int32 luaLoadBinary(lua_State * _state)
+        {
+            const char * path = luaL_checkstring(_state, 1);
+
+            //a userdata anchored to the luanatic object like luaSnapshot, so the garbage collector
+            //takes care of it if loading fails. The items are created by paper and don't come
+            //from the state.
+            Document * doc = luaNewUserData<Document>(_state);
+            luanatic::push<Document>(_state, doc, false);
+            luaAnchor(_state, -1, -2);
+            luaRegisterDocument(_state, -1, doc);
+
+            char error[256];
+            bool bOk;
+            {
+                stick::String msg;
+                BinaryReader reader(luaAllocator(_state));
+                bOk = reader.load(doc, path, msg);
+                std::snprintf(error, sizeof(error), "%s", msg.cString());
+            }
+
+            if (!bOk)
+            {
+                lua_pushnil(_state);
+                lua_pushstring(_state, error);
+                return 2;
+            }
+            return 1;
+        }
+
+        //per binding statistics collected by the profiler, see luaInstrumentTable
+        struct ProfileEntry
+        {
+            stick::String name;
+            stick::UInt64 calls;
+            //wall time in seconds
+            double totalTime;
+            double maxTime;
+            //userdata values among the results, i.e. Segments, Curves or CurveLocations. Handles
+            //returned from the handle cache count too, so this is not the number of allocations,
+            //see bytes for those.
+            stick::UInt64 userdataResults;
+            //growth of the lua heap during the calls, the garbage collector can make this negative
+            stick::Int64 bytes;
+        };
+
+        //per lua_State, see luaStateInstance. A deque so the entries never move, the instrumented
+        //closures reference them.
+        struct Profile
+        {
+            std::deque<ProfileEntry> entries;
+        };
+
+        inline stick::Int64 luaHeapBytes(lua_State * _state)
+        {
+            return (stick::Int64)lua_gc(_state, LUA_GCCOUNT, 0) * 1024 + lua_gc(_state, LUA_GCCOUNTB, 0);
+        }
+
+        //calls the function in upvalue 1 and records the call in the ProfileEntry in upvalue 2.
+        //Calls that raise an error are not recorded.
+        inline Int32 luaProfiledCall(lua_State * _state)
+        {
+            ProfileEntry * entry = static_cast<ProfileEntry *>(lua_touserdata(_state, lua_upvalueindex(2)));
+            Int32 argCount = lua_gettop(_state);
+            lua_pushvalue(_state, lua_upvalueindex(1));
+            lua_insert(_state, 1);
+
+            stick::Int64 heapBefore = luaHeapBytes(_state);
+            auto start = std::chrono::steady_clock::now();
+            lua_call(_state, argCount, LUA_MULTRET);
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            Int32 resultCount = lua_gettop(_state);
+            entry->calls++;
+            entry->totalTime += elapsed;
+            entry->maxTime = std::max(entry->maxTime, elapsed);
+            entry->bytes += luaHeapBytes(_state) - heapBefore;
+            for (Int32 i = 1; i <= resultCount; ++i)
+            {
+                if (lua_type(_state, i) == LUA_TUSERDATA)
+                    entry->userdataResults++;
+            }
+            return resultCount;
+        }
+
+        //if the value on top of the stack is a C function that is not instrumented yet, it is
+        //replaced with a profiled closure recording into a new entry called _name.
+        inline void luaWrapProfiled(lua_State * _state, const char * _name)
+        {
+            if (!lua_iscfunction(_state, -1) || lua_tocfunction(_state, -1) == luaProfiledCall)
+                return;
+
+            Profile & profile = luaStateInstance<Profile>(_state);
+            ProfileEntry entry = {_name, 0, 0, 0, 0, 0};
+            profile.entries.push_back(entry);
+            lua_pushlightuserdata(_state, &profile.entries.back());
+            lua_pushcclosure(_state, luaProfiledCall, 2);
+        }
+
+        //instruments every C function in the table at _index except for metamethods
+        inline void luaInstrumentTable(lua_State * _state, Int32 _index, const char * _prefix)
+        {
+            char name[256];
+            _index = lua_absindex(_state, _index);
+            lua_pushnil(_state);
+            while (lua_next(_state, _index))
+            {
+                if (lua_type(_state, -2) == LUA_TSTRING && lua_iscfunction(_state, -1))
+                {
+                    const char * key = lua_tostring(_state, -2);
+                    if (std::strncmp(key, "__", 2) != 0)
+                    {
+                        snprintf(name, sizeof(name), "%s.%s", _prefix, key);
+                        lua_pushvalue(_state, -2);
+                        lua_pushvalue(_state, -2);
+                        luaWrapProfiled(_state, name);
+                        //assigning existing fields while traversing is fine
+                        lua_rawset(_state, _index);
+                    }
+                }
+                lua_pop(_state, 1);
+            }
+        }
+
+        //instruments the classes and functions registered by paper in the namespace table at
+        //_index. Compiles to nothing unless PAPERLUA_ENABLE_PROFILING is defined.
+        inline void luaInstrumentNamespace(lua_State * _state, Int32 _index)
+        {
+#ifdef PAPERLUA_ENABLE_PROFILING
+            //sliced is left out, the profiling wrappers call through lua_call which can't be
+            //yielded across
+            static const char * s_tableNames[] =
+            {
+                "Segment", "CurveLocation", "Curve", "NoPaint", "BaseGradient", "LinearGradient",
+                "RadialGradient", "Item", "Group", "Path", "PathSnapshot", "Document", "RenderInterface",
+                "TarpRenderer", "batch"
+            };
+            static const char * s_functionNames[] =
+            {
+                "createLinearGradient", "createRadialGradient", "intersectAll", "applyStyle", "transformItems"
+            };
+
+            _index = lua_absindex(_state, _index);
+            for (const char * name : s_tableNames)
+            {
+                lua_pushstring(_state, name);
+                lua_rawget(_state, _index);
+                if (lua_istable(_state, -1))
+                    luaInstrumentTable(_state, -1, name);
+                lua_pop(_state, 1);
+            }
+
+            for (const char * name : s_functionNames)
+            {
+                lua_pushstring(_state, name);
+                lua_pushvalue(_state, -1);
+                lua_rawget(_state, _index);
+                luaWrapProfiled(_state, name);
+                lua_rawset(_state, _index);
+            }
+#else
+            (void)_state;
+            (void)_index;
+#endif //PAPERLUA_ENABLE_PROFILING
+        }
+
+        //Lua: paper.profile() -> {[name] = {calls, totalTime, maxTime, userdataResults, bytes}}
+        //Only bindings that were called are listed. Empty unless compiled with
+        //PAPERLUA_ENABLE_PROFILING.
+        inline Int32 luaProfile(lua_State * _state)
+        {
+            lua_newtable(_state);
+            for (const ProfileEntry & entry : luaStateInstance<Profile>(_state).entries)
+            {
+                if (!entry.calls)
+                    continue;
+                lua_createtable(_state, 0, 5);
+                lua_pushnumber(_state, (lua_Number)entry.calls);
+                lua_setfield(_state, -2, "calls");
+                lua_pushnumber(_state, entry.totalTime);
+                lua_setfield(_state, -2, "totalTime");
+                lua_pushnumber(_state, entry.maxTime);
+                lua_setfield(_state, -2, "maxTime");
+                lua_pushnumber(_state, (lua_Number)entry.userdataResults);
+                lua_setfield(_state, -2, "userdataResults");
+                lua_pushnumber(_state, (lua_Number)entry.bytes);
+                lua_setfield(_state, -2, "bytes");
+                lua_setfield(_state, -2, entry.name.cString());
+            }
+            return 1;
+        }
+
+        //Lua: paper.resetProfile()
+        inline Int32 luaResetProfile(lua_State * _state)
+        {
+            for (ProfileEntry & entry : luaStateInstance<Profile>(_state).entries)
+            {
+                entry.calls = 0;
+                entry.totalTime = 0;
+                entry.maxTime = 0;
+                entry.userdataResults = 0;
+                entry.bytes = 0;
+            }
+            return 0;
+        }
+
+        //Lua: paper.profileJSON() -> string
+        //The same data as paper.profile() as a JSON array, sorted by total time in descending order.
+        inline Int32 luaProfileJSON(lua_State * _state)
+        {
+            std::vector<const ProfileEntry *> entries;
+            for (const ProfileEntry & entry : luaStateInstance<Profile>(_state).entries)
+            {
+                if (entry.calls)
+                    entries.push_back(&entry);
+            }
+            std::stable_sort(entries.begin(), entries.end(), [](const ProfileEntry * _a, const ProfileEntry * _b)
+            {
+                return _a->totalTime > _b->totalTime;
+            });
+
+            luaL_Buffer buffer;
+            luaL_buffinit(_state, &buffer);
+            luaL_addchar(&buffer, '[');
+            char tmp[256];
+            for (stick::Size i = 0; i < entries.size(); ++i)
+            {
+                const ProfileEntry & entry = *entries[i];
+                snprintf(tmp, sizeof(tmp),
+                         "%s{\"name\":\"%s\",\"calls\":%llu,\"totalTime\":%.9g,\"maxTime\":%.9g,\"userdataResults\":%llu,\"bytes\":%lld}",
+                         i ? "," : "", entry.name.cString(), (unsigned long long)entry.calls,
+                         entry.totalTime, entry.maxTime, (unsigned long long)entry.userdataResults, (long long)entry.bytes);
+                luaL_addstring(&buffer, tmp);
+            }
+            luaL_addchar(&buffer, ']');
+            luaL_pushresult(&buffer);
+            return 1;
+        }
+
+        //Lua: paper.memory([resetPeak]) -> {current, peak, budget, pooled}
+        //Bytes allocated by the script's lua_State, which includes every userdata the bindings
+        //create and, for pooled states, the curve and item indices, SVG fragment caches and path
+        //snapshots they keep (see luaAllocator). Items and segments are allocated by paper from
+        //its default allocator and are not counted, no matter if they come from loadBinary,
+        //parseSVG or the create functions. peak and budget are only tracked for states created
+        //with createPooledLuaState, otherwise peak is the current value and budget is 0
+        //(unlimited). If resetPeak is true, the peak is reset to the current value after it was read.
+        inline Int32 luaMemory(lua_State * _state)
+        {
+            bool bResetPeak = lua_toboolean(_state, 1);
+            PoolAllocator * pool = luaPoolAllocator(_state);
+            stick::Int64 current = pool ? (stick::Int64)pool->currentBytes() : luaHeapBytes(_state);
+
+            lua_createtable(_state, 0, 4);
+            lua_pushnumber(_state, (lua_Number)current);
+            lua_setfield(_state, -2, "current");
+            lua_pushnumber(_state, (lua_Number)(pool ? pool->peakBytes() : current));
+            lua_setfield(_state, -2, "peak");
+            lua_pushnumber(_state, (lua_Number)(pool ? pool->budget() : 0));
+            lua_setfield(_state, -2, "budget");
+            lua_pushboolean(_state, pool != nullptr);
+            lua_setfield(_state, -2, "pooled");
+
+            if (pool && bResetPeak)
+                pool->resetPeakBytes();
+            return 1;
+        }
+    }
+
+    namespace detail
+    {
+        //The class wrappers only describe the bindings, they don't hold any lua state. They are
+        //built once per process and shared by every lua_State paper gets registered with.
+        struct ClassWrappers
+        {
+            ClassWrappers() :
+                segmentCW("Segment"),
+                curveLocationCW("CurveLocation"),
+                curveCW("Curve"),
+                noPaintCW("NoPaint"),
+                baseGradientCW("BaseGradient"),
+                linearGradientCW("LinearGradient"),
+                radialGradientCW("RadialGradient"),
+                itemCW("Item"),
+                groupCW("Group"),
+                pathCW("Path"),
+                pathSnapshotCW("PathSnapshot"),
+                docCW("Document"),
+                rendererCW("RenderInterface"),
+                tarpRendererCW("TarpRenderer")
+            {
+                using namespace luanatic;
+                using namespace stick;
+
+                segmentCW.
+                PAPERLUA_SEGMENT_VEC2F_BINDINGS(PAPERLUA_ADD_VEC2F_BINDING, PAPERLUA_ADD_VEC2F_BINDING_OVERLOAD)
+                addMemberFunction("isLinear", LUANATIC_FUNCTION(&Segment::isLinear)).
+                addMemberFunction("remove", LUANATIC_FUNCTION(&Segment::remove));
+
+                curveLocationCW.
+                PAPERLUA_CURVE_LOCATION_VEC2F_BINDINGS(PAPERLUA_ADD_VEC2F_BINDING, PAPERLUA_ADD_VEC2F_BINDING_OVERLOAD)
+                addMemberFunction("curvature", LUANATIC_FUNCTION(&CurveLocation::curvature)).
+                addMemberFunction("angle", LUANATIC_FUNCTION(&CurveLocation::angle)).
+                addMemberFunction("parameter", LUANATIC_FUNCTION(&CurveLocation::parameter)).
+                addMemberFunction("offset", LUANATIC_FUNCTION(&CurveLocation::offset)).
+                addMemberFunction("isValid", LUANATIC_FUNCTION(&CurveLocation::isValid)).
+                addMemberFunction("curve", LUANATIC_FUNCTION(&CurveLocation::curve));
+
+                curveCW.
+                PAPERLUA_CURVE_VEC2F_BINDINGS(PAPERLUA_ADD_VEC2F_BINDING, PAPERLUA_ADD_VEC2F_BINDING_OVERLOAD)
+                addMemberFunction("path", LUANATIC_FUNCTION(&Curve::path)).
+                addMemberFunction("curvatureAt", LUANATIC_FUNCTION(&Curve::curvatureAt)).
+                addMemberFunction("angleAt", LUANATIC_FUNCTION(&Curve::angleAt)).
+                addMemberFunction("curvatureAtParameter", LUANATIC_FUNCTION(&Curve::curvatureAtParameter)).
+                addMemberFunction("angleAtParameter", LUANATIC_FUNCTION(&Curve::angleAtParameter)).
+                addMemberFunction("parameterAtOffset", LUANATIC_FUNCTION(&Curve::parameterAtOffset)).
+                addMemberFunction("closestParameter", LUANATIC_FUNCTION_OVERLOAD(Float(Curve::*)(const Vec2f &)const, &Curve::closestParameter)).
+                addMemberFunction("lengthBetween", LUANATIC_FUNCTION(&Curve::lengthBetween)).
+                addMemberFunction("pathOffset", LUANATIC_FUNCTION(&Curve::pathOffset)).
+                addMemberFunction("closestCurveLocation", LUANATIC_FUNCTION(&Curve::closestCurveLocation)).
+                addMemberFunction("curveLocationAt", detail::luaCurveCurveLocationAt).
+                addMemberFunction("curveLocationAtParameter", LUANATIC_FUNCTION(&Curve::curveLocationAtParameter)).
+                addMemberFunction("isLinear", LUANATIC_FUNCTION(&Curve::isLinear)).
+                addMemberFunction("isStraight", LUANATIC_FUNCTION(&Curve::isStraight)).
+                addMemberFunction("isArc", LUANATIC_FUNCTION(&Curve::isArc)).
+                addMemberFunction("isOrthogonal", LUANATIC_FUNCTION(&Curve::isOrthogonal)).
+                addMemberFunction("isCollinear", LUANATIC_FUNCTION(&Curve::isCollinear)).
+                addMemberFunction("length", LUANATIC_FUNCTION(&Curve::length)).
+                addMemberFunction("area", LUANATIC_FUNCTION(&Curve::area)).
+                addMemberFunction("divideAt", LUANATIC_FUNCTION(&Curve::divideAt)).
+                addMemberFunction("divideAtParameter", LUANATIC_FUNCTION(&Curve::divideAtParameter)).
+                addMemberFunction("bounds", LUANATIC_FUNCTION_OVERLOAD(const Rect & (Curve::*)()const, &Curve::bounds)).
+                addMemberFunction("boundsWithPadding", LUANATIC_FUNCTION_OVERLOAD(Rect(Curve::*)(Float)const, &Curve::bounds));
+
+                noPaintCW.
+                addConstructor<>();
+
+                baseGradientCW.
+                PAPERLUA_BASE_GRADIENT_VEC2F_BINDINGS(PAPERLUA_ADD_VEC2F_BINDING, PAPERLUA_ADD_VEC2F_BINDING_OVERLOAD)
+                addMemberFunction("addStop", LUANATIC_FUNCTION(&BaseGradient::addStop)).
+                addMemberFunction("stops", LUANATIC_FUNCTION(&BaseGradient::stops, ReturnIterator<ph::Result>));
+
+                linearGradientCW.
+                addBase<BaseGradient>();
+
+                radialGradientCW.
+                addBase<BaseGradient>().
+                addMemberFunction("setFocalPointOffset", LUANATIC_FUNCTION(&RadialGradient::setFocalPointOffset)).
+                addMemberFunction("setRatio", LUANATIC_FUNCTION(&RadialGradient::setRatio)).
+                addMemberFunction("focalPointOffset", LUANATIC_FUNCTION(&RadialGradient::focalPointOffset)).
+                addMemberFunction("ratio", LUANATIC_FUNCTION(&RadialGradient::ratio));
+
+                itemCW.
+                PAPERLUA_ITEM_VEC2F_BINDINGS(PAPERLUA_ADD_VEC2F_BINDING, PAPERLUA_ADD_VEC2F_BINDING_OVERLOAD)
+                addMemberFunction("addChild", LUANATIC_FUNCTION(&Item::addChild)).
+                addMemberFunction("insertAbove", LUANATIC_FUNCTION(&Item::insertAbove)).
+                addMemberFunction("insertBelow", LUANATIC_FUNCTION(&Item::insertBelow)).
+                addMemberFunction("sendToFront", LUANATIC_FUNCTION(&Item::sendToFront)).
+                addMemberFunction("sendToBack", LUANATIC_FUNCTION(&Item::sendToBack)).
+                addMemberFunction("reverseChildren", LUANATIC_FUNCTION(&Item::reverseChildren)).
+                addMemberFunction("remove", LUANATIC_FUNCTION(&Item::remove)).
+                addMemberFunction("removeChildren", LUANATIC_FUNCTION(&Item::removeChildren)).
+                addMemberFunction("name", LUANATIC_FUNCTION(&Item::name)).
+                addMemberFunction("parent", LUANATIC_FUNCTION(&Item::parent)).
+                addMemberFunction("setVisible", LUANATIC_FUNCTION(&Item::setVisible)).
+                addMemberFunction("setName", LUANATIC_FUNCTION(&Item::setName)).
+                addMemberFunction("setTransform", LUANATIC_FUNCTION(&Item::setTransform)).
+                addMemberFunction("scaleTransform", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Vec2f &), &Item::scaleTransform)).
+                addMemberFunction("scaleAroundTransform", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Vec2f &, const Vec2f &), &Item::scaleTransform)).
+                addMemberFunction("rotateTransform", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(Float), &Item::rotateTransform)).
+                addMemberFunction("rotateAroundTransform", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(Float, const Vec2f &), &Item::rotateTransform)).
+                addMemberFunction("transformItem", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Mat32f &), &Item::transform)).
+                addMemberFunction("scale", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const Vec2f &), &Item::scale)).
+                addMemberFunction("rotate", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(Float), &Item::rotate)).
+                addMemberFunction("rotateAround", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(Float, const Vec2f &), &Item::rotate)).
+                addMemberFunction("applyTransform", LUANATIC_FUNCTION(&Item::applyTransform)).
+                addMemberFunction("transform", LUANATIC_FUNCTION_OVERLOAD(const Mat32f & (Item::*)()const, &Item::transform)).
+                addMemberFunction("rotation", LUANATIC_FUNCTION(&Item::rotation)).
+                addMemberFunction("translation", LUANATIC_FUNCTION(&Item::translation)).
+                addMemberFunction("scaling", LUANATIC_FUNCTION(&Item::scaling)).
+                addMemberFunction("absoluteRotation", LUANATIC_FUNCTION(&Item::absoluteRotation)).
+                addMemberFunction("absoluteTranslation", LUANATIC_FUNCTION(&Item::absoluteTranslation)).
+                addMemberFunction("absoluteScaling", LUANATIC_FUNCTION(&Item::absoluteScaling)).
+                addMemberFunction("bounds", LUANATIC_FUNCTION(&Item::bounds)).
+                addMemberFunction("handleBounds", LUANATIC_FUNCTION(&Item::handleBounds)).
+                addMemberFunction("strokeBounds", LUANATIC_FUNCTION(&Item::strokeBounds)).
+                addMemberFunction("isVisible", LUANATIC_FUNCTION(&Item::isVisible)).
+                addMemberFunction("setStrokeJoin", LUANATIC_FUNCTION(&Item::setStrokeJoin)).
+                addMemberFunction("setStrokeCap", LUANATIC_FUNCTION(&Item::setStrokeCap)).
+                addMemberFunction("setMiterLimit", LUANATIC_FUNCTION(&Item::setMiterLimit)).
+                addMemberFunction("setStrokeWidth", LUANATIC_FUNCTION(&Item::setStrokeWidth)).
+                addMemberFunction("setDashArray", LUANATIC_FUNCTION(&Item::setDashArray)).
+                addMemberFunction("setDashOffset", LUANATIC_FUNCTION(&Item::setDashOffset)).
+                addMemberFunction("setScaleStroke", LUANATIC_FUNCTION(&Item::setScaleStroke)).
+                addMemberFunction("setStrokeColor", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const ColorRGBA &), &Item::setStroke)).
+                addMemberFunction("setStrokeString", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const stick::String &), &Item::setStroke)).
+                addMemberFunction("setStrokeLinearGradient", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const LinearGradientPtr &), &Item::setStroke)).
+                addMemberFunction("setStrokeRadialGradient", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const RadialGradientPtr &), &Item::setStroke)).
+                addMemberFunction("setStroke", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const ColorRGBA &), &Item::setStroke)).
+                addMemberFunction("setStroke", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const stick::String &), &Item::setStroke)).
+                addMemberFunction("setStroke", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const LinearGradientPtr &), &Item::setStroke)).
+                addMemberFunction("setStroke", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const RadialGradientPtr &), &Item::setStroke)).
+                addMemberFunction("removeStroke", LUANATIC_FUNCTION(&Item::removeStroke)).
+                addMemberFunction("setFillColor", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const ColorRGBA &), &Item::setFill)).
+                addMemberFunction("setFillString", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const stick::String &), &Item::setFill)).
+                addMemberFunction("setFillLinearGradient", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const LinearGradientPtr &), &Item::setFill)).
+                addMemberFunction("setFillRadialGradient", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const RadialGradientPtr &), &Item::setFill)).
+                addMemberFunction("setFill", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const ColorRGBA &), &Item::setFill)).
+                addMemberFunction("setFill", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const stick::String &), &Item::setFill)).
+                addMemberFunction("setFill", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const LinearGradientPtr &), &Item::setFill)).
+                addMemberFunction("setFill", LUANATIC_FUNCTION_OVERLOAD(void(Item::*)(const RadialGradientPtr &), &Item::setFill)).
+                addMemberFunction("removeFill", LUANATIC_FUNCTION(&Item::removeFill)).
+                addMemberFunction("setStyle", detail::luaSetStyle).
+                addMemberFunction("setWindingRule", LUANATIC_FUNCTION(&Item::setWindingRule)).
+                addMemberFunction("strokeJoin", LUANATIC_FUNCTION(&Item::strokeJoin)).
+                addMemberFunction("strokeCap", LUANATIC_FUNCTION(&Item::strokeCap)).
+                addMemberFunction("miterLimit", LUANATIC_FUNCTION(&Item::miterLimit)).
+                addMemberFunction("strokeWidth", LUANATIC_FUNCTION(&Item::strokeWidth)).
+                addMemberFunction("dashArray", LUANATIC_FUNCTION(&Item::dashArray)).
+                addMemberFunction("dashOffset", LUANATIC_FUNCTION(&Item::dashOffset)).
+                addMemberFunction("windingRule", LUANATIC_FUNCTION(&Item::windingRule)).
+                addMemberFunction("scaleStroke", LUANATIC_FUNCTION(&Item::scaleStroke)).
+                addMemberFunction("fill", LUANATIC_FUNCTION(&Item::fill)).
+                addMemberFunction("stroke", LUANATIC_FUNCTION(&Item::stroke)).
+                addMemberFunction("hasStroke", LUANATIC_FUNCTION(&Item::hasStroke)).
+                addMemberFunction("hasFill", LUANATIC_FUNCTION(&Item::hasFill)).
+                addMemberFunction("clone", LUANATIC_FUNCTION(&Item::clone)).
+                addMemberFunction("document", LUANATIC_FUNCTION(&Item::document)).
+                addMemberFunction("itemType", LUANATIC_FUNCTION(&Item::itemType)).
+                addMemberFunction("children", LUANATIC_FUNCTION(&Item::children, ReturnIterator<ph::Result>)).
+                addMemberFunction("exportSVG", LUANATIC_FUNCTION(&Item::exportSVG)).
+                addMemberFunction("exportSVGStream", detail::luaExportSVGStream).
+                addMemberFunction("saveSVG", LUANATIC_FUNCTION(&Item::saveSVG));
+
+                groupCW.
+                addBase<Item>().
+                addMemberFunction("setClipped", LUANATIC_FUNCTION(&Group::setClipped)).
+                addMemberFunction("isClipped", LUANATIC_FUNCTION(&Group::isClipped));
+
+                pathCW.
+                PAPERLUA_PATH_VEC2F_BINDINGS(PAPERLUA_ADD_VEC2F_BINDING, PAPERLUA_ADD_VEC2F_BINDING_OVERLOAD)
+                addBase<Item>().
+                addMemberFunction("addPoint", LUANATIC_FUNCTION(&Path::addPoint)).
+                addMemberFunction("cubicCurveTo", LUANATIC_FUNCTION(&Path::cubicCurveTo)).
+                addMemberFunction("quadraticCurveTo", LUANATIC_FUNCTION(&Path::quadraticCurveTo)).
+                addMemberFunction("curveTo", LUANATIC_FUNCTION(&Path::curveTo)).
+                addMemberFunction("arcThrough", LUANATIC_FUNCTION_OVERLOAD(Error(Path::*)(const Vec2f &, const Vec2f &), &Path::arcTo)).
+                addMemberFunction("arcTo", LUANATIC_FUNCTION_OVERLOAD(Error(Path::*)(const Vec2f &, bool), &Path::arcTo)).
+                addMemberFunction("cubicCurveBy", LUANATIC_FUNCTION(&Path::cubicCurveBy)).
+                addMemberFunction("quadraticCurveBy", LUANATIC_FUNCTION(&Path::quadraticCurveBy)).
+                addMemberFunction("curveBy", LUANATIC_FUNCTION(&Path::curveBy)).
+                addMemberFunction("closePath", LUANATIC_FUNCTION(&Path::closePath)).
+                addMemberFunction("smooth", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(Smoothing, bool), &Path::smooth)).
+                addMemberFunction("smoothFromTo", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(Int64, Int64, Smoothing), &Path::smooth)).
+                addMemberFunction("simplify", LUANATIC_FUNCTION(&Path::simplify)).
+                addMemberFunction("addSegment", LUANATIC_FUNCTION(&Path::addSegment)).
+                addMemberFunction("removeSegment", LUANATIC_FUNCTION(&Path::removeSegment)).
+                addMemberFunction("removeSegmentsFrom", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(Size), &Path::removeSegments)).
+                addMemberFunction("removeSegmentsFromTo", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(Size, Size), &Path::removeSegments)).
+                addMemberFunction("removeSegments", LUANATIC_FUNCTION_OVERLOAD(void(Path::*)(), &Path::removeSegments)).
+                addMemberFunction("segments", detail::luaPushContainerView<SegmentView, &Path::segments>).
+                addMemberFunction("curves", detail::luaPushContainerView<CurveView, &Path::curves>).
+                addMemberFunction("segmentData", detail::luaSegmentData<true>).
+                addMemberFunction("segmentPositions", detail::luaSegmentData<false>).
+                addMemberFunction("setSegmentData", detail::luaSetSegmentData<true>).
+                addMemberFunction("setSegmentPositions", detail::luaSetSegmentData<false>).
+                addMemberFunction("segmentBuffer", detail::luaSegmentBuffer).
+                addMemberFunction("setSegmentBuffer", detail::luaSetSegmentBuffer).
+                addMemberFunction("sampleAt", detail::luaSampleAt).
+                addMemberFunction("sampleUniform", detail::luaSampleUniform).
+                addMemberFunction("curvatureAt", LUANATIC_FUNCTION(&Path::curvatureAt)).
+                addMemberFunction("angleAt", LUANATIC_FUNCTION(&Path::angleAt)).
+                addMemberFunction("reverse", LUANATIC_FUNCTION(&Path::reverse)).
+                addMemberFunction("setClockwise", LUANATIC_FUNCTION(&Path::setClockwise)).
+                addMemberFunction("flatten", LUANATIC_FUNCTION(&Path::flatten)).
+                addMemberFunction("flattenRegular", LUANATIC_FUNCTION(&Path::flattenRegular)).
+                addMemberFunction("regularOffset", LUANATIC_FUNCTION(&Path::regularOffset)).
+                addMemberFunction("closestCurveLocation", &detail::luaClosestCurveLocation).
+                addMemberFunction("closestPoints", detail::luaClosestPoints).
+                addMemberFunction("curveLocationAt", detail::luaPathCurveLocationAt).
+                addMemberFunction("length", LUANATIC_FUNCTION(&Path::length)).
+                addMemberFunction("area", LUANATIC_FUNCTION(&Path::area)).
+                addMemberFunction("extrema", detail::luaExtrema).
+                addMemberFunction("isClosed", LUANATIC_FUNCTION(&Path::isClosed)).
+                addMemberFunction("isClockwise", LUANATIC_FUNCTION(&Path::isClockwise)).
+                addMemberFunction("contains", LUANATIC_FUNCTION(&Path::contains)).
+                addMemberFunction("segment", detail::luaSegmentHandle).
+                addMemberFunction("curve", detail::luaCurveHandle).
+                addMemberFunction("segmentCount", LUANATIC_FUNCTION(&Path::segmentCount)).
+                addMemberFunction("curveCount", LUANATIC_FUNCTION(&Path::curveCount)).
+                addMemberFunction("intersections", detail::luaIntersections).
+                addMemberFunction("slice", LUANATIC_FUNCTION_OVERLOAD(Path * (Path::*)(CurveLocation, CurveLocation)const, &Path::slice)).
+                addMemberFunction("slice", LUANATIC_FUNCTION_OVERLOAD(Path * (Path::*)(Float, Float)const, &Path::slice)).
+                addMemberFunction("snapshot", detail::luaSnapshot);
+
+                pathSnapshotCW.
+                PAPERLUA_PATH_SNAPSHOT_VEC2F_BINDINGS(PAPERLUA_ADD_VEC2F_BINDING, PAPERLUA_ADD_VEC2F_BINDING_OVERLOAD)
+                addMemberFunction("curveLocationAt", detail::luaSnapshotCurveLocationAt).
+                addMemberFunction("parameterAtOffset", LUANATIC_FUNCTION(&PathSnapshot::parameterAtOffset)).
+                addMemberFunction("curveLength", LUANATIC_FUNCTION(&PathSnapshot::curveLength)).
+                addMemberFunction("curveCount", LUANATIC_FUNCTION(&PathSnapshot::curveCount)).
+                addMemberFunction("length", LUANATIC_FUNCTION(&PathSnapshot::length)).
+                addMemberFunction("area", LUANATIC_FUNCTION(&PathSnapshot::area)).
+                addMemberFunction("bounds", LUANATIC_FUNCTION(&PathSnapshot::bounds)).
+                addMemberFunction("isClosed", LUANATIC_FUNCTION(&PathSnapshot::isClosed)).
+                addMemberFunction("ffiView", detail::luaSnapshotFFIView);
+
+                docCW.
+                addBase<Item>().
+                addConstructor<>().
+                addConstructor<const char *>().
+                addConstructor("new").
+                addConstructor<const char *>("newWithName").
+                addMemberFunction("createGroup", LUANATIC_FUNCTION(&Document::createGroup), "").
+                addMemberFunction("createPath", LUANATIC_FUNCTION(&Document::createPath), "").
+                addMemberFunction("createEllipse", LUANATIC_FUNCTION(&Document::createEllipse), "").
+                addMemberFunction("createCircle", LUANATIC_FUNCTION(&Document::createCircle), "").
+                addMemberFunction("createRectangle", LUANATIC_FUNCTION(&Document::createRectangle), "").
+                addMemberFunction("createRoundedRectangle", LUANATIC_FUNCTION(&Document::createRoundedRectangle), "").
+                addMemberFunction("setSize", LUANATIC_FUNCTION(&Document::setSize)).
+                addMemberFunction("width", LUANATIC_FUNCTION(&Document::width)).
+                addMemberFunction("height", LUANATIC_FUNCTION(&Document::height)).
+                addMemberFunction("size", LUANATIC_FUNCTION(&Document::size)).
+                addMemberFunction("hitTest", detail::luaHitTest).
+                addMemberFunction("itemsInRect", detail::luaItemsInRect).
+                addMemberFunction("parseSVG", detail::luaParseSVG).
+                addMemberFunction("loadSVG", detail::luaLoadSVG).
+                addMemberFunction("saveBinary", detail::luaSaveBinary);
+
+                rendererCW.
+                addMemberFunction("setViewport", LUANATIC_FUNCTION(&RenderInterface::setViewport)).
+                addMemberFunction("setProjection", LUANATIC_FUNCTION(&RenderInterface::setProjection)).
+                addMemberFunction("document", LUANATIC_FUNCTION(&RenderInterface::document)).
+                addMemberFunction("draw", LUANATIC_FUNCTION(&RenderInterface::draw));
+
+                tarpRendererCW.
+                addBase<RenderInterface>().
+                addConstructor<>().
+                addMemberFunction("init", LUANATIC_FUNCTION(&tarp::TarpRenderer::init));
+            }
+
+            luanatic::ClassWrapper<Segment> segmentCW;
+            luanatic::ClassWrapper<CurveLocation> curveLocationCW;
+            luanatic::ClassWrapper<Curve> curveCW;
+            luanatic::ClassWrapper<NoPaint> noPaintCW;
+            luanatic::ClassWrapper<BaseGradient> baseGradientCW;
+            luanatic::ClassWrapper<LinearGradient> linearGradientCW;
+            luanatic::ClassWrapper<RadialGradient> radialGradientCW;
+            luanatic::ClassWrapper<Item> itemCW;
+            luanatic::ClassWrapper<Group> groupCW;
+            luanatic::ClassWrapper<Path> pathCW;
+            luanatic::ClassWrapper<PathSnapshot> pathSnapshotCW;
+            luanatic::ClassWrapper<Document> docCW;
+            luanatic::ClassWrapper<RenderInterface> rendererCW;
+            luanatic::ClassWrapper<tarp::TarpRenderer> tarpRendererCW;
+        };
+
+        inline ClassWrappers & classWrappers()
+        {
+            static ClassWrappers s_wrappers;
+            return s_wrappers;
+        }
+
+        inline luanatic::LuaValue namespaceTable(lua_State * _state, const stick::String & _namespace)
+        {
+            using namespace luanatic;
+            using namespace stick;
+
+            LuaValue ret = globalsTable(_state);
+            if (!_namespace.isEmpty())
+            {
+                auto tokens = path::segments(_namespace, '.');
+                for (const String & token : tokens)
+                {
+                    LuaValue table = ret.findOrCreateTable(token);
+                    ret = table;
+                }
+            }
+            return ret;
+        }
+
+        //pushes the (existing) namespace table, or the globals table if _namespace is empty.
+        inline void luaPushNamespaceTable(lua_State * _state, const char * _namespace)
+        {
+            lua_pushglobaltable(_state);
+            const char * token = _namespace;
+            while (*token)
+            {
+                const char * tokenEnd = std::strchr(token, '.');
+                if (!tokenEnd)
+                    tokenEnd = token + std::strlen(token);
+                lua_pushlstring(_state, token, tokenEnd - token);
+                lua_rawget(_state, -2);
+                lua_remove(_state, -2);
+                token = *tokenEnd ? tokenEnd + 1 : tokenEnd;
+            }
+        }
+
+        inline void registerEnums(luanatic::LuaValue & _namespaceTable)
+        {
+            using namespace luanatic;
+
+            LuaValue & namespaceTable = _namespaceTable;
+
+            LuaValue strokeJoinTable = namespaceTable.findOrCreateTable("StrokeJoin");
+            strokeJoinTable["Miter"].set(StrokeJoin::Miter);
+            strokeJoinTable["Round"].set(StrokeJoin::Round);
+            strokeJoinTable["Bevel"].set(StrokeJoin::Bevel);
+
+            LuaValue strokeCapTable = namespaceTable.findOrCreateTable("StrokeCap");
+            strokeCapTable["Round"].set(StrokeCap::Round);
+            strokeCapTable["Square"].set(StrokeCap::Square);
+            strokeCapTable["Butt"].set(StrokeCap::Butt);
+
+            LuaValue windingRuleTable = namespaceTable.findOrCreateTable("WindingRule");
+            windingRuleTable["EvenOdd"].set(WindingRule::EvenOdd);
+            windingRuleTable["NonZero"].set(WindingRule::NonZero);
+
+            LuaValue smoothingTypeTable = namespaceTable.findOrCreateTable("Smoothing");
+            smoothingTypeTable["Continuous"].set(Smoothing::Continuous);
+            smoothingTypeTable["Asymmetric"].set(Smoothing::Asymmetric);
+            smoothingTypeTable["CatmullRom"].set(Smoothing::CatmullRom);
+            smoothingTypeTable["Geometric"].set(Smoothing::Geometric);
+
+            LuaValue itemTypeTable = namespaceTable.findOrCreateTable("ItemType");
+            itemTypeTable["Document"].set(ItemType::Document);
+            itemTypeTable["Group"].set(ItemType::Group);
+            itemTypeTable["Path"].set(ItemType::Path);
+            itemTypeTable["Symbol"].set(ItemType::Symbol);
+            itemTypeTable["Unknown"].set(ItemType::Unknown);
+        }
+
+        //all classes that items, segments and curves can return, they need to be registered
+        //together so that every object pushed to lua finds its metatable.
+        inline void registerCoreClasses(luanatic::LuaValue & _namespaceTable)
+        {
+            ClassWrappers & wrappers = classWrappers();
+            luanatic::LuaValue & namespaceTable = _namespaceTable;
+
+            namespaceTable.registerClass(wrappers.segmentCW);
+            namespaceTable.registerClass(wrappers.curveLocationCW);
+            namespaceTable.registerClass(wrappers.curveCW);
+            namespaceTable.registerClass(wrappers.noPaintCW);
+            namespaceTable.registerClass(wrappers.baseGradientCW);
+
+            namespaceTable.
+            registerClass(wrappers.linearGradientCW).
+            addWrapper<LinearGradient, LinearGradientPtr>();
+
+            namespaceTable.
+            registerClass(wrappers.radialGradientCW).
+            addWrapper<RadialGradient, RadialGradientPtr>();
+
+            namespaceTable.registerClass(wrappers.itemCW);
+            namespaceTable.registerClass(wrappers.groupCW);
+            namespaceTable.registerClass(wrappers.pathCW);
+            namespaceTable.registerClass(wrappers.pathSnapshotCW);
+
+            namespaceTable.
+            registerClass(wrappers.docCW).
+            registerFunction("createLinearGradient", LUANATIC_FUNCTION(&createLinearGradient)).
+            registerFunction("createRadialGradient", LUANATIC_FUNCTION(&createRadialGradient)).
+            registerFunction("intersectAll", detail::luaIntersectAll).
+            registerFunction("applyStyle", detail::luaApplyStyle).
+            registerFunction("transformItems", detail::luaTransformItems).
+            registerFunction("profile", detail::luaProfile).
+            registerFunction("resetProfile", detail::luaResetProfile).
+            registerFunction("profileJSON", detail::luaProfileJSON).
+            registerFunction("memory", detail::luaMemory).
+            registerFunction("ffiCdef", detail::luaFFICdef);
+
+            luanatic::LuaValue batchTable = namespaceTable.findOrCreateTable("batch");
+            batchTable.
+            registerFunction("flatten", detail::luaBatchFlatten).
+            registerFunction("flattenRegular", detail::luaBatchFlattenRegular).
+            registerFunction("regularOffset", detail::luaBatchRegularOffset).
+            registerFunction("simplify", detail::luaBatchSimplify).
+            registerFunction("smooth", detail::luaBatchSmooth);
+
+            luanatic::LuaValue slicedTable = namespaceTable.findOrCreateTable("sliced");
+            slicedTable.
+            registerFunction("simplify", detail::luaSlicedSimplify).
+            registerFunction("smooth", detail::luaSlicedSmooth).
+            registerFunction("intersectAll", detail::luaSlicedIntersectAll).
+            registerFunction("exportSVG", detail::luaSlicedExportSVG);
+
+            //static, it creates the document it returns
+            luanatic::LuaValue docTable = namespaceTable.findOrCreateTable("Document");
+            docTable.registerFunction("loadBinary", detail::luaLoadBinary);
+        }
+
+        inline void registerRendererClasses(luanatic::LuaValue & _namespaceTable)
+        {
+            ClassWrappers & wrappers = classWrappers();
+            luanatic::LuaValue & namespaceTable = _namespaceTable;
+
+            //TODO allow to specify which renderer to register via macro or template or possibly put
+            //it into a separate function?
+            namespaceTable.registerClass(wrappers.rendererCW);
+            namespaceTable.registerClass(wrappers.tarpRendererCW);
+        }
+
+        //sets the functions in _funcs (terminated by a null entry) in the class table _className
+        //of the namespace table at _index, replacing the checked bindings of the same names
+        inline void luaSetClassFunctions(lua_State * _state, Int32 _index, const char * _className, const luaL_Reg * _funcs)
+        {
+            lua_pushstring(_state, _className);
+            lua_rawget(_state, _index);
+            if (lua_istable(_state, -1))
+            {
+                for (; _funcs->name; ++_funcs)
+                {
+                    lua_pushstring(_state, _funcs->name);
+                    lua_pushcfunction(_state, _funcs->func);
+                    lua_rawset(_state, -3);
+                }
+            }
+            lua_pop(_state, 1);
+        }
+
+        //installs the bindings of _Policy in the namespace table at _index once the core classes
+        //are registered, see BindingPolicy
+        template<BindingPolicy Policy>
+        inline void luaApplyBindingPolicy(lua_State * _state, Int32 _index)
+        {
+            (void)_state;
+            (void)_index;
+        }
+
+        template<>
+        inline void luaApplyBindingPolicy<BindingPolicy::Unchecked>(lua_State * _state, Int32 _index)
+        {
+            static const luaL_Reg s_itemFunctions[] =
+            {
+                PAPERLUA_ITEM_UNCHECKED_BINDINGS(PAPERLUA_UNCHECKED_REG, PAPERLUA_UNCHECKED_REG_OVERLOAD)
+                {nullptr, nullptr}
+            };
+            static const luaL_Reg s_pathFunctions[] =
+            {
+                PAPERLUA_PATH_UNCHECKED_BINDINGS(PAPERLUA_UNCHECKED_REG, PAPERLUA_UNCHECKED_REG_OVERLOAD)
+                {nullptr, nullptr}
+            };
+            static const luaL_Reg s_segmentFunctions[] =
+            {
+                PAPERLUA_SEGMENT_UNCHECKED_BINDINGS(PAPERLUA_UNCHECKED_REG, PAPERLUA_UNCHECKED_REG_OVERLOAD)
+                {nullptr, nullptr}
+            };
+
+            _index = lua_absindex(_state, _index);
+            //set on the derived classes too, in case luanatic copied the base functions into them
+            for (const char * name : {"Item", "Group", "Path", "Document"})
+                luaSetClassFunctions(_state, _index, name, s_itemFunctions);
+            luaSetClassFunctions(_state, _index, "Path", s_pathFunctions);
+            luaSetClassFunctions(_state, _index, "Segment", s_segmentFunctions);
+        }
+
+        //what the bindings wrapped by luaWrapMutatingFunctions change
+        enum class MutationTarget
+        {
+            //items are added, removed or reordered, or the scope is unknown
+            Unknown,
+            //the item passed as the first argument changes in place
+            Item,
+            //the path of the segment or curve passed as the first argument changes in place
+            Segment,
+            Curve,
+            //a document is created and returned, it is registered as the owner of its items,
+            //see luaPushDocumentOwner
+            NewDocument
+        };
+
+        inline void luaMarkMutationTarget(lua_State * _state, MutationCounter & _counter, MutationTarget _target)
+        {
+            switch (_target)
+            {
+                case MutationTarget::Item:
+                    _counter.markItem(luanatic::convertToTypeAndCheck<Item>(_state, 1));
+                    break;
+                case MutationTarget::Segment:
+                    _counter.markItem(MutatedItem<Segment>::get(luanatic::convertToTypeAndCheck<Segment>(_state, 1)));
+                    break;
+                case MutationTarget::Curve:
+                    _counter.markItem(MutatedItem<Curve>::get(luanatic::convertToTypeAndCheck<Curve>(_state, 1)));
+                    break;
+                default:
+                    _counter.markUnknown();
+            }
+        }
+
+        //registers the document a constructor wrapped with MutationTarget::NewDocument returned,
+        //the first of the _resultCount values on top of the stack
+        inline void luaRegisterNewDocument(lua_State * _state, Int32 _resultCount)
+        {
+            if (_resultCount > 0)
+                luaRegisterDocument(_state, -_resultCount, luanatic::convertToTypeAndCheck<Document>(_state, -_resultCount));
+        }
+
+        //closure around a binding without upvalues that may change paper data. Upvalue 1 is the
+        //binding, upvalue 2 the MutationCounter of the state and upvalue 3 the MutationTarget.
+        //The binding runs in the frame of the closure, so wrapping costs no extra lua call.
+        inline Int32 luaMutatingDirectCall(lua_State * _state)
+        {
+            MutationTarget target = static_cast<MutationTarget>(lua_tointeger(_state, lua_upvalueindex(3)));
+            luaMarkMutationTarget(_state, *static_cast<MutationCounter *>(lua_touserdata(_state, lua_upvalueindex(2))), target);
+            Int32 ret = lua_tocfunction(_state, lua_upvalueindex(1))(_state);
+            if (target == MutationTarget::NewDocument)
+                luaRegisterNewDocument(_state, ret);
+            return ret;
+        }
+
+        //like luaMutatingDirectCall for bindings with upvalues of their own, which need a frame
+        //of their own to see them
+        inline Int32 luaMutatingCall(lua_State * _state)
+        {
+            MutationTarget target = static_cast<MutationTarget>(lua_tointeger(_state, lua_upvalueindex(3)));
+            luaMarkMutationTarget(_state, *static_cast<MutationCounter *>(lua_touserdata(_state, lua_upvalueindex(2))), target);
+            Int32 argCount = lua_gettop(_state);
+            lua_pushvalue(_state, lua_upvalueindex(1));
+            lua_insert(_state, 1);
+            lua_call(_state, argCount, LUA_MULTRET);
+            if (target == MutationTarget::NewDocument)
+                luaRegisterNewDocument(_state, lua_gettop(_state));
+            return lua_gettop(_state);
+        }
+
+        //wraps the C functions called _names (terminated by nullptr) in the table _tableName of
+        //the namespace table at _index with luaMutatingDirectCall or luaMutatingCall. Missing names
+        //are skipped.
+        inline void luaWrapMutatingFunctions(lua_State * _state, Int32 _index, const char * _tableName,
+                                             const char * const * _names, MutationTarget _target = MutationTarget::Unknown)
+        {
+            MutationCounter & counter = luaStateInstance<MutationCounter>(_state);
+            _index = lua_absindex(_state, _index);
+            if (_tableName)
+            {
+                lua_pushstring(_state, _tableName);
+                lua_rawget(_state, _index);
+            }
+            else
+                lua_pushvalue(_state, _index);
+
+            if (lua_istable(_state, -1))
+            {
+                for (; *_names; ++_names)
+                {
+                    lua_pushstring(_state, *_names);
+                    lua_pushvalue(_state, -1);
+                    lua_rawget(_state, -3);
+                    lua_CFunction func = lua_iscfunction(_state, -1) ? lua_tocfunction(_state, -1) : nullptr;
+                    if (func && func != luaMutatingDirectCall && func != luaMutatingCall)
+                    {
+                        bool bHasUpvalues = lua_getupvalue(_state, -1, 1) != nullptr;
+                        if (bHasUpvalues)
+                            lua_pop(_state, 1);
+                        lua_pushlightuserdata(_state, &counter);
+                        lua_pushinteger(_state, static_cast<lua_Integer>(_target));
+                        lua_pushcclosure(_state, bHasUpvalues ? luaMutatingCall : luaMutatingDirectCall, 3);
+                        lua_rawset(_state, -3);
+                    }
+                    else
+                        lua_pop(_state, 2);
+                }
+            }
+            lua_pop(_state, 1);
+        }
+
+        //Wraps every binding that can change items, paths, segments or curves in the namespace
+        //table at _index, so caches keyed on paper data can tell from luaMutationGeneration
+        //whether they need to look at the data again. Changes made from C++ are not seen, see
+        //invalidateCaches. The sliced functions mark the mutation in luaRunSliced instead, a
+        //wrapper would keep them from yielding. The XY variants (NumbersFunction) and the
+        //functions of BindingPolicy::Unchecked mark it themselves and skip the extra call.
+        //Bindings that only change their first argument in place log it, see MutationCounter.
+        inline void luaWrapMutatingBindings(lua_State * _state, Int32 _index)
+        {
+            static const char * const s_itemNames[] =
+            {
+                "setPosition", "setPivot", "translate", "translateTransform", "scale", "scaleTransform",
+                "scaleAroundTransform", "rotate", "rotateAround", "rotateTransform",
+                "rotateAroundTransform", "transformItem", "setTransform", "applyTransform",
+                "setVisible", "setStrokeWidth", "setMiterLimit", "setStrokeJoin", "setStrokeCap", "setScaleStroke", "setStyle",
+                "setStroke", "setStrokeColor", "setStrokeString", "setStrokeLinearGradient",
+                "setStrokeRadialGradient", "removeStroke", "setFill", "setFillColor", "setFillString",
+                "setFillLinearGradient", "setFillRadialGradient", "removeFill", "setWindingRule",
+                "setDashArray", "setDashOffset", "setName",
+                nullptr
+            };
+            static const char * const s_itemStructureNames[] =
+            {
+                "addChild", "insertAbove", "insertBelow", "sendToFront", "sendToBack",
+                "reverseChildren", "remove", "removeChildren", "clone",
+                nullptr
+            };
+            static const char * const s_pathNames[] =
+            {
+                "addPoint", "cubicCurveTo", "quadraticCurveTo", "curveTo", "arcThrough", "arcTo",
+                "cubicCurveBy", "quadraticCurveBy", "curveBy", "closePath", "smooth", "smoothFromTo",
+                "simplify", "addSegment", "removeSegment", "removeSegmentsFrom", "removeSegmentsFromTo",
+                "removeSegments", "setSegmentData", "setSegmentPositions", "setSegmentBuffer",
+                "reverse", "setClockwise", "flatten", "flattenRegular", "regularOffset", "divideAt",
+                "divideAtParameter",
+                nullptr
+            };
+            static const char * const s_pathStructureNames[] = {"slice", nullptr};
+            static const char * const s_groupNames[] = {"setClipped", nullptr};
+            static const char * const s_documentNames[] =
+            {
+                "createGroup", "createPath", "createCircle", "createEllipse", "createRectangle",
+                "createRoundedRectangle", "parseSVG", "loadSVG", "setSize",
+                //a new document may get the address of a collected one the caches still know,
+                //loadBinary registers its document itself
+                "loadBinary",
+                nullptr
+            };
+            static const char * const s_constructorNames[] = {"new", "newWithName", "__call", nullptr};
+            static const char * const s_segmentNames[] =
+            {
+                "setPosition", "setHandleIn", "setHandleOut", "remove",
+                nullptr
+            };
+            static const char * const s_curveNames[] =
+            {
+                "setPositionOne", "setHandleOne", "setPositionTwo", "setHandleTwo",
+                "divideAt", "divideAtParameter",
+                nullptr
+            };
+            static const char * const s_batchNames[] = {"flatten", "flattenRegular", "regularOffset", "simplify", "smooth", nullptr};
+            static const char * const s_functionNames[] = {"applyStyle", "transformItems", nullptr};
+
+            _index = lua_absindex(_state, _index);
+            for (const char * name : {"Item", "Group", "Path", "Document"})
+            {
+                luaWrapMutatingFunctions(_state, _index, name, s_itemNames, MutationTarget::Item);
+                luaWrapMutatingFunctions(_state, _index, name, s_itemStructureNames);
+            }
+            luaWrapMutatingFunctions(_state, _index, "Path", s_pathNames, MutationTarget::Item);
+            luaWrapMutatingFunctions(_state, _index, "Path", s_pathStructureNames);
+            luaWrapMutatingFunctions(_state, _index, "Group", s_groupNames, MutationTarget::Item);
+            luaWrapMutatingFunctions(_state, _index, "Document", s_documentNames);
+            luaWrapMutatingFunctions(_state, _index, "Document", s_constructorNames, MutationTarget::NewDocument);
+            luaWrapMutatingFunctions(_state, _index, "Segment", s_segmentNames, MutationTarget::Segment);
+            luaWrapMutatingFunctions(_state, _index, "Curve", s_curveNames, MutationTarget::Curve);
+            luaWrapMutatingFunctions(_state, _index, "batch", s_batchNames);
+            luaWrapMutatingFunctions(_state, _index, nullptr, s_functionNames);
+
+            lua_pushstring(_state, "Document");
+            lua_rawget(_state, _index);
+            if (lua_istable(_state, -1) && lua_getmetatable(_state, -1))
+            {
+                luaWrapMutatingFunctions(_state, -1, nullptr, s_constructorNames, MutationTarget::NewDocument);
+                lua_pop(_state, 1);
+            }
+            lua_pop(_state, 1);
+        }
+
+        enum RegistrationGroup
+        {
+            RegistrationGroupEnums,
+            RegistrationGroupCore,
+            RegistrationGroupRenderer,
+            RegistrationGroupCount
+        };
+
+        //which groups were already registered with a lua_State, see luaStateInstance
+        struct RegisteredGroups
+        {
+            RegisteredGroups() :
+                bRegistering(false),
+                applyBindingPolicy(nullptr),
+                bBindingPolicyApplied(false)
+            {
+                std::fill(bRegistered, bRegistered + RegistrationGroupCount, false);
+            }
+
+            bool bRegistered[RegistrationGroupCount];
+            //true while a group is being registered. Registration itself looks up keys in the
+            //namespace table, those lookups must not trigger further lazy registration.
+            bool bRegistering;
+            //luaApplyBindingPolicy for the policy registerPaper was called with
+            void (*applyBindingPolicy)(lua_State *, Int32);
+            bool bBindingPolicyApplied;
+        };
+
+        //wraps the mutating bindings and applies the binding policy to the namespace table at
+        //_index if the core classes were registered and it did not happen yet. The policy comes
+        //second, its functions mark mutations themselves and replace the wrapped ones. Must run
+        //before luaInstrumentNamespace so the profiler wraps the final bindings.
+        inline void luaFinishCoreClasses(lua_State * _state, Int32 _index)
+        {
+            RegisteredGroups & groups = luaStateInstance<RegisteredGroups>(_state);
+            if (groups.bBindingPolicyApplied || !groups.bRegistered[RegistrationGroupCore] || !groups.applyBindingPolicy)
+                return;
+            groups.bBindingPolicyApplied = true;
+            luaWrapMutatingBindings(_state, _index);
+            groups.applyBindingPolicy(_state, _index);
+        }
+
+        inline void registerGroup(lua_State * _state, luanatic::LuaValue & _namespaceTable, RegistrationGroup _group)
+        {
+            RegisteredGroups & groups = luaStateInstance<RegisteredGroups>(_state);
+            if (groups.bRegistered[_group])
+                return;
+            groups.bRegistered[_group] = true;
+            bool bWasRegistering = groups.bRegistering;
+            groups.bRegistering = true;
+
+            switch (_group)
+            {
+            case RegistrationGroupEnums:
+                registerEnums(_namespaceTable);
+                break;
+            case RegistrationGroupCore:
+                registerCoreClasses(_namespaceTable);
+                break;
+            case RegistrationGroupRenderer:
+                registerGroup(_state, _namespaceTable, RegistrationGroupCore);
+                registerRendererClasses(_namespaceTable);
+                break;
+            default:
+                break;
+            }
+            groups.bRegistering = bWasRegistering;
+        }
+
+        //removes luaLazyIndex from the namespace table at _index
+        inline void luaRemoveLazyIndex(lua_State * _state, Int32 _index)
+        {
+            if (!lua_getmetatable(_state, _index))
+                return;
+            lua_pushnil(_state);
+            lua_setfield(_state, -2, "__index");
+            lua_pop(_state, 1);
+        }
+
+        //__index of the namespace table in lazy mode. Registers the groups from cheapest to most
+        //expensive until the requested key exists. Upvalue 1 is the namespace string.
+        inline Int32 luaLazyIndex(lua_State * _state)
+        {
+            if (luaStateInstance<RegisteredGroups>(_state).bRegistering)
+            {
+                lua_pushnil(_state);
+                return 1;
+            }
+
+            luanatic::LuaValue ns = namespaceTable(_state, lua_tostring(_state, lua_upvalueindex(1)));
+            for (Int32 i = 0; i < RegistrationGroupCount; ++i)
+            {
+                registerGroup(_state, ns, (RegistrationGroup)i);
+                luaFinishCoreClasses(_state, 1);
+                luaInstrumentNamespace(_state, 1);
+                //everything is there now, later misses don't need to come through here
+                if (i == RegistrationGroupCount - 1)
+                    luaRemoveLazyIndex(_state, 1);
+                lua_pushvalue(_state, 2);
+                lua_rawget(_state, 1);
+                if (!lua_isnil(_state, -1))
+                    return 1;
+                lua_pop(_state, 1);
+            }
+            lua_pushnil(_state);
+            return 1;
+        }
+
+        //installs luaLazyIndex as __index of the namespace table. Returns false if the table
+        //already has an __index metamethod, in which case nothing is changed.
+        inline bool luaInstallLazyIndex(lua_State * _state, const stick::String & _namespace)
+        {
+            luaPushNamespaceTable(_state, _namespace.cString());
+            if (!lua_getmetatable(_state, -1))
+            {
+                lua_newtable(_state);
+                lua_pushvalue(_state, -1);
+                lua_setmetatable(_state, -3);
+            }
+            lua_getfield(_state, -1, "__index");
+            bool bFree = lua_isnil(_state, -1);
+            lua_pop(_state, 1);
+            if (bFree)
+            {
+                lua_pushstring(_state, _namespace.cString());
+                lua_pushcclosure(_state, luaLazyIndex, 1);
+                lua_setfield(_state, -2, "__index");
+            }
+            lua_pop(_state, 2);
+            return bFree;
+        }
+    }
+
+    template<BindingPolicy Policy>
+    inline void registerPaper(lua_State * _state, const stick::String & _namespace, RegistrationMode _mode)
+    {
+        luanatic::LuaValue namespaceTable = detail::namespaceTable(_state, _namespace);
+        detail::luaStateInstance<detail::RegisteredGroups>(_state).applyBindingPolicy = &detail::luaApplyBindingPolicy<Policy>;
+        if (_mode == RegistrationMode::Lazy && !_namespace.isEmpty() && detail::luaInstallLazyIndex(_state, _namespace))
+            return;
+
+        for (stick::Int32 i = 0; i < detail::RegistrationGroupCount; ++i)
+            detail::registerGroup(_state, namespaceTable, (detail::RegistrationGroup)i);
+
+        detail::luaPushNamespaceTable(_state, _namespace.cString());
+        detail::luaFinishCoreClasses(_state, -1);
+        detail::luaInstrumentNamespace(_state, -1);
+        lua_pop(_state, 1);
+    }
+
+    inline void invalidateCaches(lua_State * _state)
+    {
+        detail::luaMarkMutation(_state);
     }
 }
 
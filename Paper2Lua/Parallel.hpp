@@ -0,0 +1,171 @@
+#ifndef PAPERLUA_PARALLEL_HPP
+#define PAPERLUA_PARALLEL_HPP
+
+#include <Stick/DynamicArray.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace paperLua
+{
+    namespace detail
+    {
+        inline stick::Size hardwareThreadCount()
+        {
+            stick::Size ret = std::thread::hardware_concurrency();
+            return ret ? ret : 1;
+        }
+
+        //Threads that stay around between parallel calls, so a call costs a wakeup per worker
+        //instead of starting and joining a thread. Workers are started the first time they are
+        //needed and live until the pool is destructed. Only one thread may call run at a time,
+        //which holds for the pool of a lua_State, see luaWorkerPool.
+        class WorkerPool
+        {
+        public:
+
+            WorkerPool() :
+                m_job(nullptr),
+                m_context(nullptr),
+                m_jobIndex(0),
+                m_wantedCount(0),
+                m_claimedCount(0),
+                m_remainingCount(0),
+                m_bQuit(false)
+            {
+            }
+
+            WorkerPool(const WorkerPool &) = delete;
+            WorkerPool & operator = (const WorkerPool &) = delete;
+
+            ~WorkerPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_bQuit = true;
+                }
+                m_wake.notify_all();
+                for (auto & t : m_threads)
+                    t.join();
+            }
+
+            //calls _func(workerIndex) on _threadCount - 1 pool threads and on the calling thread,
+            //which gets index 0, and returns once all of the calls returned.
+            template<class F>
+            void run(stick::Size _threadCount, F & _func)
+            {
+                if (_threadCount <= 1)
+                {
+                    _func(0);
+                    return;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    while (m_threads.size() < _threadCount - 1)
+                        m_threads.emplace_back(&WorkerPool::workerLoop, this);
+                    m_job = &callJob<F>;
+                    m_context = &_func;
+                    m_wantedCount = _threadCount - 1;
+                    m_claimedCount = 0;
+                    m_remainingCount = _threadCount - 1;
+                    ++m_jobIndex;
+                }
+                m_wake.notify_all();
+
+                _func(0);
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_done.wait(lock, [this]() { return m_remainingCount == 0; });
+                m_job = nullptr;
+                m_context = nullptr;
+            }
+
+            stick::Size threadCount() const
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_threads.size();
+            }
+
+        private:
+
+            using JobFunction = void (*)(void *, stick::Size);
+
+            template<class F>
+            static void callJob(void * _context, stick::Size _workerIndex)
+            {
+                (*static_cast<F *>(_context))(_workerIndex);
+            }
+
+            void workerLoop()
+            {
+                stick::UInt64 lastJob = 0;
+                std::unique_lock<std::mutex> lock(m_mutex);
+                for (;;)
+                {
+                    //every worker takes part in a job at most once, and only as many as asked for
+                    m_wake.wait(lock, [&]()
+                    {
+                        return m_bQuit || (m_jobIndex != lastJob && m_claimedCount < m_wantedCount);
+                    });
+                    if (m_bQuit)
+                        return;
+
+                    lastJob = m_jobIndex;
+                    stick::Size workerIndex = ++m_claimedCount;
+                    JobFunction job = m_job;
+                    void * context = m_context;
+                    lock.unlock();
+                    job(context, workerIndex);
+                    lock.lock();
+                    if (--m_remainingCount == 0)
+                        m_done.notify_one();
+                }
+            }
+
+            mutable std::mutex m_mutex;
+            std::condition_variable m_wake;
+            std::condition_variable m_done;
+            std::vector<std::thread> m_threads;
+            JobFunction m_job;
+            void * m_context;
+            stick::UInt64 m_jobIndex;
+            stick::Size m_wantedCount;
+            stick::Size m_claimedCount;
+            stick::Size m_remainingCount;
+            bool m_bQuit;
+        };
+
+        //Calls _func(begin, end) for chunks of at most _grainSize elements of [0, _count) on up to
+        //_threadCount threads of _pool, including the calling one. Threads grab the next chunk as
+        //soon as they are done with their current one, so uneven work evens out. The chunking only
+        //depends on _count and _grainSize, so each chunk sees the same input no matter how many
+        //threads run.
+        template<class F>
+        inline void parallelFor(WorkerPool & _pool, stick::Size _count, stick::Size _grainSize, stick::Size _threadCount, F _func)
+        {
+            _grainSize = std::max(_grainSize, (stick::Size)1);
+            stick::Size chunkCount = (_count + _grainSize - 1) / _grainSize;
+            _threadCount = std::min(_threadCount, chunkCount);
+
+            std::atomic<stick::Size> next(0);
+            auto worker = [&](stick::Size)
+            {
+                for (;;)
+                {
+                    stick::Size begin = next.fetch_add(_grainSize);
+                    if (begin >= _count)
+                        break;
+                    _func(begin, std::min(begin + _grainSize, _count));
+                }
+            };
+            _pool.run(_threadCount, worker);
+        }
+    }
+}
+
+#endif //PAPERLUA_PARALLEL_HPP
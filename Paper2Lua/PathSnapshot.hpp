@@ -0,0 +1,309 @@
+#ifndef PAPERLUA_PATHSNAPSHOT_HPP
+#define PAPERLUA_PATHSNAPSHOT_HPP
+
+#include <Paper2/Path.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace paperLua
+{
+    namespace detail
+    {
+        using namespace paper;
+
+        //Frozen copy of the geometry of a path for scripts that query the same path over and over.
+        //The control points are stored as separate x and y arrays where curve i uses the entries
+        //3 * i to 3 * i + 3, so consecutive curves share their end points. Next to them the snapshot
+        //keeps a table of cumulative arc lengths sampled at subdivisionCount uniform parameter steps
+        //per curve. Offset queries binary search that table and refine the parameter with a few
+        //newton steps inside the sample interval, instead of integrating the whole path again like
+        //Path::positionAt does. Bounds and area are computed once when the snapshot is taken.
+        //A snapshot never changes and doesn't reference the path, so it can be read from several
+        //threads at once and outlives the path it was taken from.
+        class PathSnapshot
+        {
+        public:
+
+            static const Size subdivisionCount = 8;
+
+            explicit PathSnapshot(stick::Allocator & _alloc = stick::defaultAllocator()) :
+                m_curveCount(0),
+                m_x(_alloc),
+                m_y(_alloc),
+                m_lengths(_alloc),
+                m_area(0),
+                m_bClosed(false)
+            {
+            }
+
+            //the arrays are allocated with _alloc
+            explicit PathSnapshot(Path * _path, stick::Allocator & _alloc = stick::defaultAllocator()) :
+                PathSnapshot(_alloc)
+            {
+                m_bClosed = _path->isClosed();
+                m_curveCount = _path->curveCount();
+                m_x.reserve(m_curveCount * 3 + 1);
+                m_y.reserve(m_curveCount * 3 + 1);
+
+                if (!m_curveCount)
+                {
+                    Vec2f p = _path->segmentCount() ? _path->segment(0).position() : Vec2f(0, 0);
+                    m_x.append(p.x);
+                    m_y.append(p.y);
+                    m_lengths.append(0);
+                    m_bounds = Rect(p, p);
+                    return;
+                }
+
+                Vec2f min, max;
+                for (Size i = 0; i < m_curveCount; ++i)
+                {
+                    Curve c = _path->curve(i);
+                    Vec2f points[4] = {c.positionOne(), c.handleOneAbsolute(), c.handleTwoAbsolute(), c.positionTwo()};
+                    for (Size j = i ? 1 : 0; j < 4; ++j)
+                    {
+                        m_x.append(points[j].x);
+                        m_y.append(points[j].y);
+                    }
+
+                    const Rect & b = c.bounds();
+                    min = i ? Vec2f(std::min(min.x, b.min().x), std::min(min.y, b.min().y)) : b.min();
+                    max = i ? Vec2f(std::max(max.x, b.max().x), std::max(max.y, b.max().y)) : b.max();
+                }
+                m_bounds = Rect(min, max);
+
+                m_lengths.reserve(m_curveCount * subdivisionCount + 1);
+                m_lengths.append(0);
+                Float total = 0;
+                for (Size i = 0; i < m_curveCount; ++i)
+                {
+                    for (Size j = 0; j < subdivisionCount; ++j)
+                    {
+                        total += lengthBetween(i, (Float)j / subdivisionCount, (Float)(j + 1) / subdivisionCount);
+                        m_lengths.append(total);
+                    }
+                    m_area += curveArea(m_x[i * 3], m_y[i * 3], m_x[i * 3 + 1], m_y[i * 3 + 1],
+                                        m_x[i * 3 + 2], m_y[i * 3 + 2], m_x[i * 3 + 3], m_y[i * 3 + 3]);
+                }
+
+                //like Path::area, open paths are measured as if closed by a straight line
+                if (!m_bClosed)
+                {
+                    Float x0 = m_x[m_x.count() - 1], y0 = m_y[m_y.count() - 1], x1 = m_x[0], y1 = m_y[0];
+                    m_area += curveArea(x0, y0, x0, y0, x1, y1, x1, y1);
+                }
+            }
+
+            Float length() const
+            {
+                return m_lengths[m_lengths.count() - 1];
+            }
+
+            Size curveCount() const
+            {
+                return m_curveCount;
+            }
+
+            bool isClosed() const
+            {
+                return m_bClosed;
+            }
+
+            Float area() const
+            {
+                return m_area;
+            }
+
+            const Rect & bounds() const
+            {
+                return m_bounds;
+            }
+
+            Float curveLength(Size _curveIndex) const
+            {
+                if (_curveIndex >= m_curveCount)
+                    return 0;
+                return m_lengths[(_curveIndex + 1) * subdivisionCount] - m_lengths[_curveIndex * subdivisionCount];
+            }
+
+            //curve and parameter at the path offset _offset, which is clamped to the path
+            void curveLocationAt(Float _offset, Size & _outCurveIndex, Float & _outParameter) const
+            {
+                if (!m_curveCount)
+                {
+                    _outCurveIndex = 0;
+                    _outParameter = 0;
+                    return;
+                }
+                Size sample = findSample(_offset, 0, m_lengths.count() - 1);
+                _outCurveIndex = sample / subdivisionCount;
+                _outParameter = refine(sample, _offset);
+            }
+
+            //parameter at the offset _offset along the curve _curveIndex, see Curve::parameterAtOffset
+            Float parameterAtOffset(Size _curveIndex, Float _offset) const
+            {
+                if (_curveIndex >= m_curveCount)
+                    return 0;
+                Size first = _curveIndex * subdivisionCount;
+                Float offset = m_lengths[first] + _offset;
+                return refine(findSample(offset, first, first + subdivisionCount), offset);
+            }
+
+            Vec2f positionAt(Float _offset) const
+            {
+                Size curve;
+                Float t;
+                curveLocationAt(_offset, curve, t);
+                return position(curve, t);
+            }
+
+            Vec2f tangentAt(Float _offset) const
+            {
+                Size curve;
+                Float t;
+                curveLocationAt(_offset, curve, t);
+                Vec2f d = derivative(curve, t);
+                Float len = std::sqrt(d.x * d.x + d.y * d.y);
+                return len > 0 ? Vec2f(d.x / len, d.y / len) : Vec2f(0, 0);
+            }
+
+            Vec2f normalAt(Float _offset) const
+            {
+                Vec2f t = tangentAt(_offset);
+                return Vec2f(-t.y, t.x);
+            }
+
+            Vec2f position(Size _curveIndex, Float _t) const
+            {
+                if (!m_curveCount)
+                    return Vec2f(m_x[0], m_y[0]);
+                Size i = _curveIndex * 3;
+                Float mt = 1 - _t;
+                Float a = mt * mt * mt;
+                Float b = 3 * mt * mt * _t;
+                Float c = 3 * mt * _t * _t;
+                Float d = _t * _t * _t;
+                return Vec2f(a * m_x[i] + b * m_x[i + 1] + c * m_x[i + 2] + d * m_x[i + 3],
+                             a * m_y[i] + b * m_y[i + 1] + c * m_y[i + 2] + d * m_y[i + 3]);
+            }
+
+            Vec2f derivative(Size _curveIndex, Float _t) const
+            {
+                if (!m_curveCount)
+                    return Vec2f(0, 0);
+                Size i = _curveIndex * 3;
+                Float mt = 1 - _t;
+                Float a = 3 * mt * mt;
+                Float b = 6 * mt * _t;
+                Float c = 3 * _t * _t;
+                return Vec2f(a * (m_x[i + 1] - m_x[i]) + b * (m_x[i + 2] - m_x[i + 1]) + c * (m_x[i + 3] - m_x[i + 2]),
+                             a * (m_y[i + 1] - m_y[i]) + b * (m_y[i + 2] - m_y[i + 1]) + c * (m_y[i + 3] - m_y[i + 2]));
+            }
+
+            //raw storage, see the class comment. x and y hold pointCount entries, the length table
+            //sampleCount + 1 entries.
+            const Float * xData() const
+            {
+                return &m_x[0];
+            }
+
+            const Float * yData() const
+            {
+                return &m_y[0];
+            }
+
+            Size pointCount() const
+            {
+                return m_x.count();
+            }
+
+            const Float * lengthData() const
+            {
+                return &m_lengths[0];
+            }
+
+            Size sampleCount() const
+            {
+                return m_lengths.count() - 1;
+            }
+
+        private:
+
+            Float speed(Size _curveIndex, Float _t) const
+            {
+                Vec2f d = derivative(_curveIndex, _t);
+                return std::sqrt(d.x * d.x + d.y * d.y);
+            }
+
+            //5 point gauss legendre quadrature of the speed, plenty for a single sample interval
+            Float lengthBetween(Size _curveIndex, Float _a, Float _b) const
+            {
+                static const Float s_abscissae[5] = {-0.9061798459f, -0.5384693101f, 0.0f, 0.5384693101f, 0.9061798459f};
+                static const Float s_weights[5] = {0.2369268851f, 0.4786286705f, 0.5688888889f, 0.4786286705f, 0.2369268851f};
+
+                Float half = (_b - _a) * 0.5f;
+                Float mid = _a + half;
+                Float sum = 0;
+                for (Int32 i = 0; i < 5; ++i)
+                    sum += s_weights[i] * speed(_curveIndex, mid + half * s_abscissae[i]);
+                return sum * half;
+            }
+
+            //index of the sample interval in [_first, _last) that contains _offset
+            Size findSample(Float _offset, Size _first, Size _last) const
+            {
+                const Float * lengths = &m_lengths[0];
+                Size ret = std::lower_bound(lengths + _first + 1, lengths + _last, _offset) - lengths - 1;
+                return std::min(ret, _last - 1);
+            }
+
+            Float refine(Size _sample, Float _offset) const
+            {
+                Size curve = _sample / subdivisionCount;
+                Float t0 = (Float)(_sample % subdivisionCount) / subdivisionCount;
+                Float t1 = t0 + (Float)1 / subdivisionCount;
+                Float l0 = m_lengths[_sample];
+                Float l1 = m_lengths[_sample + 1];
+                Float target = std::min(std::max(_offset, l0), l1);
+                if (l1 - l0 <= 0)
+                    return t0;
+
+                Float t = t0 + (t1 - t0) * (target - l0) / (l1 - l0);
+                for (Int32 i = 0; i < 4; ++i)
+                {
+                    Float error = lengthBetween(curve, t0, t) - (target - l0);
+                    Float s = speed(curve, t);
+                    if (std::abs(error) < 1e-5f * (l1 - l0) || s <= 0)
+                        break;
+                    t = std::min(std::max(t - error / s, t0), t1);
+                }
+                return t;
+            }
+
+            //signed area between the curve and the origin, summed up over a closed path this is the
+            //area enclosed by it (green's theorem)
+            static Float curveArea(Float _x0, Float _y0, Float _x1, Float _y1,
+                                   Float _x2, Float _y2, Float _x3, Float _y3)
+            {
+                return 3 * ((_y3 - _y0) * (_x1 + _x2) - (_x3 - _x0) * (_y1 + _y2) +
+                            _y1 * (_x0 - _x2) - _x1 * (_y0 - _y2) +
+                            _y3 * (_x2 + _x0 / 3) - _x3 * (_y2 + _y0 / 3)) / 20;
+            }
+
+            Size m_curveCount;
+            stick::DynamicArray<Float> m_x;
+            stick::DynamicArray<Float> m_y;
+            //cumulative arc length at the start of every sample interval plus the total length
+            stick::DynamicArray<Float> m_lengths;
+            Rect m_bounds;
+            Float m_area;
+            bool m_bClosed;
+        };
+    }
+
+    using detail::PathSnapshot;
+}
+
+#endif //PAPERLUA_PATHSNAPSHOT_HPP
@@ -0,0 +1,453 @@
+#ifndef PAPERLUA_POOLALLOCATOR_HPP
+#define PAPERLUA_POOLALLOCATOR_HPP
+
+#include <Luanatic/Luanatic.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace paperLua
+{
+    namespace detail
+    {
+        class PoolAllocator;
+
+        //stick::Allocator on top of a PoolAllocator for the containers the bindings keep per
+        //lua_State (caches, snapshots, the scratch arrays of loadBinary), so they count towards
+        //the budget and paper.memory() and are freed together with the pool. The items of
+        //documents come from paper's own allocator. Every block starts with a header holding its
+        //size, so deallocate doesn't depend on the size the container passes back.
+        class PooledStickAllocator : public stick::Allocator
+        {
+        public:
+
+            explicit PooledStickAllocator(PoolAllocator & _pool) :
+                m_pool(_pool)
+            {
+            }
+
+            inline stick::Block allocate(stick::Size _byteCount, stick::Size _alignment);
+
+            inline stick::Block reallocate(const stick::Block & _block, stick::Size _byteCount);
+
+            inline void deallocate(const stick::Block & _block);
+
+        private:
+
+            PoolAllocator & m_pool;
+        };
+
+        //Allocator for a single lua_State. Blocks of up to maxPooledSize bytes come from free
+        //lists with one list per 16 byte size class, which are refilled from large pages. Most
+        //of what lua allocates while scripts run (handle userdata, small tables, closures,
+        //strings) is that small, so the churn of creating and collecting them no longer goes
+        //through malloc. Larger blocks use malloc directly but stay linked to the allocator.
+        //Pages and large blocks are only released when the allocator is destroyed, after the
+        //lua_State was closed, which frees everything the script allocated in one go.
+        //The allocator also keeps track of the bytes in use and their peak, and can refuse to
+        //grow beyond a budget. Lua turns that into a regular memory error.
+        //stickAllocator() hands the same memory to C++ containers, see PooledStickAllocator.
+        class PoolAllocator
+        {
+        public:
+
+            static const stick::Size granularity = 16;
+            static const stick::Size maxPooledSize = 256;
+            static const stick::Size pageSize = 64 * 1024;
+            static const stick::Size classCount = maxPooledSize / granularity;
+
+            //_budget is the maximum number of bytes in use at once, 0 means unlimited
+            explicit PoolAllocator(stick::Size _budget = 0) :
+                m_pages(nullptr),
+                m_largeBlocks(nullptr),
+                m_pooledCount(0),
+                m_mallocCount(0),
+                m_budget(_budget),
+                m_currentBytes(0),
+                m_peakBytes(0),
+                m_stickAllocator(*this)
+            {
+                std::memset(m_freeLists, 0, sizeof(m_freeLists));
+            }
+
+            ~PoolAllocator()
+            {
+                while (m_pages)
+                {
+                    Page * next = m_pages->next;
+                    std::free(m_pages);
+                    m_pages = next;
+                }
+                while (m_largeBlocks)
+                {
+                    LargeBlock * next = m_largeBlocks->next;
+                    std::free(m_largeBlocks);
+                    m_largeBlocks = next;
+                }
+            }
+
+            PoolAllocator(const PoolAllocator &) = delete;
+            PoolAllocator & operator = (const PoolAllocator &) = delete;
+
+            //lua_Alloc semantics
+            void * reallocate(void * _ptr, stick::Size _oldSize, stick::Size _newSize)
+            {
+                if (!_ptr)
+                    _oldSize = 0;
+
+                if (_newSize == 0)
+                {
+                    release(_ptr, _oldSize);
+                    m_currentBytes -= _oldSize;
+                    return nullptr;
+                }
+
+                //only growing can fail, lua expects shrinking to always work
+                if (m_budget && _newSize > _oldSize && m_currentBytes + (_newSize - _oldSize) > m_budget)
+                    return nullptr;
+
+                void * ret = resize(_ptr, _oldSize, _newSize);
+                if (ret)
+                {
+                    m_currentBytes = m_currentBytes - _oldSize + _newSize;
+                    m_peakBytes = std::max(m_peakBytes, m_currentBytes);
+                }
+                return ret;
+            }
+
+            //allocations of the C++ side, see PooledStickAllocator. They count towards the bytes in
+            //use but ignore the budget, the containers using them can't handle a failed
+            //allocation. The bindings check overBudget() once they are done instead.
+            void * allocateUnbudgeted(stick::Size _size)
+            {
+                void * ret = allocate(_size);
+                if (ret)
+                {
+                    m_currentBytes += _size;
+                    m_peakBytes = std::max(m_peakBytes, m_currentBytes);
+                }
+                return ret;
+            }
+
+            void releaseUnbudgeted(void * _ptr, stick::Size _size)
+            {
+                release(_ptr, _size);
+                m_currentBytes -= _size;
+            }
+
+            bool overBudget() const
+            {
+                return m_budget && m_currentBytes > m_budget;
+            }
+
+            stick::Allocator & stickAllocator()
+            {
+                return m_stickAllocator;
+            }
+
+            //number of allocations served from the pool and by malloc
+            stick::Size pooledCount() const
+            {
+                return m_pooledCount;
+            }
+
+            stick::Size mallocCount() const
+            {
+                return m_mallocCount;
+            }
+
+            void setBudget(stick::Size _budget)
+            {
+                m_budget = _budget;
+            }
+
+            stick::Size budget() const
+            {
+                return m_budget;
+            }
+
+            //bytes lua currently has allocated, without the pool's own overhead
+            stick::Size currentBytes() const
+            {
+                return m_currentBytes;
+            }
+
+            stick::Size peakBytes() const
+            {
+                return m_peakBytes;
+            }
+
+            void resetPeakBytes()
+            {
+                m_peakBytes = m_currentBytes;
+            }
+
+        private:
+
+            struct FreeBlock
+            {
+                FreeBlock * next;
+            };
+
+            struct Page
+            {
+                Page * next;
+            };
+
+            //header in front of every block that is too large for the pool
+            struct LargeBlock
+            {
+                LargeBlock * prev;
+                LargeBlock * next;
+            };
+
+            static_assert(sizeof(LargeBlock) <= granularity, "the large block header has to fit into one granule");
+
+            //classCount for sizes that are not pooled
+            static stick::Size sizeClass(stick::Size _size)
+            {
+                if (_size == 0 || _size > maxPooledSize)
+                    return classCount;
+                return (_size - 1) / granularity;
+            }
+
+            void * resize(void * _ptr, stick::Size _oldSize, stick::Size _newSize)
+            {
+                //blocks that stay in the same size class (or outside the pool) don't move
+                if (_ptr && sizeClass(_oldSize) == sizeClass(_newSize))
+                {
+                    if (sizeClass(_newSize) < classCount)
+                        return _ptr;
+                    return resizeLarge(_ptr, _newSize);
+                }
+
+                void * ret = allocate(_newSize);
+                //lua expects shrinking to always work. The block is then released into the
+                //(smaller) size class lua will report for it, which is safe if wasteful.
+                if (!ret && _newSize <= _oldSize)
+                    return _ptr;
+                if (ret && _ptr)
+                {
+                    std::memcpy(ret, _ptr, _oldSize < _newSize ? _oldSize : _newSize);
+                    release(_ptr, _oldSize);
+                }
+                return ret;
+            }
+
+            void * allocate(stick::Size _size)
+            {
+                stick::Size cls = sizeClass(_size);
+                if (cls == classCount)
+                    return allocateLarge(_size);
+
+                if (!m_freeLists[cls] && !refill(cls))
+                    return nullptr;
+                FreeBlock * ret = m_freeLists[cls];
+                m_freeLists[cls] = ret->next;
+                ++m_pooledCount;
+                return ret;
+            }
+
+            void release(void * _ptr, stick::Size _size)
+            {
+                if (!_ptr)
+                    return;
+                stick::Size cls = sizeClass(_size);
+                if (cls == classCount)
+                {
+                    releaseLarge(_ptr);
+                    return;
+                }
+                FreeBlock * block = static_cast<FreeBlock *>(_ptr);
+                block->next = m_freeLists[cls];
+                m_freeLists[cls] = block;
+            }
+
+            void link(LargeBlock * _block)
+            {
+                _block->prev = nullptr;
+                _block->next = m_largeBlocks;
+                if (m_largeBlocks)
+                    m_largeBlocks->prev = _block;
+                m_largeBlocks = _block;
+            }
+
+            void unlink(LargeBlock * _block)
+            {
+                if (_block->prev)
+                    _block->prev->next = _block->next;
+                else
+                    m_largeBlocks = _block->next;
+                if (_block->next)
+                    _block->next->prev = _block->prev;
+            }
+
+            static LargeBlock * largeHeader(void * _ptr)
+            {
+                return reinterpret_cast<LargeBlock *>(static_cast<char *>(_ptr) - granularity);
+            }
+
+            void * allocateLarge(stick::Size _size)
+            {
+                LargeBlock * block = static_cast<LargeBlock *>(std::malloc(_size + granularity));
+                if (!block)
+                    return nullptr;
+                ++m_mallocCount;
+                link(block);
+                return reinterpret_cast<char *>(block) + granularity;
+            }
+
+            void * resizeLarge(void * _ptr, stick::Size _newSize)
+            {
+                LargeBlock * block = largeHeader(_ptr);
+                unlink(block);
+                LargeBlock * ret = static_cast<LargeBlock *>(std::realloc(block, _newSize + granularity));
+                if (!ret)
+                {
+                    link(block);
+                    return nullptr;
+                }
+                link(ret);
+                return reinterpret_cast<char *>(ret) + granularity;
+            }
+
+            void releaseLarge(void * _ptr)
+            {
+                LargeBlock * block = largeHeader(_ptr);
+                unlink(block);
+                std::free(block);
+            }
+
+            //carves a new page into blocks of size class _cls
+            bool refill(stick::Size _cls)
+            {
+                //the page header takes one block worth of space to keep the blocks aligned
+                Page * page = static_cast<Page *>(std::malloc(pageSize));
+                if (!page)
+                    return false;
+                page->next = m_pages;
+                m_pages = page;
+
+                stick::Size blockSize = (_cls + 1) * granularity;
+                char * begin = reinterpret_cast<char *>(page) + granularity;
+                char * end = reinterpret_cast<char *>(page) + pageSize;
+                for (char * block = begin; block + blockSize <= end; block += blockSize)
+                {
+                    FreeBlock * b = reinterpret_cast<FreeBlock *>(block);
+                    b->next = m_freeLists[_cls];
+                    m_freeLists[_cls] = b;
+                }
+                return true;
+            }
+
+            Page * m_pages;
+            LargeBlock * m_largeBlocks;
+            FreeBlock * m_freeLists[classCount];
+            stick::Size m_pooledCount;
+            stick::Size m_mallocCount;
+            stick::Size m_budget;
+            stick::Size m_currentBytes;
+            stick::Size m_peakBytes;
+            PooledStickAllocator m_stickAllocator;
+        };
+
+        inline stick::Block PooledStickAllocator::allocate(stick::Size _byteCount, stick::Size _alignment)
+        {
+            //pooled and large blocks are aligned to the granularity, the header keeps it
+            STICK_ASSERT(_alignment <= PoolAllocator::granularity);
+            (void)_alignment;
+            char * mem = static_cast<char *>(m_pool.allocateUnbudgeted(_byteCount + PoolAllocator::granularity));
+            if (!mem)
+                return {nullptr, 0};
+            std::memcpy(mem, &_byteCount, sizeof(_byteCount));
+            return {mem + PoolAllocator::granularity, _byteCount};
+        }
+
+        inline stick::Block PooledStickAllocator::reallocate(const stick::Block & _block, stick::Size _byteCount)
+        {
+            stick::Block ret = allocate(_byteCount, PoolAllocator::granularity);
+            if (ret.ptr && _block.ptr)
+            {
+                stick::Size oldCount;
+                std::memcpy(&oldCount, static_cast<char *>(_block.ptr) - PoolAllocator::granularity, sizeof(oldCount));
+                std::memcpy(ret.ptr, _block.ptr, std::min(oldCount, _byteCount));
+                deallocate(_block);
+            }
+            return ret;
+        }
+
+        inline void PooledStickAllocator::deallocate(const stick::Block & _block)
+        {
+            if (!_block.ptr)
+                return;
+            char * mem = static_cast<char *>(_block.ptr) - PoolAllocator::granularity;
+            stick::Size byteCount;
+            std::memcpy(&byteCount, mem, sizeof(byteCount));
+            m_pool.releaseUnbudgeted(mem, byteCount + PoolAllocator::granularity);
+        }
+
+        inline void * luaPoolAlloc(void * _ud, void * _ptr, size_t _osize, size_t _nsize)
+        {
+            return static_cast<PoolAllocator *>(_ud)->reallocate(_ptr, _osize, _nsize);
+        }
+
+        inline stick::Int32 luaPoolPanic(lua_State * _state)
+        {
+            fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(_state, -1));
+            return 0;
+        }
+
+        //the PoolAllocator of _state, or nullptr if it was not created by createPooledLuaState
+        inline PoolAllocator * luaPoolAllocator(lua_State * _state)
+        {
+            void * ud;
+            if (lua_getallocf(_state, &ud) != luaPoolAlloc)
+                return nullptr;
+            return static_cast<PoolAllocator *>(ud);
+        }
+
+        //allocator for what the bindings keep around for _state: the stick allocator of its
+        //pool if it has one, the default allocator otherwise
+        inline stick::Allocator & luaAllocator(lua_State * _state)
+        {
+            PoolAllocator * pool = luaPoolAllocator(_state);
+            return pool ? pool->stickAllocator() : stick::defaultAllocator();
+        }
+
+        //true if the pool of _state is above its budget. Allocations through luaAllocator don't
+        //fail, so the bindings check this after building something and raise a memory error.
+        inline bool luaOverBudget(lua_State * _state)
+        {
+            PoolAllocator * pool = luaPoolAllocator(_state);
+            return pool && pool->overBudget();
+        }
+    }
+
+    //Creates a lua_State that allocates through a detail::PoolAllocator. It has to be closed
+    //with closePooledLuaState, which also frees the pool. If _budget is not 0, allocations
+    //that would take the state above _budget bytes fail with a lua memory error.
+    inline lua_State * createPooledLuaState(stick::Size _budget = 0)
+    {
+        detail::PoolAllocator * pool = new detail::PoolAllocator(_budget);
+        lua_State * ret = lua_newstate(detail::luaPoolAlloc, pool);
+        if (!ret)
+        {
+            delete pool;
+            return nullptr;
+        }
+        lua_atpanic(ret, detail::luaPoolPanic);
+        return ret;
+    }
+
+    inline void closePooledLuaState(lua_State * _state)
+    {
+        void * pool;
+        lua_getallocf(_state, &pool);
+        lua_close(_state);
+        delete static_cast<detail::PoolAllocator *>(pool);
+    }
+}
+
+#endif //PAPERLUA_POOLALLOCATOR_HPP
@@ -0,0 +1,791 @@
+#ifndef PAPERLUA_SVGSTREAM_HPP
+#define PAPERLUA_SVGSTREAM_HPP
+
+#include <Paper2/Document.hpp>
+#include <Paper2/Group.hpp>
+#include <Paper2/Path.hpp>
+#include <Stick/DynamicArray.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+#include <unistd.h>
+
+namespace paperLua
+{
+    namespace detail
+    {
+        using namespace paper;
+
+        //svg text that is still being assembled
+        using SVGText = stick::DynamicArray<char>;
+
+        inline void appendText(SVGText & _out, const char * _data, Size _count)
+        {
+            if (!_count)
+                return;
+            Size offset = _out.count();
+            _out.resize(offset + _count);
+            std::memcpy(&_out[offset], _data, _count);
+        }
+
+        inline void appendText(SVGText & _out, const char * _str)
+        {
+            appendText(_out, _str, std::strlen(_str));
+        }
+
+        inline void appendText(SVGText & _out, const SVGText & _text)
+        {
+            appendText(_out, _text.count() ? &_text[0] : nullptr, _text.count());
+        }
+
+        inline void appendText(SVGText & _out, char _c)
+        {
+            _out.append(_c);
+        }
+
+        //Buffers the svg text and hands it to the sink in chunks of roughly _chunkSize bytes.
+        //The sink returns false to abort the export.
+        class SVGOutput
+        {
+        public:
+
+            using Sink = std::function<bool(const char *, Size)>;
+
+            SVGOutput(Sink _sink, Size _chunkSize) :
+                m_sink(_sink),
+                m_chunkSize(std::max(_chunkSize, (Size)1)),
+                m_bFailed(false),
+                m_byteCount(0)
+            {
+                m_buffer.reserve(m_chunkSize);
+            }
+
+            void write(const char * _data, Size _count)
+            {
+                appendText(m_buffer, _data, _count);
+                if (m_buffer.count() >= m_chunkSize)
+                    flush();
+            }
+
+            void write(const SVGText & _text)
+            {
+                write(_text.count() ? &_text[0] : nullptr, _text.count());
+            }
+
+            void flush()
+            {
+                if (m_buffer.count() && !m_bFailed)
+                {
+                    m_byteCount += m_buffer.count();
+                    m_bFailed = !m_sink(&m_buffer[0], m_buffer.count());
+                }
+                m_buffer.clear();
+            }
+
+            bool failed() const
+            {
+                return m_bFailed;
+            }
+
+            Size byteCount() const
+            {
+                return m_byteCount;
+            }
+
+        private:
+
+            Sink m_sink;
+            Size m_chunkSize;
+            SVGText m_buffer;
+            bool m_bFailed;
+            Size m_byteCount;
+        };
+
+        //writes all of _data to the file descriptor _fd, retrying on partial writes
+        inline bool writeToFileDescriptor(Int32 _fd, const char * _data, Size _count)
+        {
+            while (_count)
+            {
+                ssize_t written = ::write(_fd, _data, _count);
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    return false;
+                }
+                _data += written;
+                _count -= written;
+            }
+            return true;
+        }
+
+        struct FNVHash
+        {
+            FNVHash() :
+                value(14695981039346656037ULL)
+            {
+            }
+
+            void mixBytes(const void * _data, Size _byteCount)
+            {
+                const stick::UInt8 * bytes = static_cast<const stick::UInt8 *>(_data);
+                for (Size i = 0; i < _byteCount; ++i)
+                {
+                    value ^= bytes[i];
+                    value *= 1099511628211ULL;
+                }
+            }
+
+            template<class T>
+            void mix(const T & _value)
+            {
+                mixBytes(&_value, sizeof(T));
+            }
+
+            stick::UInt64 value;
+        };
+
+        //Serialized fragments of the items of one document from the last incremental export.
+        //An item is serialized again if the fingerprint of everything that ends up in its
+        //fragment changed. Entries of items that were not part of the last export are dropped.
+        //The fragments of the last export and of the running one live in two sets of arrays
+        //that swap roles at the end of an export: reused text is copied over from the last
+        //export, which is what the output needs to be written from anyway, and the fragments
+        //are sorted by item once per export for the lookups of the next one.
+        class SVGFragmentCache
+        {
+        public:
+
+            //the fragments and their text are allocated with _alloc
+            explicit SVGFragmentCache(stick::Allocator & _alloc = stick::defaultAllocator()) :
+                m_fragments{FragmentArray(_alloc), FragmentArray(_alloc)},
+                m_texts{SVGText(_alloc), SVGText(_alloc)},
+                m_last(0),
+                m_nextId(0),
+                m_reusedCount(0),
+                m_serializedCount(0)
+            {
+            }
+
+            void beginExport()
+            {
+                m_fragments[1 - m_last].clear();
+                m_texts[1 - m_last].clear();
+                m_reusedCount = 0;
+                m_serializedCount = 0;
+            }
+
+            void endExport()
+            {
+                FragmentArray & current = m_fragments[1 - m_last];
+                std::sort(current.begin(), current.end(), compareFragments);
+                m_last = 1 - m_last;
+            }
+
+            //returns the text of the fragment of _item from the last export if its fingerprint
+            //matches, nullptr otherwise. _outCount receives its length. The text stays valid
+            //until the next call.
+            const char * find(const Item * _item, stick::UInt64 _fingerprint, Size & _outCount)
+            {
+                const FragmentArray & last = m_fragments[m_last];
+                Fragment key = {_item, 0, 0, 0};
+                auto it = std::lower_bound(last.begin(), last.end(), key, compareFragments);
+                if (it == last.end() || it->item != _item || it->fingerprint != _fingerprint)
+                    return nullptr;
+                ++m_reusedCount;
+                return add(_item, _fingerprint, &m_texts[m_last][it->offset], it->count, _outCount);
+            }
+
+            const char * store(const Item * _item, stick::UInt64 _fingerprint, const SVGText & _text, Size & _outCount)
+            {
+                ++m_serializedCount;
+                return add(_item, _fingerprint, _text.count() ? &_text[0] : nullptr, _text.count(), _outCount);
+            }
+
+            //ids of gradients and clip paths written into fragments. They keep counting across
+            //exports, so a newly serialized fragment never reuses the id of a cached one.
+            Size nextId()
+            {
+                return m_nextId++;
+            }
+
+            Size reusedCount() const
+            {
+                return m_reusedCount;
+            }
+
+            Size serializedCount() const
+            {
+                return m_serializedCount;
+            }
+
+        private:
+
+            struct Fragment
+            {
+                const Item * item;
+                stick::UInt64 fingerprint;
+                //range in the text array of the same export. For paths the whole element, for
+                //groups only the opening tag.
+                Size offset;
+                Size count;
+            };
+
+            using FragmentArray = stick::DynamicArray<Fragment>;
+
+            static bool compareFragments(const Fragment & _a, const Fragment & _b)
+            {
+                return std::less<const Item *>()(_a.item, _b.item);
+            }
+
+            const char * add(const Item * _item, stick::UInt64 _fingerprint, const char * _data, Size _count, Size & _outCount)
+            {
+                SVGText & text = m_texts[1 - m_last];
+                Fragment frag = {_item, _fingerprint, text.count(), _count};
+                m_fragments[1 - m_last].append(frag);
+                appendText(text, _data, _count);
+                _outCount = _count;
+                return _count ? &text[frag.offset] : "";
+            }
+
+            FragmentArray m_fragments[2];
+            SVGText m_texts[2];
+            //index of the arrays holding the last complete export
+            Size m_last;
+            Size m_nextId;
+            Size m_reusedCount;
+            Size m_serializedCount;
+        };
+
+        //Streams the svg representation of a document to an SVGOutput without building the
+        //whole string. With a fragment cache, only items whose fingerprint changed since the last
+        //export with the same cache are serialized, all others are copied from the cache.
+        class SVGStreamWriter
+        {
+        public:
+
+            SVGStreamWriter(SVGOutput & _output, SVGFragmentCache * _cache) :
+                m_output(_output),
+                m_cache(_cache),
+                m_bFinished(false),
+                m_nextId(0)
+            {
+            }
+
+            //writes _item, or all children of it if it is a document, into an svg element of
+            //the size of the document.
+            bool write(Item * _item)
+            {
+                begin(_item);
+                while (step()) {}
+                return !m_output.failed();
+            }
+
+            //Incremental form of write: begin writes the svg header, every call to step writes
+            //one more item and returns false once the svg is complete. The item tree must not
+            //change in between.
+            void begin(Item * _item)
+            {
+                if (m_cache)
+                    m_cache->beginExport();
+
+                m_stack.clear();
+                m_bFinished = false;
+                m_nextId = 0;
+
+                Document * document = _item->itemType() == ItemType::Document ?
+                                      static_cast<Document *>(_item) : _item->document();
+                SVGText header;
+                appendText(header, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                   "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\"");
+                appendAttribute(header, "width", document->width());
+                appendAttribute(header, "height", document->height());
+                appendText(header, ">\n");
+                m_output.write(header);
+
+                if (_item == document)
+                    pushChildren(_item, false, false);
+                else
+                    writeItem(_item);
+            }
+
+            bool step()
+            {
+                while (m_stack.count() && !m_output.failed())
+                {
+                    Frame & top = m_stack[m_stack.count() - 1];
+                    if (top.it == top.end)
+                    {
+                        if (top.bGroup)
+                            m_output.write("</g>\n", 5);
+                        m_stack.resize(m_stack.count() - 1);
+                        continue;
+                    }
+                    Item * child = *top.it;
+                    ++top.it;
+                    //may push a frame and invalidate top
+                    writeItem(child);
+                    return true;
+                }
+
+                if (!m_bFinished)
+                {
+                    m_bFinished = true;
+                    m_output.write("</svg>\n", 7);
+                    m_output.flush();
+                    if (m_cache)
+                        m_cache->endExport();
+                }
+                return false;
+            }
+
+        private:
+
+            using ChildIterator = decltype(std::declval<Item &>().children().begin());
+
+            //children of an item that still need to be written
+            struct Frame
+            {
+                ChildIterator it;
+                ChildIterator end;
+                //close the group element once all children are written
+                bool bGroup;
+            };
+
+            //_bSkipMask skips the first child, the clipping mask of a clipped group
+            void pushChildren(Item * _item, bool _bSkipMask, bool _bGroup)
+            {
+                Frame frame = {_item->children().begin(), _item->children().end(), _bGroup};
+                if (_bSkipMask && frame.it != frame.end)
+                    ++frame.it;
+                m_stack.append(frame);
+            }
+
+            //writes a path, or the opening tag of a group and schedules its children
+            void writeItem(Item * _item)
+            {
+                if (!_item->isVisible())
+                    return;
+
+                bool bGroup = _item->itemType() == ItemType::Group;
+                if (!bGroup && _item->itemType() != ItemType::Path)
+                    return;
+
+                const char * cached = nullptr;
+                Size cachedCount = 0;
+                stick::UInt64 fingerprint = 0;
+                if (m_cache)
+                {
+                    fingerprint = bGroup ? groupFingerprint(static_cast<Group *>(_item)) :
+                                  pathFingerprint(static_cast<Path *>(_item));
+                    cached = m_cache->find(_item, fingerprint, cachedCount);
+                }
+
+                if (!cached)
+                {
+                    m_scratch.clear();
+                    Size id = m_cache ? m_cache->nextId() : m_nextId++;
+                    if (bGroup)
+                        serializeGroupOpening(static_cast<Group *>(_item), id, m_scratch);
+                    else
+                        serializePath(static_cast<Path *>(_item), id, m_scratch);
+                    if (m_cache)
+                        cached = m_cache->store(_item, fingerprint, m_scratch, cachedCount);
+                    else
+                        m_output.write(m_scratch);
+                }
+
+                if (cached)
+                    m_output.write(cached, cachedCount);
+                if (bGroup)
+                {
+                    Group * group = static_cast<Group *>(_item);
+                    pushChildren(group, group->isClipped(), true);
+                }
+            }
+
+            static void appendNumber(SVGText & _out, Float _value)
+            {
+                char buf[32];
+                Int32 count = snprintf(buf, sizeof(buf), "%.9g", (double)_value);
+                appendText(_out, buf, count);
+            }
+
+            static void appendPoint(SVGText & _out, const Vec2f & _point)
+            {
+                appendNumber(_out, _point.x);
+                appendText(_out, ' ');
+                appendNumber(_out, _point.y);
+            }
+
+            static void appendAttribute(SVGText & _out, const char * _name, Float _value)
+            {
+                appendText(_out, ' ');
+                appendText(_out, _name);
+                appendText(_out, "=\"");
+                appendNumber(_out, _value);
+                appendText(_out, '"');
+            }
+
+            static void appendAttribute(SVGText & _out, const char * _name, const char * _value)
+            {
+                appendText(_out, ' ');
+                appendText(_out, _name);
+                appendText(_out, "=\"");
+                appendText(_out, _value);
+                appendText(_out, '"');
+            }
+
+            //ids are counted per fragment, the prefix tells the elements of one fragment apart
+            static void appendId(SVGText & _out, const char * _prefix, Size _id)
+            {
+                char buf[48];
+                snprintf(buf, sizeof(buf), "%s%lu", _prefix, (unsigned long)_id);
+                appendText(_out, buf);
+            }
+
+            static void appendTransform(SVGText & _out, const Mat32f & _transform, const char * _name = "transform")
+            {
+                if (_transform == Mat32f::identity())
+                    return;
+                appendText(_out, ' ');
+                appendText(_out, _name);
+                appendText(_out, "=\"matrix(");
+                appendPoint(_out, _transform[0]);
+                appendText(_out, ' ');
+                appendPoint(_out, _transform[1]);
+                appendText(_out, ' ');
+                appendPoint(_out, _transform[2]);
+                appendText(_out, ")\"");
+            }
+
+            static void appendPathData(SVGText & _out, Path * _path)
+            {
+                Size count = _path->segmentCount();
+                if (!count)
+                    return;
+
+                auto curveTo = [&_out](const Segment & _a, const Segment & _b)
+                {
+                    if (_a.handleOut() == Vec2f(0, 0) && _b.handleIn() == Vec2f(0, 0))
+                    {
+                        appendText(_out, 'L');
+                        appendPoint(_out, _b.position());
+                    }
+                    else
+                    {
+                        appendText(_out, 'C');
+                        appendPoint(_out, _a.position() + _a.handleOut());
+                        appendText(_out, ' ');
+                        appendPoint(_out, _b.position() + _b.handleIn());
+                        appendText(_out, ' ');
+                        appendPoint(_out, _b.position());
+                    }
+                };
+
+                appendText(_out, " d=\"M");
+                Segment first = _path->segment(0);
+                appendPoint(_out, first.position());
+                for (Size i = 1; i < count; ++i)
+                    curveTo(_path->segment(i - 1), _path->segment(i));
+                if (_path->isClosed())
+                {
+                    if (count > 1)
+                        curveTo(_path->segment(count - 1), first);
+                    appendText(_out, 'Z');
+                }
+                appendText(_out, '"');
+            }
+
+            static void appendColor(SVGText & _out, const char * _name, const ColorRGBA & _color)
+            {
+                char buf[96];
+                snprintf(buf, sizeof(buf), " %s=\"rgb(%d,%d,%d)\"", _name,
+                         (Int32)(_color.r * 255 + 0.5f), (Int32)(_color.g * 255 + 0.5f), (Int32)(_color.b * 255 + 0.5f));
+                appendText(_out, buf);
+                if (_color.a < 1)
+                {
+                    snprintf(buf, sizeof(buf), " %s-opacity=\"%.9g\"", _name, (double)_color.a);
+                    appendText(_out, buf);
+                }
+            }
+
+            //gradients are written into the fragment of the item using them, with the id of that
+            //fragment, so fragments don't depend on each other.
+            static void appendGradient(SVGText & _defs, SVGText & _attributes, const char * _name,
+                                       const char * _idPrefix, Size _id, BaseGradient * _gradient, bool _bRadial)
+            {
+                Vec2f origin = _gradient->origin();
+                Vec2f destination = _gradient->destination();
+                appendText(_defs, _bRadial ? "<radialGradient id=\"" : "<linearGradient id=\"");
+                appendId(_defs, _idPrefix, _id);
+                appendText(_defs, "\" gradientUnits=\"userSpaceOnUse\"");
+                if (_bRadial)
+                {
+                    RadialGradient * radial = static_cast<RadialGradient *>(_gradient);
+                    Vec2f focal = origin + radial->focalPointOffset();
+                    //the gradient is an ellipse whose minor radius is ratio times the distance
+                    //from origin to destination. svg only knows circles, so the circle is
+                    //squashed along the minor axis by the gradient transform and the focal
+                    //point is moved into the unsquashed space.
+                    Float ratio = radial->ratio();
+                    Vec2f dir = destination - origin;
+                    Float radius = crunch::length(dir);
+                    if (ratio > 0 && ratio != 1 && radius > 0)
+                    {
+                        Float c = dir.x / radius;
+                        Float s = dir.y / radius;
+                        Vec2f rel = focal - origin;
+                        focal = origin + Vec2f(c * rel.x + s * rel.y, (c * rel.y - s * rel.x) / ratio);
+                        Mat32f transform = Mat32f::identity();
+                        transform[0] = Vec2f(c, s);
+                        transform[1] = Vec2f(-s * ratio, c * ratio);
+                        transform[2] = origin - transform[0] * origin.x - transform[1] * origin.y;
+                        appendTransform(_defs, transform, "gradientTransform");
+                    }
+                    appendAttribute(_defs, "cx", origin.x);
+                    appendAttribute(_defs, "cy", origin.y);
+                    appendAttribute(_defs, "r", radius);
+                    appendAttribute(_defs, "fx", focal.x);
+                    appendAttribute(_defs, "fy", focal.y);
+                }
+                else
+                {
+                    appendAttribute(_defs, "x1", origin.x);
+                    appendAttribute(_defs, "y1", origin.y);
+                    appendAttribute(_defs, "x2", destination.x);
+                    appendAttribute(_defs, "y2", destination.y);
+                }
+                appendText(_defs, ">\n");
+                for (const ColorStop & stop : _gradient->stops())
+                {
+                    appendText(_defs, "<stop");
+                    appendAttribute(_defs, "offset", stop.offset);
+                    appendColor(_defs, "stop-color", stop.color);
+                    appendText(_defs, "/>\n");
+                }
+                appendText(_defs, _bRadial ? "</radialGradient>\n" : "</linearGradient>\n");
+
+                appendText(_attributes, ' ');
+                appendText(_attributes, _name);
+                appendText(_attributes, "=\"url(#");
+                appendId(_attributes, _idPrefix, _id);
+                appendText(_attributes, ")\"");
+            }
+
+            static void appendPaint(SVGText & _defs, SVGText & _attributes, const char * _name,
+                                    const char * _idPrefix, Size _id, const Paint & _paint)
+            {
+                if (_paint.is<ColorRGBA>())
+                    appendColor(_attributes, _name, _paint.get<ColorRGBA>());
+                else if (_paint.is<LinearGradientPtr>())
+                    appendGradient(_defs, _attributes, _name, _idPrefix, _id, _paint.get<LinearGradientPtr>().get(), false);
+                else if (_paint.is<RadialGradientPtr>())
+                    appendGradient(_defs, _attributes, _name, _idPrefix, _id, _paint.get<RadialGradientPtr>().get(), true);
+                else
+                    appendAttribute(_attributes, _name, "none");
+            }
+
+            static void serializePath(Path * _path, Size _id, SVGText & _out)
+            {
+                SVGText defs;
+                SVGText attributes;
+                appendTransform(attributes, _path->transform());
+                appendPathData(attributes, _path);
+
+                if (_path->hasFill())
+                    appendPaint(defs, attributes, "fill", "f", _id, _path->fill());
+                else
+                    appendAttribute(attributes, "fill", "none");
+                if (_path->windingRule() == WindingRule::EvenOdd)
+                    appendAttribute(attributes, "fill-rule", "evenodd");
+
+                if (_path->hasStroke())
+                {
+                    appendPaint(defs, attributes, "stroke", "s", _id, _path->stroke());
+                    appendAttribute(attributes, "stroke-width", _path->strokeWidth());
+                    StrokeJoin join = _path->strokeJoin();
+                    appendAttribute(attributes, "stroke-linejoin", join == StrokeJoin::Round ? "round" :
+                                    join == StrokeJoin::Bevel ? "bevel" : "miter");
+                    StrokeCap cap = _path->strokeCap();
+                    appendAttribute(attributes, "stroke-linecap", cap == StrokeCap::Round ? "round" :
+                                    cap == StrokeCap::Square ? "square" : "butt");
+                    appendAttribute(attributes, "stroke-miterlimit", _path->miterLimit());
+                    const auto & dashes = _path->dashArray();
+                    if (dashes.count())
+                    {
+                        appendText(attributes, " stroke-dasharray=\"");
+                        for (Size i = 0; i < dashes.count(); ++i)
+                        {
+                            if (i)
+                                appendText(attributes, ',');
+                            appendNumber(attributes, dashes[i]);
+                        }
+                        appendText(attributes, '"');
+                        appendAttribute(attributes, "stroke-dashoffset", _path->dashOffset());
+                    }
+                    if (!_path->scaleStroke())
+                        appendAttribute(attributes, "vector-effect", "non-scaling-stroke");
+                }
+
+                if (defs.count())
+                {
+                    appendText(_out, "<defs>\n");
+                    appendText(_out, defs);
+                    appendText(_out, "</defs>\n");
+                }
+                appendText(_out, "<path");
+                appendText(_out, attributes);
+                appendText(_out, "/>\n");
+            }
+
+            //the first child of a clipped group is its clipping mask
+            static void serializeGroupOpening(Group * _group, Size _id, SVGText & _out)
+            {
+                Item * mask = nullptr;
+                if (_group->isClipped())
+                {
+                    for (Item * child : _group->children())
+                    {
+                        mask = child;
+                        break;
+                    }
+                }
+
+                if (mask && mask->itemType() == ItemType::Path)
+                {
+                    appendText(_out, "<defs>\n<clipPath id=\"");
+                    appendId(_out, "c", _id);
+                    appendText(_out, "\">\n<path");
+                    appendTransform(_out, mask->transform());
+                    appendPathData(_out, static_cast<Path *>(mask));
+                    appendText(_out, "/>\n</clipPath>\n</defs>\n");
+                }
+
+                appendText(_out, "<g");
+                appendTransform(_out, _group->transform());
+                if (mask && mask->itemType() == ItemType::Path)
+                {
+                    appendText(_out, " clip-path=\"url(#");
+                    appendId(_out, "c", _id);
+                    appendText(_out, ")\"");
+                }
+                appendText(_out, ">\n");
+            }
+
+            static void mixPaint(FNVHash & _hash, const Paint & _paint)
+            {
+                BaseGradient * gradient = nullptr;
+                if (_paint.is<ColorRGBA>())
+                {
+                    _hash.mix((Int32)1);
+                    _hash.mix(_paint.get<ColorRGBA>());
+                }
+                else if (_paint.is<LinearGradientPtr>())
+                {
+                    _hash.mix((Int32)2);
+                    gradient = _paint.get<LinearGradientPtr>().get();
+                }
+                else if (_paint.is<RadialGradientPtr>())
+                {
+                    RadialGradient * radial = _paint.get<RadialGradientPtr>().get();
+                    _hash.mix((Int32)3);
+                    _hash.mix(radial->focalPointOffset());
+                    _hash.mix(radial->ratio());
+                    gradient = radial;
+                }
+                else
+                    _hash.mix((Int32)0);
+
+                if (gradient)
+                {
+                    _hash.mix(gradient->origin());
+                    _hash.mix(gradient->destination());
+                    for (const ColorStop & stop : gradient->stops())
+                    {
+                        _hash.mix(stop.color);
+                        _hash.mix(stop.offset);
+                    }
+                }
+            }
+
+            static void mixPathData(FNVHash & _hash, Path * _path)
+            {
+                _hash.mix(_path->isClosed());
+                Size count = _path->segmentCount();
+                _hash.mix(count);
+                for (Size i = 0; i < count; ++i)
+                {
+                    Segment seg = _path->segment(i);
+                    _hash.mix(seg.position());
+                    _hash.mix(seg.handleIn());
+                    _hash.mix(seg.handleOut());
+                }
+            }
+
+            //covers everything serializePath writes
+            static stick::UInt64 pathFingerprint(Path * _path)
+            {
+                FNVHash hash;
+                hash.mix(_path->transform());
+                mixPathData(hash, _path);
+                hash.mix(_path->hasFill());
+                if (_path->hasFill())
+                    mixPaint(hash, _path->fill());
+                hash.mix(_path->windingRule());
+                hash.mix(_path->hasStroke());
+                if (_path->hasStroke())
+                {
+                    mixPaint(hash, _path->stroke());
+                    hash.mix(_path->strokeWidth());
+                    hash.mix(_path->strokeJoin());
+                    hash.mix(_path->strokeCap());
+                    hash.mix(_path->miterLimit());
+                    hash.mix(_path->dashOffset());
+                    hash.mix(_path->scaleStroke());
+                    for (Float dash : _path->dashArray())
+                        hash.mix(dash);
+                }
+                return hash.value;
+            }
+
+            //covers everything serializeGroupOpening writes, the children are cached separately
+            static stick::UInt64 groupFingerprint(Group * _group)
+            {
+                FNVHash hash;
+                hash.mix(_group->transform());
+                hash.mix(_group->isClipped());
+                if (_group->isClipped())
+                {
+                    for (Item * child : _group->children())
+                    {
+                        hash.mix(child);
+                        if (child->itemType() == ItemType::Path)
+                        {
+                            hash.mix(child->transform());
+                            mixPathData(hash, static_cast<Path *>(child));
+                        }
+                        break;
+                    }
+                }
+                return hash.value;
+            }
+
+            SVGOutput & m_output;
+            SVGFragmentCache * m_cache;
+            stick::DynamicArray<Frame> m_stack;
+            //text of the item being serialized, reused for every item
+            SVGText m_scratch;
+            bool m_bFinished;
+            //ids of fragments serialized without a cache
+            Size m_nextId;
+        };
+    }
+}
+
+#endif //PAPERLUA_SVGSTREAM_HPP
@@ -0,0 +1,225 @@
+#ifndef PAPERLUA_SCRIPTRUNNER_HPP
+#define PAPERLUA_SCRIPTRUNNER_HPP
+
+#include <Paper2Lua/Paper2Lua.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Thread safety of the bindings:
+//Everything registerPaper creates lives in the lua_State it is called with. The only process
+//wide state is the set of prebuilt class wrappers (see detail::classWrappers), which is built
+//once in a thread safe function local static and only read afterwards, and the addresses of
+//static keys used to find per state data in the registry. Per state caches (curve and item
+//indices) are owned by the lua_State. So registerPaper can run on many lua_States on different
+//threads at once, as long as every lua_State and every Document (including all of its items) is
+//only used by one thread at a time.
+
+namespace paperLua
+{
+    struct ScriptJob
+    {
+        //lua source of the job. It runs in its own environment that falls back to the globals
+        //and has two extra fields: document, an empty Document owned by the worker, and input.
+        stick::String chunk;
+        //name of the chunk used in error messages
+        stick::String name;
+        stick::String input;
+    };
+
+    struct ScriptResult
+    {
+        ScriptResult() :
+            bSuccess(false)
+        {
+        }
+
+        bool bSuccess;
+        //the value returned by the chunk converted with tostring, empty if it returned nil
+        stick::String output;
+        stick::String error;
+    };
+
+    //Pool of worker threads that run independent lua jobs. Every worker owns a lua_State with
+    //paper registered and a Document that is cleared before each job. Jobs are handed out one
+    //by one, so a few long jobs don't hold up the rest of the batch.
+    class ScriptRunner
+    {
+    public:
+
+        //called on each worker thread after paper was registered, i.e. to register additional
+        //bindings with the worker's lua_State.
+        using SetupFunction = std::function<void(lua_State *)>;
+
+        explicit ScriptRunner(stick::Size _threadCount = detail::hardwareThreadCount(),
+                              SetupFunction _setup = SetupFunction(),
+                              const stick::String & _namespace = "paper") :
+            m_setup(_setup),
+            m_namespace(_namespace),
+            m_jobs(nullptr),
+            m_results(nullptr),
+            m_next(0),
+            m_activeWorkers(0),
+            m_generation(0),
+            m_bShutdown(false)
+        {
+            _threadCount = std::max(_threadCount, (stick::Size)1);
+            m_threads.reserve(_threadCount);
+            for (stick::Size i = 0; i < _threadCount; ++i)
+                m_threads.emplace_back(&ScriptRunner::workerMain, this);
+        }
+
+        ~ScriptRunner()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_bShutdown = true;
+            }
+            m_wake.notify_all();
+            for (auto & t : m_threads)
+                t.join();
+        }
+
+        ScriptRunner(const ScriptRunner &) = delete;
+        ScriptRunner & operator = (const ScriptRunner &) = delete;
+
+        //runs all jobs and blocks until they are done. The results are in the order of _jobs.
+        //Must not be called from several threads at once.
+        stick::DynamicArray<ScriptResult> run(const stick::DynamicArray<ScriptJob> & _jobs)
+        {
+            stick::DynamicArray<ScriptResult> ret;
+            ret.resize(_jobs.count());
+            if (!_jobs.count())
+                return ret;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_jobs = &_jobs;
+                m_results = &ret[0];
+                m_next = 0;
+                m_activeWorkers = m_threads.size();
+                ++m_generation;
+            }
+            m_wake.notify_all();
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this]() { return m_activeWorkers == 0; });
+            m_jobs = nullptr;
+            m_results = nullptr;
+            return ret;
+        }
+
+        stick::Size threadCount() const
+        {
+            return m_threads.size();
+        }
+
+    private:
+
+        void workerMain()
+        {
+            lua_State * state = luanatic::createLuaState();
+            luanatic::openStandardLibraries(state);
+            luanatic::initialize(state);
+            registerPaper(state, m_namespace);
+            if (m_setup)
+                m_setup(state);
+
+            {
+                paper::Document document;
+                stick::UInt64 generation = 0;
+                for (;;)
+                {
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        m_wake.wait(lock, [&]() { return m_bShutdown || m_generation != generation; });
+                        if (m_bShutdown)
+                            break;
+                        generation = m_generation;
+                    }
+
+                    for (;;)
+                    {
+                        stick::Size index = m_next.fetch_add(1);
+                        if (index >= m_jobs->count())
+                            break;
+                        runJob(state, document, (*m_jobs)[index], m_results[index]);
+                    }
+
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (--m_activeWorkers == 0)
+                        m_done.notify_one();
+                }
+
+                //close the state before the document goes away, nothing may reference its items
+                lua_close(state);
+            }
+        }
+
+        static void runJob(lua_State * _state, paper::Document & _document, const ScriptJob & _job, ScriptResult & _outResult)
+        {
+            _document.removeChildren();
+
+            if (luaL_loadbuffer(_state, _job.chunk.cString(), _job.chunk.length(), _job.name.cString()))
+            {
+                _outResult.error = lua_tostring(_state, -1);
+                lua_settop(_state, 0);
+                return;
+            }
+
+            //fresh environment so globals set by one job are not visible to the next one
+            lua_newtable(_state);
+            lua_newtable(_state);
+            lua_pushglobaltable(_state);
+            lua_setfield(_state, -2, "__index");
+            lua_setmetatable(_state, -2);
+            luanatic::push<paper::Document>(_state, &_document, false);
+            lua_setfield(_state, -2, "document");
+            lua_pushlstring(_state, _job.input.cString(), _job.input.length());
+            lua_setfield(_state, -2, "input");
+#if LUA_VERSION_NUM >= 502
+            //the only upvalue of a main chunk is _ENV
+            lua_setupvalue(_state, -2, 1);
+#else
+            //5.1 and LuaJIT chunks have no _ENV upvalue, their environment is a field of the function
+            lua_setfenv(_state, -2);
+#endif
+
+            if (lua_pcall(_state, 0, 1, 0))
+            {
+                _outResult.error = lua_tostring(_state, -1);
+            }
+            else
+            {
+                _outResult.bSuccess = true;
+                if (!lua_isnil(_state, -1))
+                    _outResult.output = luaL_tolstring(_state, -1, nullptr);
+            }
+            lua_settop(_state, 0);
+
+            //drop all references to items of this job before the next one clears the document,
+            //so that no userdata of an old item is around when a new item reuses its address.
+            lua_gc(_state, LUA_GCCOLLECT, 0);
+        }
+
+        SetupFunction m_setup;
+        stick::String m_namespace;
+        std::vector<std::thread> m_threads;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        const stick::DynamicArray<ScriptJob> * m_jobs;
+        ScriptResult * m_results;
+        std::atomic<stick::Size> m_next;
+        stick::Size m_activeWorkers;
+        stick::UInt64 m_generation;
+        bool m_bShutdown;
+    };
+}
+
+#endif //PAPERLUA_SCRIPTRUNNER_HPP
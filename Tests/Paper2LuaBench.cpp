@@ -0,0 +1,484 @@
+#include <Paper2Lua/Paper2Lua.hpp>
+#include <CrunchLua/CrunchLua.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+//Microbenchmarks for the bindings.
+//
+//usage: Paper2LuaBench [--size N] [--repeat N] [--json file] [--baseline file]
+//                      [--write-baseline file] [--tolerance fraction] [--svg file]...
+//
+//Every benchmark runs in its own lua_State. The setup chunk builds a scene of the given size and
+//defines a global function run() which executes the workload once and returns how many binding
+//calls it made. run() is repeated and the fastest repetition is reported. If the setup chunk
+//defines a global function teardown(), it is called once at the end, i.e. to remove temporary
+//files. With --baseline, the results are compared against a file written by --write-baseline on
+//the same machine and the process fails if a benchmark got slower than the tolerance allows or
+//allocates more. If the baseline file does not exist, the comparison is skipped with a message.
+//Every --svg file (e.g. large maps or CAD exports) is loaded once with doc:loadSVG and the
+//mapping and parsing times are printed. They are not part of the baseline.
+
+using namespace stick;
+using namespace paperLua;
+using namespace luanatic;
+
+struct Benchmark
+{
+    const char * name;
+    const char * setup;
+    //policy paper gets registered with, checked unless specified
+    BindingPolicy policy;
+};
+
+static const Benchmark benchmarks[] =
+{
+    {
+        "segmentIteration",
+        "local doc = paper.Document()\n"
+        "local path = doc:createPath()\n"
+        "for i=1,size do path:addPoint(Vec2(i, math.sin(i))) end\n"
+        "function run()\n"
+        "    local x = 0\n"
+        "    for s in path:segments() do x = x + s:position().x end\n"
+        "    return path:segmentCount()\n"
+        "end\n"
+    },
+    {
+        "curvePositionAt",
+        "local doc = paper.Document()\n"
+        "local path = doc:createPath()\n"
+        "for i=1,size do path:addPoint(Vec2(i, math.sin(i))) end\n"
+        "path:smooth(paper.Smoothing.Continuous, false)\n"
+        "local curves = {}\n"
+        "for c in path:curves() do curves[#curves + 1] = c end\n"
+        "function run()\n"
+        "    for _, c in ipairs(curves) do c:positionAt(c:length() * 0.5) end\n"
+        "    return #curves * 2\n"
+        "end\n"
+    },
+    {
+        "snapshotPositionAt",
+        "local doc = paper.Document()\n"
+        "local path = doc:createPath()\n"
+        "for i=1,size do path:addPoint(Vec2(i, math.sin(i))) end\n"
+        "path:smooth(paper.Smoothing.Continuous, false)\n"
+        "local snap = path:snapshot()\n"
+        "local len = snap:length()\n"
+        "function run()\n"
+        "    for i=1,size do snap:positionAtXY(len * i / size) end\n"
+        "    return size\n"
+        "end\n"
+    },
+    {
+        "pathIntersections",
+        "local doc = paper.Document()\n"
+        "local a = doc:createPath()\n"
+        "local b = doc:createPath()\n"
+        "for i=1,size do\n"
+        "    a:addPoint(Vec2(i, (i % 2) * 10))\n"
+        "    b:addPoint(Vec2(i, ((i + 1) % 2) * 10))\n"
+        "end\n"
+        "function run()\n"
+        "    a:intersections(b)\n"
+        "    return 1\n"
+        "end\n"
+    },
+    {
+        "itemTransforms",
+        "local doc = paper.Document()\n"
+        "local items = {}\n"
+        "for i=1,size do items[i] = doc:createCircle(Vec2(i, i), 5) end\n"
+        "function run()\n"
+        "    for _, item in ipairs(items) do\n"
+        "        item:translate(Vec2(1, 0))\n"
+        "        item:rotate(0.01)\n"
+        "        item:scale(Vec2(1.001, 1.001))\n"
+        "    end\n"
+        "    return #items * 3\n"
+        "end\n"
+    },
+    {
+        "gradientSetup",
+        "local doc = paper.Document()\n"
+        "local items = {}\n"
+        "for i=1,size do items[i] = doc:createRectangle(Vec2(i, 0), Vec2(i + 10, 10)) end\n"
+        "function run()\n"
+        "    for i, item in ipairs(items) do\n"
+        "        local grad = paper.createLinearGradient(Vec2(i, 0), Vec2(i + 10, 0))\n"
+        "        grad:addStop(ColorRGBA(1, 0, 0, 1), 0)\n"
+        "        grad:addStop(ColorRGBA(0, 0, 1, 1), 1)\n"
+        "        item:setFill(grad)\n"
+        "    end\n"
+        "    return #items * 4\n"
+        "end\n"
+    },
+    {
+        "styleSetters",
+        "local doc = paper.Document()\n"
+        "local items = {}\n"
+        "for i=1,size do items[i] = doc:createCircle(Vec2(i, i), 5) end\n"
+        "function run()\n"
+        "    for _, item in ipairs(items) do\n"
+        "        item:setFill(ColorRGBA(1, 0, 0, 1))\n"
+        "        item:setStroke(ColorRGBA(0, 0, 0, 1))\n"
+        "        item:setStrokeWidth(2)\n"
+        "        item:setStrokeJoin(paper.StrokeJoin.Round)\n"
+        "        item:setMiterLimit(8)\n"
+        "    end\n"
+        "    return #items * 5\n"
+        "end\n"
+    },
+    {
+        //same styles as styleSetters in a single call
+        "applyStyle",
+        "local doc = paper.Document()\n"
+        "local items = {}\n"
+        "for i=1,size do items[i] = doc:createCircle(Vec2(i, i), 5) end\n"
+        "local style = {fill = ColorRGBA(1, 0, 0, 1), stroke = ColorRGBA(0, 0, 0, 1), strokeWidth = 2,\n"
+        "               strokeJoin = paper.StrokeJoin.Round, miterLimit = 8}\n"
+        "function run()\n"
+        "    paper.applyStyle(items, style)\n"
+        "    return 1\n"
+        "end\n"
+    },
+    {
+        "exportSVG",
+        "local doc = paper.Document()\n"
+        "for i=1,size do\n"
+        "    local c = doc:createCircle(Vec2(i % 1000, i / 1000), 5)\n"
+        "    c:setFill(ColorRGBA(1, 0, 0, 1))\n"
+        "end\n"
+        "function run()\n"
+        "    doc:exportSVG()\n"
+        "    return 1\n"
+        "end\n"
+    },
+    {
+        //map like scene, many long polylines
+        "svgImport",
+        "local doc = paper.Document()\n"
+        "for i=1,math.max(size / 100, 1) do\n"
+        "    local p = doc:createPath()\n"
+        "    for j=1,100 do p:addPoint(Vec2(j * 7, i * 3 + math.sin(j) * 2)) end\n"
+        "    p:setStroke(ColorRGBA(0, 0, 0, 1))\n"
+        "end\n"
+        "local svg = doc:exportSVG()\n"
+        "function run()\n"
+        "    local target = paper.Document()\n"
+        "    assert(target:parseSVG(svg))\n"
+        "    return 1\n"
+        "end\n"
+    },
+    {
+        //same scene as svgImport, loaded from the binary format
+        "binaryLoad",
+        "local doc = paper.Document()\n"
+        "for i=1,math.max(size / 100, 1) do\n"
+        "    local p = doc:createPath()\n"
+        "    for j=1,100 do p:addPoint(Vec2(j * 7, i * 3 + math.sin(j) * 2)) end\n"
+        "    p:setStroke(ColorRGBA(0, 0, 0, 1))\n"
+        "end\n"
+        "local name = os.tmpname()\n"
+        "assert(doc:saveBinary(name))\n"
+        "function run()\n"
+        "    assert(paper.Document.loadBinary(name))\n"
+        "    return 1\n"
+        "end\n"
+        "function teardown() os.remove(name) end\n"
+    },
+    {
+        //typed setters with the default checked bindings
+        "typedSetters",
+        "local doc = paper.Document()\n"
+        "local paths = {}\n"
+        "for i=1,size do paths[i] = doc:createPath() end\n"
+        "local color = ColorRGBA(1, 0, 0, 1)\n"
+        "function run()\n"
+        "    for i, p in ipairs(paths) do\n"
+        "        p:setFillColor(color)\n"
+        "        p:setStrokeWidth(i)\n"
+        "    end\n"
+        "    return #paths * 2\n"
+        "end\n"
+    },
+    {
+        //the same calls with BindingPolicy::Unchecked
+        "typedSettersUnchecked",
+        "local doc = paper.Document()\n"
+        "local paths = {}\n"
+        "for i=1,size do paths[i] = doc:createPath() end\n"
+        "local color = ColorRGBA(1, 0, 0, 1)\n"
+        "function run()\n"
+        "    for i, p in ipairs(paths) do\n"
+        "        p:setFillColor(color)\n"
+        "        p:setStrokeWidth(i)\n"
+        "    end\n"
+        "    return #paths * 2\n"
+        "end\n",
+        BindingPolicy::Unchecked
+    }
+};
+
+struct BenchAllocator
+{
+    lua_Alloc alloc;
+    void * userData;
+    Size allocations;
+    Size bytes;
+};
+
+static void * benchAlloc(void * _ud, void * _ptr, size_t _osize, size_t _nsize)
+{
+    BenchAllocator * a = static_cast<BenchAllocator *>(_ud);
+    size_t old = _ptr ? _osize : 0;
+    if (_nsize > old)
+    {
+        a->allocations++;
+        a->bytes += _nsize - old;
+    }
+    return a->alloc(a->userData, _ptr, _osize, _nsize);
+}
+
+struct BenchResult
+{
+    char name[64];
+    double nsPerCall;
+    double allocationsPerCall;
+    double gcBytesPerCall;
+};
+
+static bool runBenchmark(const Benchmark & _bench, Size _size, Size _repeat, BenchResult & _outResult)
+{
+    BenchAllocator allocator;
+    lua_State * state = createLuaState();
+    allocator.alloc = lua_getallocf(state, &allocator.userData);
+    lua_setallocf(state, benchAlloc, &allocator);
+
+    openStandardLibraries(state);
+    initialize(state);
+    crunchLua::registerCrunch(state);
+    if (_bench.policy == BindingPolicy::Unchecked)
+        registerPaper<BindingPolicy::Unchecked>(state, "paper");
+    else
+        registerPaper(state, "paper");
+    lua_pushnumber(state, (lua_Number)_size);
+    lua_setglobal(state, "size");
+
+    bool bOk = true;
+    auto err = luanatic::execute(state, _bench.setup);
+    if (err)
+    {
+        printf("%s: %s\n", _bench.name, err.message().cString());
+        bOk = false;
+    }
+
+    std::strncpy(_outResult.name, _bench.name, sizeof(_outResult.name) - 1);
+    _outResult.name[sizeof(_outResult.name) - 1] = 0;
+    _outResult.nsPerCall = 0;
+    _outResult.allocationsPerCall = 0;
+    _outResult.gcBytesPerCall = 0;
+
+    //one warm up run, then keep the fastest repetition
+    for (Size i = 0; bOk && i <= _repeat; ++i)
+    {
+        lua_gc(state, LUA_GCCOLLECT, 0);
+        lua_getglobal(state, "run");
+        allocator.allocations = 0;
+        allocator.bytes = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (lua_pcall(state, 0, 1, 0))
+        {
+            printf("%s: %s\n", _bench.name, lua_tostring(state, -1));
+            bOk = false;
+            break;
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+        double calls = std::max(lua_tonumber(state, -1), (lua_Number)1);
+        lua_pop(state, 1);
+
+        if (i == 0)
+            continue;
+        double ns = elapsed.count() / calls;
+        if (i == 1 || ns < _outResult.nsPerCall)
+            _outResult.nsPerCall = ns;
+        //allocations don't depend on timing, the last repetition is as good as any
+        _outResult.allocationsPerCall = allocator.allocations / calls;
+        _outResult.gcBytesPerCall = allocator.bytes / calls;
+    }
+
+    lua_getglobal(state, "teardown");
+    if (!lua_isfunction(state, -1))
+        lua_pop(state, 1);
+    else if (lua_pcall(state, 0, 0, 0))
+    {
+        printf("%s: %s\n", _bench.name, lua_tostring(state, -1));
+        lua_pop(state, 1);
+        bOk = false;
+    }
+
+    lua_close(state);
+    return bOk;
+}
+
+//loads a real world svg file and reports the time it took to map and to parse it
+static bool loadSVGFile(const char * _path)
+{
+    lua_State * state = createLuaState();
+    openStandardLibraries(state);
+    initialize(state);
+    registerPaper(state, "paper");
+    lua_pushstring(state, _path);
+    lua_setglobal(state, "fileName");
+
+    String loadChunk =
+    "local doc = paper.Document()\n"
+    "local group, stats = doc:loadSVG(fileName)\n"
+    "if not group then error(stats) end\n"
+    "print(string.format('%s: %.1f MB, map %.3f ms, copy %.3f ms, parse and build %.3f ms, %.1f MB/s', fileName,\n"
+    "      stats.bytes / 1e6, stats.mapTime * 1e3, stats.copyTime * 1e3, stats.parseTime * 1e3,\n"
+    "      stats.bytes / 1e6 / stats.parseTime))\n";
+    auto err = luanatic::execute(state, loadChunk);
+    if (err)
+        printf("%s\n", err.message().cString());
+    lua_close(state);
+    return !err;
+}
+
+static bool writeResults(const char * _path, const std::vector<BenchResult> & _results, Size _size)
+{
+    FILE * file = _path ? std::fopen(_path, "w") : stdout;
+    if (!file)
+    {
+        printf("could not open %s for writing\n", _path);
+        return false;
+    }
+
+    //one benchmark per line so readResults does not need a json parser
+    fprintf(file, "{\"size\":%lu,\"results\":[\n", (unsigned long)_size);
+    for (Size i = 0; i < _results.size(); ++i)
+    {
+        const BenchResult & r = _results[i];
+        fprintf(file, "{\"name\":\"%s\",\"nsPerCall\":%.3f,\"allocationsPerCall\":%.3f,\"gcBytesPerCall\":%.3f}%s\n",
+                r.name, r.nsPerCall, r.allocationsPerCall, r.gcBytesPerCall, i + 1 < _results.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+
+    if (_path)
+        std::fclose(file);
+    return true;
+}
+
+static bool readResults(const char * _path, std::vector<BenchResult> & _outResults, Size & _outSize)
+{
+    FILE * file = std::fopen(_path, "r");
+    if (!file)
+    {
+        printf("no baseline at %s, skipping the comparison. Record one with --write-baseline\n", _path);
+        return false;
+    }
+
+    char line[512];
+    unsigned long size = 0;
+    while (std::fgets(line, sizeof(line), file))
+    {
+        BenchResult r;
+        if (std::sscanf(line, "{\"size\":%lu", &size) == 1)
+            continue;
+        if (std::sscanf(line, "{\"name\":\"%63[^\"]\",\"nsPerCall\":%lf,\"allocationsPerCall\":%lf,\"gcBytesPerCall\":%lf}",
+                        r.name, &r.nsPerCall, &r.allocationsPerCall, &r.gcBytesPerCall) == 4)
+            _outResults.push_back(r);
+    }
+    std::fclose(file);
+    _outSize = size;
+    return true;
+}
+
+int main(int _argc, const char * _args[])
+{
+    Size size = 1000;
+    Size repeat = 5;
+    double tolerance = 0.25;
+    const char * jsonPath = nullptr;
+    const char * baselinePath = nullptr;
+    const char * writeBaselinePath = nullptr;
+    std::vector<const char *> svgFiles;
+
+    for (int i = 1; i < _argc; ++i)
+    {
+        bool bHasValue = i + 1 < _argc;
+        if (!std::strcmp(_args[i], "--size") && bHasValue)
+            size = std::strtoul(_args[++i], nullptr, 10);
+        else if (!std::strcmp(_args[i], "--repeat") && bHasValue)
+            repeat = std::max(std::strtoul(_args[++i], nullptr, 10), 1UL);
+        else if (!std::strcmp(_args[i], "--tolerance") && bHasValue)
+            tolerance = std::strtod(_args[++i], nullptr);
+        else if (!std::strcmp(_args[i], "--json") && bHasValue)
+            jsonPath = _args[++i];
+        else if (!std::strcmp(_args[i], "--baseline") && bHasValue)
+            baselinePath = _args[++i];
+        else if (!std::strcmp(_args[i], "--write-baseline") && bHasValue)
+            writeBaselinePath = _args[++i];
+        else if (!std::strcmp(_args[i], "--svg") && bHasValue)
+            svgFiles.push_back(_args[++i]);
+        else
+        {
+            printf("usage: %s [--size N] [--repeat N] [--json file] [--baseline file] [--write-baseline file] [--tolerance fraction] [--svg file]...\n", _args[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    bool bOk = true;
+    for (const Benchmark & bench : benchmarks)
+    {
+        BenchResult r;
+        bOk = runBenchmark(bench, size, repeat, r) && bOk;
+        printf("%-20s %12.1f ns/call %10.2f allocs/call %12.1f gc bytes/call\n",
+               r.name, r.nsPerCall, r.allocationsPerCall, r.gcBytesPerCall);
+        results.push_back(r);
+    }
+
+    for (const char * svgFile : svgFiles)
+        bOk = loadSVGFile(svgFile) && bOk;
+
+    if (jsonPath)
+        bOk = writeResults(jsonPath, results, size) && bOk;
+    if (writeBaselinePath)
+        bOk = writeResults(writeBaselinePath, results, size) && bOk;
+
+    if (baselinePath)
+    {
+        std::vector<BenchResult> baseline;
+        Size baselineSize;
+        if (!readResults(baselinePath, baseline, baselineSize))
+            return bOk ? EXIT_SUCCESS : EXIT_FAILURE;
+        if (baselineSize != size)
+            printf("warning: baseline was recorded with --size %lu\n", (unsigned long)baselineSize);
+
+        for (const BenchResult & r : results)
+        {
+            for (const BenchResult & b : baseline)
+            {
+                if (std::strcmp(r.name, b.name))
+                    continue;
+                if (r.nsPerCall > b.nsPerCall * (1 + tolerance))
+                {
+                    printf("REGRESSION %s: %.1f ns/call, baseline %.1f ns/call\n", r.name, r.nsPerCall, b.nsPerCall);
+                    bOk = false;
+                }
+                //allocations are deterministic, allow for rounding only
+                if (r.allocationsPerCall > b.allocationsPerCall + 0.01)
+                {
+                    printf("REGRESSION %s: %.2f allocs/call, baseline %.2f allocs/call\n", r.name, r.allocationsPerCall, b.allocationsPerCall);
+                    bOk = false;
+                }
+            }
+        }
+    }
+
+    return bOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,11 +1,47 @@
 #include <Stick/Test.hpp>
 #include <Paper2Lua/Paper2Lua.hpp>
+#include <Paper2Lua/PoolAllocator.hpp>
 #include <CrunchLua/CrunchLua.hpp>
 
+#include <chrono>
+
 using namespace stick;
 using namespace paperLua;
 using namespace luanatic;
 
+//wraps the allocator of a lua_State to count how many allocations it performs.
+struct AllocationCounter
+{
+    lua_Alloc alloc;
+    void * userData;
+    Size count;
+};
+
+static void * countingAlloc(void * _ud, void * _ptr, size_t _osize, size_t _nsize)
+{
+    AllocationCounter * counter = static_cast<AllocationCounter *>(_ud);
+    if (_nsize > (_ptr ? _osize : 0))
+        counter->count++;
+    return counter->alloc(counter->userData, _ptr, _osize, _nsize);
+}
+
+static Int32 luaAllocationCount(lua_State * _state)
+{
+    AllocationCounter * counter = static_cast<AllocationCounter *>(lua_touserdata(_state, lua_upvalueindex(1)));
+    lua_pushnumber(_state, counter->count);
+    return 1;
+}
+
+static void installAllocationCounter(lua_State * _state, AllocationCounter & _counter)
+{
+    _counter.alloc = lua_getallocf(_state, &_counter.userData);
+    _counter.count = 0;
+    lua_setallocf(_state, countingAlloc, &_counter);
+    lua_pushlightuserdata(_state, &_counter);
+    lua_pushcclosure(_state, luaAllocationCount, 1);
+    lua_setglobal(_state, "allocationCount");
+}
+
 const Suite spec[] =
 {
     SUITE("Namespacing Tests")
@@ -52,6 +88,1597 @@ const Suite spec[] =
         }
         lua_close(state);
     },
+    SUITE("Bulk Segment Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String bulkTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local path = doc:createPath()\n"
+            "local count = 10000\n"
+            "local positions = {}\n"
+            "for i=0,count - 1 do positions[#positions + 1] = i; positions[#positions + 1] = i * 2 end\n"
+            "path:setSegmentPositions(positions)\n"
+            "assert(path:segmentCount() == count)\n"
+            "assert(path:segment(10):position() == Vec2(10, 20))\n"
+            "local data = path:segmentData()\n"
+            "assert(#data == count * 6)\n"
+            "assert(data[61] == 10 and data[62] == 20)\n"
+            "local range = path:segmentPositions(5, 2)\n"
+            "assert(#range == 4 and range[1] == 5 and range[3] == 6 and range[4] == 12)\n"
+            "path:setSegmentData({1, 2, 3, 4, 5, 6}, 1)\n"
+            "assert(path:segment(1):position() == Vec2(1, 2))\n"
+            "assert(path:segment(1):handleIn() == Vec2(3, 4))\n"
+            "assert(path:segment(1):handleOut() == Vec2(5, 6))\n"
+            "assert(not pcall(path.setSegmentPositions, path, {1, 2, 3}))\n"
+            "local t = os.clock()\n"
+            "for i=0,count - 1 do local p = path:segment(i):position() end\n"
+            "local loopTime = os.clock() - t\n"
+            "local out = {}\n"
+            "t = os.clock()\n"
+            "path:segmentPositions(0, count, out)\n"
+            "local bulkTime = os.clock() - t\n"
+            "print(string.format('segment(i) loop: %.1f ns/segment, segmentPositions: %.1f ns/segment', loopTime / count * 1e9, bulkTime / count * 1e9))\n"
+            "t = os.clock()\n"
+            "for i=0,count - 1 do path:segment(i):setPosition(Vec2(i, i)) end\n"
+            "loopTime = os.clock() - t\n"
+            "t = os.clock()\n"
+            "path:setSegmentPositions(out)\n"
+            "bulkTime = os.clock() - t\n"
+            "print(string.format('setPosition loop: %.1f ns/segment, setSegmentPositions: %.1f ns/segment', loopTime / count * 1e9, bulkTime / count * 1e9))\n"
+            "assert(path:segment(10):position() == Vec2(10, 20))\n"
+            //reusing a longer out table drops its old tail
+            "path:segmentPositions(0, 2, out)\n"
+            "assert(#out == 4 and out[5] == nil)\n";
+
+            auto err = luanatic::execute(state, bulkTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Iterator Tests")
+    {
+        //needs to outlive the state as lua_close still goes through the counting allocator
+        AllocationCounter counter;
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            installAllocationCounter(state, counter);
+
+            String iteratorTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local small = doc:createPath()\n"
+            "local big = doc:createPath()\n"
+            "for i=1,10 do small:addPoint(Vec2(i, i)) end\n"
+            "for i=1,1000 do big:addPoint(Vec2(i, i)) end\n"
+            //breaking out early must not leak the iteration session
+            "for i=1,100 do for seg in big:segments() do break end end\n"
+            "for i=1,100 do for c in big:curves(true) do break end end\n"
+            "collectgarbage()\n"
+            //default mode yields independent handles
+            "local segs = {}\n"
+            "for seg in small:segments() do segs[#segs + 1] = seg end\n"
+            "assert(#segs == 10)\n"
+            "assert(segs[1]:position() == Vec2(1, 1) and segs[10]:position() == Vec2(10, 10))\n"
+            "local function loopAllocations(path)\n"
+            "    collectgarbage('stop')\n"
+            "    local before = allocationCount()\n"
+            "    local n = 0\n"
+            "    for seg in path:segments(true) do n = n + 1 end\n"
+            "    local ret = allocationCount() - before\n"
+            "    collectgarbage('restart')\n"
+            "    return ret, n\n"
+            "end\n"
+            "loopAllocations(small)\n"
+            "local smallAllocs, smallCount = loopAllocations(small)\n"
+            "local bigAllocs, bigCount = loopAllocations(big)\n"
+            "assert(smallCount == 10 and bigCount == 1000)\n"
+            "print('allocations per loop', smallAllocs, bigAllocs)\n"
+            //steady state iteration must not allocate, only creating the loop does
+            "assert(smallAllocs == bigAllocs)\n"
+            "local sum = 0\n"
+            "for c in big:curves(true) do sum = sum + c:positionOne().x end\n"
+            "assert(sum == 999 * 1000 / 2)\n"
+            //a proxy kept after the loop keeps its session alive
+            "local kept\n"
+            "for seg in small:segments(true) do kept = seg end\n"
+            "collectgarbage()\n"
+            "collectgarbage()\n"
+            "assert(kept:position() == Vec2(10, 10))\n";
+
+            auto err = luanatic::execute(state, iteratorTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("XY Binding Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String xyTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local path = doc:createCircle(Vec2(100, 100), 50)\n"
+            "local seg = path:segment(0)\n"
+            "local x, y = seg:positionXY()\n"
+            "assert(Vec2(x, y) == seg:position())\n"
+            "seg:setPositionXY(10, 20)\n"
+            "assert(seg:position() == Vec2(10, 20))\n"
+            "local curve = path:curve(0)\n"
+            "local len = curve:length()\n"
+            "x, y = curve:positionAtXY(len * 0.5)\n"
+            "assert(Vec2(x, y) == curve:positionAt(len * 0.5))\n"
+            "x, y = path:normalAtXY(path:length() * 0.25)\n"
+            "assert(Vec2(x, y) == path:normalAt(path:length() * 0.25))\n"
+            "path:translateXY(5, 5)\n"
+            "x, y = path:positionXY()\n"
+            "assert(Vec2(x, y) == path:position())\n"
+            "local function measure(f)\n"
+            "    collectgarbage()\n"
+            "    collectgarbage('stop')\n"
+            "    local mem = collectgarbage('count')\n"
+            "    local t = os.clock()\n"
+            "    f()\n"
+            "    local dt, dm = os.clock() - t, collectgarbage('count') - mem\n"
+            "    collectgarbage('restart')\n"
+            "    return dt, dm\n"
+            "end\n"
+            "local count = 100000\n"
+            "local step = len / count\n"
+            "local vecTime, vecKB = measure(function() for i=0,count-1 do local p = curve:positionAt(i * step) end end)\n"
+            "local xyTime, xyKB = measure(function() for i=0,count-1 do local x, y = curve:positionAtXY(i * step) end end)\n"
+            "print(string.format('positionAt: %.1f ns/call %.1f bytes/call, positionAtXY: %.1f ns/call %.1f bytes/call',\n"
+            "    vecTime / count * 1e9, vecKB * 1024 / count, xyTime / count * 1e9, xyKB * 1024 / count))\n"
+            "assert(xyKB < vecKB)\n";
+
+            auto err = luanatic::execute(state, xyTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Sampling Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String samplingTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local path = doc:createPath()\n"
+            "path:addPoint(Vec2(0, 0))\n"
+            "for i=1,100 do path:cubicCurveTo(Vec2(i * 10 - 5, 20), Vec2(i * 10 - 2, -20), Vec2(i * 10, 0)) end\n"
+            "local len = path:length()\n"
+            "local offsets = {}\n"
+            "for i=1,500 do offsets[i] = math.random() * len end\n"
+            "local function near(a, b) return math.abs(a - b) < 0.01 end\n"
+            "local positions, normals, tangents, curvatures = path:sampleAt(offsets, {normals = true, tangents = true, curvature = true})\n"
+            "assert(#positions == 1000 and #normals == 1000 and #tangents == 1000 and #curvatures == 500)\n"
+            "for i=1,#offsets do\n"
+            "    local p = path:positionAt(offsets[i])\n"
+            "    local n = path:normalAt(offsets[i])\n"
+            "    local t = path:tangentAt(offsets[i])\n"
+            "    assert(near(positions[i * 2 - 1], p.x) and near(positions[i * 2], p.y))\n"
+            "    assert(near(normals[i * 2 - 1], n.x) and near(normals[i * 2], n.y))\n"
+            "    assert(near(tangents[i * 2 - 1], t.x) and near(tangents[i * 2], t.y))\n"
+            "    assert(math.abs(curvatures[i] - path:curvatureAt(offsets[i])) < 0.01 * math.max(1, math.abs(curvatures[i])))\n"
+            "end\n"
+            "local uniform, n = path:sampleUniform(11)\n"
+            "assert(#uniform == 22 and n == nil)\n"
+            "assert(near(uniform[1], 0) and near(uniform[21], 1000))\n"
+            "local t = os.clock()\n"
+            "for i=1,#offsets do local p = path:positionAt(offsets[i]) end\n"
+            "local loopTime = os.clock() - t\n"
+            "t = os.clock()\n"
+            "path:sampleAt(offsets)\n"
+            "local batchTime = os.clock() - t\n"
+            "print(string.format('positionAt loop: %.1f us/sample, sampleAt: %.1f us/sample', loopTime / #offsets * 1e6, batchTime / #offsets * 1e6))\n"
+            "assert(not pcall(path.sampleAt, path, {1, 0 / 0, 2}))\n"
+            "assert(not pcall(path.sampleAt, path, {math.huge}))\n";
+
+            auto err = luanatic::execute(state, samplingTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Intersection Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String intersectionTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local a = doc:createPath()\n"
+            "a:addPoint(Vec2(0, 0))\n"
+            "a:addPoint(Vec2(100, 100))\n"
+            "local b = doc:createPath()\n"
+            "b:addPoint(Vec2(0, 100))\n"
+            "b:addPoint(Vec2(100, 0))\n"
+            "assert(a:intersections(doc:createRectangle(Vec2(500, 500), Vec2(600, 600))) == nil)\n"
+            "local out = {1, 2, 3, 4, 5, 6, 7, 8}\n"
+            "local res, count = a:intersections(b, out)\n"
+            "assert(res == out and count == 1 and #out == 4)\n"
+            "assert(math.abs(out[1] - 50) < 0.001 and math.abs(out[2] - 50) < 0.001)\n"
+            "assert(out[3] == 0 and math.abs(out[4] - 0.5) < 0.001)\n"
+            "local classic = a:intersections(b)\n"
+            "assert(#classic == 1 and classic[1].position == Vec2(out[1], out[2]))\n"
+            //a grid of horizontal and vertical lines, every horizontal line crosses every vertical one
+            "local paths = {}\n"
+            "local n = 50\n"
+            "for i=1,n do\n"
+            "    local h = doc:createPath()\n"
+            "    h:addPoint(Vec2(0, i * 10 + 0.5))\n"
+            "    h:addPoint(Vec2(n * 10 + 10, i * 10 + 0.5))\n"
+            "    paths[#paths + 1] = h\n"
+            "    local v = doc:createPath()\n"
+            "    v:addPoint(Vec2(i * 10 + 0.5, 0))\n"
+            "    v:addPoint(Vec2(i * 10 + 0.5, n * 10 + 10))\n"
+            "    paths[#paths + 1] = v\n"
+            "end\n"
+            //a far away path that must be culled
+            "paths[#paths + 1] = doc:createCircle(Vec2(10000, 10000), 10)\n"
+            "local t = os.clock()\n"
+            "local all, total = paper.intersectAll(paths)\n"
+            "local sweepTime = os.clock() - t\n"
+            "assert(total == n * n and #all == total * 6)\n"
+            "for i=1,#all,6 do assert(all[i] < all[i + 1]) end\n"
+            "t = os.clock()\n"
+            "local naive = 0\n"
+            "for i=1,#paths do for j=i + 1,#paths do local r, c = paths[i]:intersections(paths[j], out); naive = naive + c end end\n"
+            "local naiveTime = os.clock() - t\n"
+            "assert(naive == total)\n"
+            "print(string.format('intersectAll: %.2f ms, pairwise loop: %.2f ms', sweepTime * 1e3, naiveTime * 1e3))\n";
+
+            auto err = luanatic::execute(state, intersectionTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Closest Point Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String closestTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "path = doc:createPath()\n"
+            "path:addPoint(Vec2(0, 0))\n"
+            "for i=1,200 do path:cubicCurveTo(Vec2(i * 10 - 7, 15), Vec2(i * 10 - 3, -15), Vec2(i * 10, 0)) end\n"
+            "local points = {}\n"
+            "for i=1,1000 do points[#points + 1] = math.random() * 2000; points[#points + 1] = math.random() * 200 - 100 end\n"
+            "local res = path:closestPoints(points)\n"
+            "assert(#res == 5000)\n"
+            "for i=1,1000 do\n"
+            "    local loc, dist = path:closestCurveLocation(Vec2(points[i * 2 - 1], points[i * 2]))\n"
+            "    assert(math.abs(res[i * 5 - 2] - dist) < 0.01)\n"
+            "end\n"
+            //the threaded path has to produce exactly the same results
+            "local threaded = path:closestPoints(points, {}, 4)\n"
+            "for i=1,#res do assert(res[i] == threaded[i]) end\n"
+            //moving a segment has to invalidate the cached index
+            "local probe = {5, 100}\n"
+            "local before = path:closestPoints(probe)\n"
+            "path:segment(0):setPosition(Vec2(5, 100))\n"
+            "local after = path:closestPoints(probe)\n"
+            "assert(after[3] < 0.001 and before[3] > 1)\n"
+            //so do the XY bindings and the bulk setters
+            "path:segment(0):setPositionXY(5, -100)\n"
+            "assert(path:closestPoints(probe)[3] > 1)\n"
+            "path:setSegmentPositions({5, 100})\n"
+            "assert(path:closestPoints(probe)[3] < 0.001)\n"
+            "local t = os.clock()\n"
+            "for i=1,1000 do local loc, dist = path:closestCurveLocation(Vec2(points[i * 2 - 1], points[i * 2])) end\n"
+            "local loopTime = os.clock() - t\n"
+            "t = os.clock()\n"
+            "path:closestPoints(points, res)\n"
+            "local batchTime = os.clock() - t\n"
+            "print(string.format('closestCurveLocation loop: %.1f us/point, closestPoints: %.1f us/point', loopTime * 1e3, batchTime * 1e3))\n";
+
+            auto err = luanatic::execute(state, closestTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            //changes made from C++ are only seen after invalidateCaches
+            lua_getglobal(state, "path");
+            paper::Path * path = luanatic::convertToTypeAndCheck<paper::Path>(state, -1);
+            lua_pop(state, 1);
+            path->segment(0).setPosition(paper::Vec2f(5, -100));
+            invalidateCaches(state);
+
+            String invalidateTest =
+            "assert(path:closestPoints({5, 100})[3] > 1)\n";
+
+            err = luanatic::execute(state, invalidateTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Spatial Index Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String indexTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local n = 317\n"
+            "local paths = {}\n"
+            "for i=1,n do for j=1,n do paths[#paths + 1] = doc:createCircle(Vec2(i * 10, j * 10), 4) end end\n"
+            "local hit = doc:hitTest(Vec2(50, 70))\n"
+            "assert(hit and hit:position() == Vec2(50, 70))\n"
+            "assert(doc:hitTest(Vec2(55, 75)) == nil)\n"
+            "assert(doc:hitTest(Vec2(55, 70), {tolerance = 1.5}):position() == Vec2(50, 70))\n"
+            //overlapping paths, the one painted last wins
+            "local top = doc:createCircle(Vec2(50, 70), 2)\n"
+            "assert(doc:hitTest(Vec2(50, 70)):position() == top:position())\n"
+            "assert(#doc:hitTest(Vec2(50, 70), {all = true}) == 2)\n"
+            "top:translate(Vec2(1000, 1000))\n"
+            "assert(doc:hitTest(Vec2(1050, 1070)):position() == Vec2(1050, 1070))\n"
+            "assert(#doc:hitTest(Vec2(50, 70), {all = true}) == 1)\n"
+            //a group transform has to be taken into account
+            "local group = doc:createGroup()\n"
+            "local inGroup = doc:createCircle(Vec2(0, 0), 4)\n"
+            "group:addChild(inGroup)\n"
+            "group:translateTransform(Vec2(-100, -100))\n"
+            "assert(doc:hitTest(Vec2(-100, -100)) ~= nil)\n"
+            "assert(#doc:itemsInRect(5, 5, 22, 22) == 4)\n"
+            "assert(#doc:itemsInRect(5, 5, 22, 22, {inside = true}) == 1)\n"
+            //the stroke test pads by the widest stroke, which has to follow style changes
+            "local stroked = doc:createCircle(Vec2(-500, -500), 10)\n"
+            "assert(doc:hitTest(Vec2(-500, -487), {fill = false, stroke = true}) == nil)\n"
+            "stroked:setStroke(ColorRGBA(0, 0, 0, 1))\n"
+            "stroked:setStrokeWidth(8)\n"
+            "assert(doc:hitTest(Vec2(-500, -487), {fill = false, stroke = true}):position() == stroked:position())\n"
+            "stroked:setStrokeWidth(2)\n"
+            "assert(doc:hitTest(Vec2(-500, -487), {fill = false, stroke = true}) == nil)\n"
+            //clone adds an item, regularOffset changes the path in place
+            "local copy = top:clone()\n"
+            "assert(#doc:hitTest(Vec2(1050, 1070), {all = true}) == 2)\n"
+            "assert(#doc:itemsInRect(1045, 1065, 1055, 1075) == 2)\n"
+            "local ring = doc:createCircle(Vec2(-800, -800), 10)\n"
+            "local before = ring:closestPoints({-800, -800})[3]\n"
+            "ring:regularOffset(5, 0.25)\n"
+            "assert(math.abs(ring:closestPoints({-800, -800})[3] - before) > 1)\n"
+            "local points = {}\n"
+            "for i=1,50 do points[i] = Vec2(math.random() * n * 10, math.random() * n * 10) end\n"
+            "local t = os.clock()\n"
+            "for _, pt in ipairs(points) do\n"
+            "    local found\n"
+            "    for k=#paths,1,-1 do if paths[k]:contains(pt) then found = paths[k]; break end end\n"
+            "end\n"
+            "local scanTime = os.clock() - t\n"
+            "t = os.clock()\n"
+            "for _, pt in ipairs(points) do local found = doc:hitTest(pt) end\n"
+            "local indexTime = os.clock() - t\n"
+            "print(string.format('hitTest on %d items: lua scan %.2f ms/query, index %.2f ms/query', #paths, scanTime / #points * 1e3, indexTime / #points * 1e3))\n";
+
+            auto err = luanatic::execute(state, indexTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            //changes in place only update the changed paths, new items make it walk the document
+            err = luanatic::execute(state,
+                                    "updateDoc = paper.Document(\"Doc\")\n"
+                                    "for i=1,40 do updateDoc:createCircle(Vec2(i * 10, 0), 4) end\n"
+                                    "updateGroup = updateDoc:createGroup()\n"
+                                    "moved = updateDoc:createCircle(Vec2(0, 100), 4)\n"
+                                    "updateGroup:addChild(moved)\n"
+                                    "updateGroup:addChild(updateDoc:createCircle(Vec2(20, 100), 4))\n"
+                                    "assert(updateDoc:hitTest(Vec2(0, 100)):position() == moved:position())\n");
+            EXPECT(!err);
+            lua_getglobal(state, "updateDoc");
+            Document * updateDoc = luanatic::convertToTypeAndCheck<Document>(state, -1);
+            lua_pop(state, 1);
+            detail::ItemIndex & index = detail::luaItemIndex(state, updateDoc);
+            Size rebuilds = index.rebuildCount();
+            Size refits = index.refitCount();
+
+            err = luanatic::execute(state,
+                                    "moved:translate(Vec2(0, 100))\n"
+                                    "assert(updateDoc:hitTest(Vec2(0, 200)):position() == moved:position())\n"
+                                    "assert(updateDoc:hitTest(Vec2(0, 100)) == nil)\n"
+                                    "updateGroup:translateTransform(Vec2(0, 50))\n"
+                                    "moved:setPositionXY(0, 300)\n"
+                                    "assert(updateDoc:hitTest(Vec2(0, 350)):position() == moved:position())\n"
+                                    "assert(updateDoc:hitTest(Vec2(20, 150)) ~= nil)\n");
+            EXPECT(!err);
+            EXPECT(index.rebuildCount() == rebuilds);
+            EXPECT(index.refitCount() == refits + 2);
+
+            err = luanatic::execute(state,
+                                    "updateDoc:createCircle(Vec2(0, 500), 4)\n"
+                                    "assert(updateDoc:hitTest(Vec2(0, 500)) ~= nil)\n");
+            EXPECT(!err);
+            EXPECT(index.rebuildCount() == rebuilds + 1);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Startup Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper", RegistrationMode::Lazy);
+
+            String lazyTest =
+            "assert(rawget(paper, 'Smoothing') == nil)\n"
+            "assert(paper.Smoothing.CatmullRom ~= nil)\n"
+            "assert(rawget(paper, 'Path') == nil)\n"
+            "local doc = paper.Document(\"Doc\")\n"
+            "assert(rawget(paper, 'Path') ~= nil)\n"
+            "assert(rawget(paper, 'TarpRenderer') == nil)\n"
+            "local c = doc:createCircle(Vec2(100, 100), 10)\n"
+            "assert(c:segmentCount() == 4)\n"
+            "assert(paper.TarpRenderer ~= nil)\n"
+            "assert(paper.DoesNotExist == nil)\n"
+            //once everything is registered the lazy lookup is gone
+            "assert(getmetatable(paper).__index == nil)\n";
+
+            auto err = luanatic::execute(state, lazyTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+
+        //the globals table never gets a lazy __index
+        state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "", RegistrationMode::Lazy);
+
+            String globalTest =
+            "local mt = getmetatable(_G)\n"
+            "assert(mt == nil or mt.__index == nil)\n"
+            "assert(rawget(_G, 'Path') ~= nil)\n"
+            "assert(rawget(_G, 'TarpRenderer') ~= nil)\n";
+
+            auto err = luanatic::execute(state, globalTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+
+        //states per second for a short lived state that only runs a tiny script
+        auto statesPerSecond = [](RegistrationMode _mode)
+        {
+            const Size count = 200;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (Size i = 0; i < count; ++i)
+            {
+                lua_State * state = createLuaState();
+                openStandardLibraries(state);
+                initialize(state);
+                crunchLua::registerCrunch(state);
+                registerPaper(state, "paper", _mode);
+                auto err = luanatic::execute(state, "local s = paper.Smoothing.Continuous");
+                EXPECT(!err);
+                lua_close(state);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            return count / elapsed.count();
+        };
+
+        double eager = statesPerSecond(RegistrationMode::Eager);
+        double lazy = statesPerSecond(RegistrationMode::Lazy);
+        printf("startup: eager %.0f states/s, lazy %.0f states/s\n", eager, lazy);
+    },
+    SUITE("Profiler Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+#ifdef PAPERLUA_ENABLE_PROFILING
+            lua_pushboolean(state, true);
+#else
+            lua_pushboolean(state, false);
+#endif //PAPERLUA_ENABLE_PROFILING
+            lua_setglobal(state, "profiling");
+
+            String profileTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local p = doc:createCircle(Vec2(100, 100), 10)\n"
+            "p:length()\n"
+            "p:length()\n"
+            "local prof = paper.profile()\n"
+            "if profiling then\n"
+            "    assert(prof['Path.length'].calls == 2)\n"
+            "    assert(prof['Path.length'].totalTime >= prof['Path.length'].maxTime)\n"
+            "    assert(prof['Document.createCircle'].calls == 1)\n"
+            "    assert(prof['Document.createCircle'].userdataResults == 1)\n"
+            "    assert(paper.profileJSON():find('\"name\":\"Path.length\"', 1, true))\n"
+            "else\n"
+            "    assert(next(prof) == nil)\n"
+            "end\n"
+            "paper.resetProfile()\n"
+            "assert(next(paper.profile()) == nil)\n"
+            "assert(paper.profileJSON() == '[]')\n";
+
+            auto err = luanatic::execute(state, profileTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Batch Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String batchTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local function makePaths(n)\n"
+            "    local ret = {}\n"
+            "    for i=1,n do\n"
+            "        local p = doc:createPath()\n"
+            "        for j=1,100 do p:addPoint(Vec2(j * 3, math.sin(j * 0.2 + i) * 20)) end\n"
+            "        ret[i] = p\n"
+            "    end\n"
+            "    return ret\n"
+            "end\n"
+            "local function sameData(a, b)\n"
+            "    for i, p in ipairs(a) do\n"
+            "        local da, db = p:segmentData(), b[i]:segmentData()\n"
+            "        if #da ~= #db then return false end\n"
+            "        for k=1,#da do if da[k] ~= db[k] then return false end end\n"
+            "    end\n"
+            "    return true\n"
+            "end\n"
+            "local paths = makePaths(64)\n"
+            "local clones = makePaths(64)\n"
+            "local t = os.clock()\n"
+            "for _, p in ipairs(clones) do p:simplify(2.5) end\n"
+            "local loopTime = os.clock() - t\n"
+            "t = os.clock()\n"
+            "paper.batch.simplify(paths, 2.5)\n"
+            "local batchTime = os.clock() - t\n"
+            "assert(paths[1]:segmentCount() < 100)\n"
+            "assert(sameData(paths, clones))\n"
+            //results don't depend on the number of threads
+            "local a, b = makePaths(20), makePaths(20)\n"
+            "paper.batch.flattenRegular(a, 1.0, 1)\n"
+            "paper.batch.flattenRegular(b, 1.0, 3)\n"
+            "assert(sameData(a, b))\n"
+            "paper.batch.smooth(a, paper.Smoothing.Continuous, false, 2)\n"
+            "paper.batch.flatten(a, 0.25)\n"
+            "local c, d = makePaths(20), makePaths(20)\n"
+            "paper.batch.regularOffset(c, 2, 0.25, 3)\n"
+            "for _, p in ipairs(d) do p:regularOffset(2, 0.25) end\n"
+            "assert(sameData(c, d))\n"
+            "assert(not pcall(paper.batch.simplify, {paths[1], 'nope'}, 1.0))\n"
+            "print(string.format('simplify on %d paths: loop %.2f ms, batch %.2f ms (cpu time)', #paths, loopTime * 1e3, batchTime * 1e3))\n";
+
+            auto err = luanatic::execute(state, batchTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            //the worker threads are started once and reused by later calls
+            Size poolThreads = detail::luaWorkerPool(state).threadCount();
+            EXPECT(poolThreads >= 2);
+            err = luanatic::execute(state,
+                                    "local doc, paths = paper.Document(), {}\n"
+                                    "for i=1,32 do paths[i] = doc:createCircle(Vec2(i * 10, 0), 4) end\n"
+                                    "for i=1,10 do paper.batch.flattenRegular(paths, 1.0, 3) end\n");
+            EXPECT(!err);
+            EXPECT(detail::luaWorkerPool(state).threadCount() == poolThreads);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("SVG Stream Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String streamTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local circles = {}\n"
+            "for i=1,50 do\n"
+            "    circles[i] = doc:createCircle(Vec2(i * 3, 50), 5)\n"
+            "    circles[i]:setFill(ColorRGBA(1, 0, 0, 1))\n"
+            "end\n"
+            "local chunks = {}\n"
+            "local bytes, complete = doc:exportSVGStream(function(_chunk) chunks[#chunks + 1] = _chunk end, {chunkSize = 256})\n"
+            "assert(complete and #chunks > 1)\n"
+            "local svg = table.concat(chunks)\n"
+            "assert(#svg == bytes)\n"
+            "assert(svg:find('<svg', 1, true) and svg:find('</svg>', 1, true))\n"
+            "local _, pathCount = svg:gsub('<path', '')\n"
+            "assert(pathCount == 50)\n"
+            //incremental exports only serialize what changed and produce the same output
+            "local function export()\n"
+            "    local parts = {}\n"
+            "    local _, _, reused, serialized = doc:exportSVGStream(function(_chunk) parts[#parts + 1] = _chunk end, {incremental = true})\n"
+            "    return table.concat(parts), reused, serialized\n"
+            "end\n"
+            "local first, reused, serialized = export()\n"
+            "assert(reused == 0 and serialized == 50)\n"
+            "assert(first == svg)\n"
+            "circles[3]:translate(Vec2(1, 0))\n"
+            "local second, reused, serialized = export()\n"
+            "assert(reused == 49 and serialized == 1)\n"
+            "assert(second ~= first)\n"
+            //the sink can abort, errors in it are passed on
+            "local calls = 0\n"
+            "local _, complete = doc:exportSVGStream(function() calls = calls + 1; return false end, {chunkSize = 64})\n"
+            "assert(not complete and calls == 1)\n"
+            "assert(not pcall(doc.exportSVGStream, doc, function() error('boom') end))\n"
+            "local name = os.tmpname()\n"
+            "assert(select(2, doc:exportSVGStream(name)))\n"
+            "local f = io.open(name, 'rb')\n"
+            "local content = f:read('*a')\n"
+            "f:close()\n"
+            "os.remove(name)\n"
+            "assert(content == second)\n"
+            //a styled scene has to come out of the streamed export the same as out of exportSVG
+            "local function styledScene()\n"
+            "    local d = paper.Document(\"Styled\")\n"
+            "    local g = d:createGroup()\n"
+            "    g:translateTransform(Vec2(10, 20))\n"
+            "    local a = d:createCircle(Vec2(50, 50), 20)\n"
+            "    a:setFill(ColorRGBA(0, 0.5, 1, 0.5))\n"
+            "    a:setStroke(ColorRGBA(0, 0, 0, 1))\n"
+            "    a:setStrokeWidth(3)\n"
+            "    a:setStrokeJoin(paper.StrokeJoin.Round)\n"
+            "    a:setStrokeCap(paper.StrokeCap.Square)\n"
+            "    local b = d:createRectangle(Vec2(100, 10), Vec2(180, 60))\n"
+            "    paper.applyStyle({b}, {stroke = ColorRGBA(1, 0, 0, 1), strokeWidth = 2, dashArray = {4, 2}, windingRule = paper.WindingRule.EvenOdd})\n"
+            "    local grad = paper.createRadialGradient(Vec2(60, 150), Vec2(90, 150))\n"
+            "    grad:addStop(ColorRGBA(1, 0, 0, 1), 0)\n"
+            "    grad:addStop(ColorRGBA(0, 0, 1, 1), 1)\n"
+            "    grad:setRatio(0.5)\n"
+            "    local c = d:createEllipse(Vec2(60, 150), Vec2(80, 40))\n"
+            "    c:setFill(grad)\n"
+            "    g:addChild(a)\n"
+            "    g:addChild(b)\n"
+            "    local clipped = d:createGroup()\n"
+            "    clipped:addChild(d:createRectangle(Vec2(200, 200), Vec2(240, 240)))\n"
+            "    local inClip = d:createCircle(Vec2(220, 220), 30)\n"
+            "    inClip:setFill(ColorRGBA(0, 1, 0, 1))\n"
+            "    inClip:setMiterLimit(6)\n"
+            "    clipped:addChild(inClip)\n"
+            "    clipped:setClipped(true)\n"
+            "    return d\n"
+            "end\n"
+            "local function paths(_item, _out, _groups)\n"
+            "    for c in _item:children() do\n"
+            "        if c:itemType() == paper.ItemType.Path then _out[#_out + 1] = c\n"
+            "        else\n"
+            "            if _groups then _groups[#_groups + 1] = c end\n"
+            "            paths(c, _out, _groups)\n"
+            "        end\n"
+            "    end\n"
+            "    return _out\n"
+            "end\n"
+            "local function streamed(_doc)\n"
+            "    local parts = {}\n"
+            "    _doc:exportSVGStream(function(_chunk) parts[#parts + 1] = _chunk end)\n"
+            "    return table.concat(parts)\n"
+            "end\n"
+            "local styled = styledScene()\n"
+            "local groupsA, groupsB = {}, {}\n"
+            "local fromString = paths(assert(paper.Document(\"A\"):parseSVG(styled:exportSVG())), {}, groupsA)\n"
+            "local fromStream = paths(assert(paper.Document(\"B\"):parseSVG(streamed(styled))), {}, groupsB)\n"
+            "assert(#fromString == #fromStream and #fromString >= 4)\n"
+            "assert(#groupsA == #groupsB)\n"
+            "for i=1,#groupsA do\n"
+            "    assert(groupsA[i]:isClipped() == groupsB[i]:isClipped())\n"
+            "end\n"
+            "for i=1,#fromString do\n"
+            "    local a, b = fromString[i], fromStream[i]\n"
+            "    assert(a:segmentCount() == b:segmentCount())\n"
+            "    local da, db = a:segmentData(), b:segmentData()\n"
+            "    for k=1,#da do assert(math.abs(da[k] - db[k]) < 0.01) end\n"
+            "    local ab, bb = a:bounds(), b:bounds()\n"
+            "    assert(math.abs(ab:min().x - bb:min().x) < 0.01 and math.abs(ab:max().y - bb:max().y) < 0.01)\n"
+            "    assert(a:hasFill() == b:hasFill() and a:hasStroke() == b:hasStroke())\n"
+            "    assert(a:strokeWidth() == b:strokeWidth())\n"
+            "    assert(a:strokeJoin() == b:strokeJoin() and a:strokeCap() == b:strokeCap())\n"
+            "    assert(a:windingRule() == b:windingRule())\n"
+            "    assert(a:miterLimit() == b:miterLimit() and a:dashOffset() == b:dashOffset())\n"
+            "end\n"
+            //ids don't depend on addresses, so the same scene always gives the same text
+            "local styledSVG = streamed(styled)\n"
+            "assert(streamed(styledScene()) == styledSVG)\n"
+            "assert(styledSVG:find('gradientTransform', 1, true))\n";
+
+            auto err = luanatic::execute(state, streamTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("SVG Import Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String importTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local items = {\n"
+            "    doc:createCircle(Vec2(50, 50), 20),\n"
+            "    doc:createRectangle(Vec2(100, 10), Vec2(180, 60)),\n"
+            "    doc:createEllipse(Vec2(60, 150), Vec2(80, 40))\n"
+            "}\n"
+            "for _, item in ipairs(items) do item:setFill(ColorRGBA(0, 0.5, 1, 1)) end\n"
+            //collects the paths below an item in paint order
+            "local function collect(_item, _out)\n"
+            "    for c in _item:children() do\n"
+            "        if c:itemType() == paper.ItemType.Path then _out[#_out + 1] = c else collect(c, _out) end\n"
+            "    end\n"
+            "    return _out\n"
+            "end\n"
+            "local function sameItems(_imported)\n"
+            "    local paths = collect(_imported, {})\n"
+            "    if #paths ~= #items then return false end\n"
+            "    for i, p in ipairs(paths) do\n"
+            "        local ax, ay = p:positionXY()\n"
+            "        local bx, by = items[i]:positionXY()\n"
+            "        if math.abs(ax - bx) > 0.01 or math.abs(ay - by) > 0.01 then return false end\n"
+            "    end\n"
+            "    return true\n"
+            "end\n"
+            "local svg = doc:exportSVG()\n"
+            "local doc2 = paper.Document(\"Doc2\")\n"
+            "local group, stats = doc2:parseSVG(svg)\n"
+            "assert(group, stats)\n"
+            "assert(stats.bytes == #svg and stats.copyTime >= 0 and stats.parseTime >= 0)\n"
+            "assert(sameItems(group))\n"
+            //the streamed export has to round trip as well
+            "local parts = {}\n"
+            "doc:exportSVGStream(function(_chunk) parts[#parts + 1] = _chunk end)\n"
+            "local doc3 = paper.Document(\"Doc3\")\n"
+            "assert(sameItems(assert(doc3:parseSVG(table.concat(parts)))))\n"
+            "local name = os.tmpname()\n"
+            "local f = io.open(name, 'wb')\n"
+            "f:write(svg)\n"
+            "f:close()\n"
+            "local doc4 = paper.Document(\"Doc4\")\n"
+            "local loaded, loadStats = doc4:loadSVG(name)\n"
+            "os.remove(name)\n"
+            "assert(loaded, loadStats)\n"
+            "assert(loadStats.bytes == #svg and loadStats.mapTime >= 0 and loadStats.copyTime >= 0)\n"
+            "assert(sameItems(loaded))\n"
+            "local missing, err = doc2:loadSVG(name)\n"
+            "assert(missing == nil and type(err) == 'string')\n";
+
+            auto err = luanatic::execute(state, importTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Binary Format Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String roundTripTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "doc:setSize(300, 200)\n"
+            "local group = doc:createGroup()\n"
+            "group:setName(\"shapes\")\n"
+            "group:setStrokeWidth(7)\n"
+            "group:setStrokeCap(paper.StrokeCap.Round)\n"
+            "local circle = doc:createCircle(Vec2(50, 50), 20)\n"
+            "circle:setFill(ColorRGBA(0, 0.5, 1, 1))\n"
+            "local rect = doc:createRectangle(Vec2(100, 10), Vec2(180, 60))\n"
+            "local grad = paper.createLinearGradient(Vec2(100, 10), Vec2(180, 60))\n"
+            "grad:addStop(ColorRGBA(1, 0, 0, 1), 0)\n"
+            "grad:addStop(ColorRGBA(0, 0, 1, 1), 1)\n"
+            "rect:setFill(grad)\n"
+            "rect:setStroke(ColorRGBA(0, 0, 0, 1))\n"
+            "rect:setStrokeWidth(3)\n"
+            "group:addChild(circle)\n"
+            "group:addChild(rect)\n"
+            "local open = doc:createPath()\n"
+            "open:addPoint(Vec2(0, 0))\n"
+            "open:addPoint(Vec2(10, 20))\n"
+            "open:setVisible(false)\n"
+            "local name = os.tmpname()\n"
+            "assert(doc:saveBinary(name))\n"
+            "local loaded = assert(paper.Document.loadBinary(name))\n"
+            "assert(loaded:width() == 300 and loaded:height() == 200)\n"
+            //the exported SVG of both documents has to match
+            "assert(loaded:exportSVG() == doc:exportSVG())\n"
+            "local children = {}\n"
+            "for c in loaded:children() do children[#children + 1] = c end\n"
+            "assert(#children == 2)\n"
+            "assert(children[1]:name() == \"shapes\")\n"
+            //group styles survive the round trip too
+            "assert(children[1]:strokeWidth() == 7 and children[1]:strokeCap() == paper.StrokeCap.Round)\n"
+            "assert(not children[2]:isVisible() and not children[2]:isClosed())\n"
+            "assert(children[2]:segmentCount() == 2)\n"
+            "local paths = {}\n"
+            "for c in children[1]:children() do paths[#paths + 1] = c end\n"
+            "assert(#paths == 2 and paths[1]:isClosed())\n"
+            "assert(paths[2]:strokeWidth() == 3)\n"
+            //unsupported versions and garbage are rejected with an error instead of loading
+            "local f = io.open(name, 'rb')\n"
+            "local data = f:read('*a')\n"
+            "f:close()\n"
+            "f = io.open(name, 'wb')\n"
+            "f:write(data:sub(1, 8) .. '\\255\\0\\0\\0' .. data:sub(13))\n"
+            "f:close()\n"
+            "local bad, err = paper.Document.loadBinary(name)\n"
+            "assert(bad == nil and err:find('version'))\n"
+            "f = io.open(name, 'wb')\n"
+            "f:write(data:sub(1, 100))\n"
+            "f:close()\n"
+            "bad, err = paper.Document.loadBinary(name)\n"
+            "assert(bad == nil and type(err) == 'string')\n"
+            "os.remove(name)\n"
+            "bad, err = paper.Document.loadBinary(name)\n"
+            "assert(bad == nil and type(err) == 'string')\n";
+
+            auto err = luanatic::execute(state, roundTripTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            //compares size and load time against an SVG round trip of the same document
+            String comparison =
+            "local doc = paper.Document(\"Doc\")\n"
+            "for i = 1, 2000 do\n"
+            "    local c = doc:createCircle(Vec2(i % 100 * 10, i / 10), 4)\n"
+            "    c:setFill(ColorRGBA(i % 3 / 2, 0.5, 1, 1))\n"
+            "end\n"
+            "local binName, svgName = os.tmpname(), os.tmpname()\n"
+            "local start = os.clock()\n"
+            "assert(doc:saveBinary(binName))\n"
+            "local binSave = os.clock() - start\n"
+            "start = os.clock()\n"
+            "local f = io.open(svgName, 'wb')\n"
+            "f:write(doc:exportSVG())\n"
+            "f:close()\n"
+            "local svgSave = os.clock() - start\n"
+            "start = os.clock()\n"
+            "local fromBin = assert(paper.Document.loadBinary(binName))\n"
+            "local binLoad = os.clock() - start\n"
+            "local fromSVG = paper.Document(\"SVG\")\n"
+            "start = os.clock()\n"
+            "assert(fromSVG:loadSVG(svgName))\n"
+            "local svgLoad = os.clock() - start\n"
+            "local function size(_name) local f = io.open(_name, 'rb'); local s = f:seek('end'); f:close(); return s end\n"
+            "print(string.format('binary: %d bytes, save %.4fs, load %.4fs', size(binName), binSave, binLoad))\n"
+            "print(string.format('svg:    %d bytes, save %.4fs, load %.4fs', size(svgName), svgSave, svgLoad))\n"
+            "assert(size(binName) < size(svgName))\n"
+            "os.remove(binName)\n"
+            "os.remove(svgName)\n";
+
+            err = luanatic::execute(state, comparison);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Path Snapshot Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String snapshotTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local path = doc:createPath()\n"
+            "for i=0,200 do path:addPoint(Vec2(i * 5, math.sin(i * 0.1) * 50)) end\n"
+            "path:smooth(paper.Smoothing.Continuous, false)\n"
+            "local circle = doc:createCircle(Vec2(100, 100), 40)\n"
+            "local function near(_a, _b, _eps) return math.abs(_a - _b) <= _eps end\n"
+            "for _, p in ipairs({path, circle}) do\n"
+            "    local snap = p:snapshot()\n"
+            "    local len = p:length()\n"
+            "    assert(near(snap:length(), len, len * 1e-4))\n"
+            "    assert(snap:curveCount() == p:curveCount() and snap:isClosed() == p:isClosed())\n"
+            "    assert(near(snap:area(), p:area(), math.abs(p:area()) * 1e-4 + 1e-3))\n"
+            "    local a, b = snap:bounds(), p:bounds()\n"
+            "    assert(near(a:min().x, b:min().x, 1e-2) and near(a:max().y, b:max().y, 1e-2))\n"
+            "    for i=0,50 do\n"
+            "        local offset = len * i / 50\n"
+            "        local x, y = snap:positionAtXY(offset)\n"
+            "        local px, py = p:positionAtXY(offset)\n"
+            "        assert(near(x, px, 1e-2) and near(y, py, 1e-2))\n"
+            "        local tx, ty = snap:tangentAtXY(offset)\n"
+            "        local ptx, pty = p:tangentAtXY(offset)\n"
+            "        assert(near(tx, ptx, 1e-2) and near(ty, pty, 1e-2))\n"
+            "        local nx, ny = snap:normalAtXY(offset)\n"
+            "        assert(near(nx * tx + ny * ty, 0, 1e-4) and near(nx * nx + ny * ny, 1, 1e-4))\n"
+            "        local curveIndex, parameter = snap:curveLocationAt(offset)\n"
+            "        local cx, cy = p:curve(curveIndex):positionAtParameterXY(parameter)\n"
+            "        assert(near(cx, px, 1e-2) and near(cy, py, 1e-2))\n"
+            "    end\n"
+            "    local c = p:curve(1)\n"
+            "    assert(near(snap:curveLength(1), c:length(), c:length() * 1e-4))\n"
+            "    assert(near(snap:parameterAtOffset(1, c:length() * 0.5), c:parameterAtOffset(c:length() * 0.5), 1e-3))\n"
+            "end\n"
+            //the snapshot is a copy, changing the path afterwards doesn't affect it
+            "local snap = path:snapshot()\n"
+            "local before = snap:length()\n"
+            "path:addPoint(Vec2(2000, 0))\n"
+            "assert(snap:length() == before)\n"
+            "local empty = doc:createPath():snapshot()\n"
+            "assert(empty:length() == 0 and empty:curveCount() == 0)\n"
+            "local t = os.clock()\n"
+            "local count = 2000\n"
+            "for i=1,count do path:positionAt(i / count * before) end\n"
+            "local pathTime = os.clock() - t\n"
+            "t = os.clock()\n"
+            "for i=1,count do snap:positionAt(i / count * before) end\n"
+            "local snapTime = os.clock() - t\n"
+            "print(string.format('positionAt: path %.1f us/call, snapshot %.1f us/call', pathTime / count * 1e6, snapTime / count * 1e6))\n";
+
+            auto err = luanatic::execute(state, snapshotTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Sliced Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+            //C functions can't yield before 5.2, the sliced functions then always block
+            lua_pushboolean(state, LUA_VERSION_NUM >= 502);
+            lua_setglobal(state, "yields");
+
+            String slicedTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local function makePaths()\n"
+            "    local ret = {}\n"
+            "    for i=1,40 do\n"
+            "        local p = doc:createPath()\n"
+            "        for j=0,60 do p:addPoint(Vec2(j * 4 + i, math.sin(j * 0.3 + i) * 30 + i * 3)) end\n"
+            "        ret[#ret + 1] = p\n"
+            "    end\n"
+            "    return ret\n"
+            "end\n"
+            "local function sameGeometry(_a, _b)\n"
+            "    for i, p in ipairs(_a) do\n"
+            "        local da, db = p:segmentData(), _b[i]:segmentData()\n"
+            "        if #da ~= #db then return false end\n"
+            "        for j=1,#da do if da[j] ~= db[j] then return false end end\n"
+            "    end\n"
+            "    return true\n"
+            "end\n"
+            //runs fn in a coroutine until it finishes, returns its results and the number of slices
+            "local function drive(_fn, ...)\n"
+            "    local co = coroutine.create(function(...) return _fn(...) end)\n"
+            "    local slices, lastProgress = 0, 0\n"
+            "    local res = {coroutine.resume(co, ...)}\n"
+            "    while coroutine.status(co) ~= 'dead' do\n"
+            "        assert(res[1], res[2])\n"
+            "        assert(res[2] >= lastProgress and res[2] <= 1)\n"
+            "        lastProgress = res[2]\n"
+            "        slices = slices + 1\n"
+            "        res = {coroutine.resume(co)}\n"
+            "    end\n"
+            "    assert(res[1], res[2])\n"
+            "    table.remove(res, 1)\n"
+            "    return slices, (table.unpack or unpack)(res)\n"
+            "end\n"
+            "local blocking, sliced = makePaths(), makePaths()\n"
+            "for _, p in ipairs(blocking) do p:simplify(2.5) end\n"
+            "local slices = drive(paper.sliced.simplify, sliced, 2.5, 1)\n"
+            "assert(slices > 1 or not yields)\n"
+            "assert(sameGeometry(blocking, sliced))\n"
+            "blocking, sliced = makePaths(), makePaths()\n"
+            "for _, p in ipairs(blocking) do p:smooth(paper.Smoothing.Continuous, false) end\n"
+            "drive(paper.sliced.smooth, sliced, paper.Smoothing.Continuous, false, 1)\n"
+            "assert(sameGeometry(blocking, sliced))\n"
+            //outside of a coroutine the sliced functions just block
+            "local plain = makePaths()\n"
+            "assert(paper.sliced.simplify(plain, 2.5) == plain)\n"
+            "local expected, expectedCount = paper.intersectAll(blocking)\n"
+            "local n, out, count = drive(paper.sliced.intersectAll, blocking, nil, 1)\n"
+            "assert((n > 1 or not yields) and count == expectedCount and #out == #expected)\n"
+            "for i=1,#out do assert(out[i] == expected[i]) end\n"
+            "local parts = {}\n"
+            "doc:exportSVGStream(function(_chunk) parts[#parts + 1] = _chunk end)\n"
+            "local n, svg = drive(paper.sliced.exportSVG, doc, 1)\n"
+            "assert((n > 1 or not yields) and svg == table.concat(parts))\n"
+            "assert(paper.sliced.exportSVG(doc) == svg)\n"
+            //changing the tree while a task is suspended aborts it instead of touching freed items
+            "if yields then\n"
+            "    local victims = makePaths()\n"
+            "    local co = coroutine.create(paper.sliced.simplify)\n"
+            "    assert(coroutine.resume(co, victims, 2.5, 1))\n"
+            "    assert(coroutine.status(co) == 'suspended')\n"
+            "    victims[1]:length()\n"
+            "    assert(coroutine.resume(co))\n"
+            "    victims[#victims]:remove()\n"
+            "    local ok, msg = coroutine.resume(co)\n"
+            "    assert(not ok and msg:find('changed'))\n"
+            "    co = coroutine.create(paper.sliced.exportSVG)\n"
+            "    assert(coroutine.resume(co, doc, 1))\n"
+            "    doc:createCircle(Vec2(0, 0), 5)\n"
+            "    ok, msg = coroutine.resume(co)\n"
+            "    assert(not ok and msg:find('changed'))\n"
+            //abandoned operations are cleaned up by the garbage collector
+            "    co = coroutine.create(paper.sliced.exportSVG)\n"
+            "    assert(coroutine.resume(co, doc, 1))\n"
+            "    assert(coroutine.status(co) == 'suspended')\n"
+            "    co = nil\n"
+            "    collectgarbage()\n"
+            //a suspended task keeps the document of its items alive
+            "    co = coroutine.create(paper.sliced.exportSVG)\n"
+            "    do\n"
+            "        local tmp = paper.Document(\"Tmp\")\n"
+            "        tmp:createCircle(Vec2(10, 10), 5)\n"
+            "        local rect = tmp:createRectangle(Vec2(0, 0), Vec2(20, 20))\n"
+            "        assert(coroutine.resume(co, rect, 1))\n"
+            "    end\n"
+            "    collectgarbage()\n"
+            "    collectgarbage()\n"
+            "    local ok, out = coroutine.resume(co)\n"
+            "    while ok and coroutine.status(co) ~= 'dead' do ok, out = coroutine.resume(co) end\n"
+            "    assert(ok and out:find('<path'))\n"
+            //under a C call boundary the task can't yield and runs to completion instead
+            "    co = coroutine.create(function()\n"
+            "        local svg\n"
+            "        string.gsub('x', 'x', function() svg = paper.sliced.exportSVG(doc, 1) end)\n"
+            "        return svg\n"
+            "    end)\n"
+            "    local ok, svg = coroutine.resume(co)\n"
+            "    assert(ok and coroutine.status(co) == 'dead' and svg == paper.sliced.exportSVG(doc))\n"
+            "end\n"
+            "assert(not pcall(paper.sliced.simplify, {1}, 2.5))\n";
+
+            auto err = luanatic::execute(state, slicedTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Style Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String styleTest =
+            "local grad = paper.createLinearGradient(Vec2(0, 0), Vec2(100, 0))\n"
+            "grad:addStop(ColorRGBA(1, 0, 0, 1), 0)\n"
+            "grad:addStop(ColorRGBA(0, 0, 1, 1), 1)\n"
+            "local function makeItems(_doc)\n"
+            "    local ret = {}\n"
+            "    for i=1,200 do ret[i] = _doc:createRectangle(Vec2(i, 0), Vec2(i + 10, 10)) end\n"
+            "    return ret\n"
+            "end\n"
+            "local a, b, c = paper.Document(\"A\"), paper.Document(\"B\"), paper.Document(\"C\")\n"
+            "local itemsA, itemsB, itemsC = makeItems(a), makeItems(b), makeItems(c)\n"
+            "local tmp = a:createPath()\n"
+            "tmp:rotateTransform(0.5)\n"
+            "local m = tmp:transform()\n"
+            "tmp:remove()\n"
+            "for _, item in ipairs(itemsA) do\n"
+            "    item:setFill(grad)\n"
+            "    item:setStroke(ColorRGBA(0, 0, 0, 1))\n"
+            "    item:setStrokeWidth(2)\n"
+            "    item:setStrokeJoin(paper.StrokeJoin.Round)\n"
+            "    item:setStrokeCap(paper.StrokeCap.Square)\n"
+            "    item:setMiterLimit(8)\n"
+            "    item:setDashOffset(1)\n"
+            "    item:transformItem(m)\n"
+            "end\n"
+            "local style = {fill = grad, stroke = ColorRGBA(0, 0, 0, 1), strokeWidth = 2, strokeJoin = paper.StrokeJoin.Round,\n"
+            "               strokeCap = paper.StrokeCap.Square, miterLimit = 8, dashOffset = 1}\n"
+            "paper.applyStyle(itemsB, style)\n"
+            "paper.transformItems(itemsB, m)\n"
+            "for _, item in ipairs(itemsC) do item:setStyle(style):transformItem(m) end\n"
+            "assert(a:exportSVG() == b:exportSVG())\n"
+            "assert(a:exportSVG() == c:exportSVG())\n"
+            "assert(itemsB[1]:strokeWidth() == 2 and itemsB[200]:miterLimit() == 8)\n"
+            "assert(itemsB[1]:strokeJoin() == paper.StrokeJoin.Round)\n"
+            //false removes a paint, color strings are parsed once and shared
+            "paper.applyStyle(itemsB, {stroke = false, fill = '#ff0000'})\n"
+            "assert(not itemsB[1]:hasStroke() and not itemsB[200]:hasStroke())\n"
+            "for _, item in ipairs(itemsA) do item:removeStroke(); item:setFill('#ff0000') end\n"
+            "assert(a:exportSVG() == b:exportSVG())\n"
+            "assert(not pcall(paper.applyStyle, itemsB, {fil = ColorRGBA(1, 0, 0, 1)}))\n"
+            "assert(not pcall(paper.applyStyle, itemsB, {strokeWidth = 'wide'}))\n"
+            "assert(not pcall(paper.applyStyle, {1, 2}, style))\n";
+
+            auto err = luanatic::execute(state, styleTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
+    SUITE("Handle Tests")
+    {
+        AllocationCounter counter;
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            installAllocationCounter(state, counter);
+
+            String handleTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local path = doc:createPath()\n"
+            "for i=1,1000 do path:addPoint(Vec2(i, math.sin(i))) end\n"
+            "assert(path:segment(3) == path:segment(3))\n"
+            "assert(path:curve(7) == path:curve(7))\n"
+            "assert(path:segment(3) ~= path:segment(4))\n"
+            "assert(path:curveLocationAt(10) == path:curveLocationAt(10))\n"
+            "assert(path:curve(2):curveLocationAt(0.5) == path:curve(2):curveLocationAt(0.5))\n"
+            //stable identity makes handles usable as table keys
+            "local visited = {}\n"
+            "visited[path:segment(10)] = true\n"
+            "assert(visited[path:segment(10)])\n"
+            "local ext = path:extrema()\n"
+            "if #ext > 0 then assert(path:extrema()[1] == ext[1]) end\n"
+            //a location pushed after the geometry changed is not the cached one with the old offset
+            "local poly = doc:createPath()\n"
+            "for i=0,10 do poly:addPoint(Vec2(i * 10, (i % 2) * 10)) end\n"
+            "local offset = poly:closestCurveLocation(Vec2(35, 2)):offset()\n"
+            "local positions = poly:segmentPositions()\n"
+            "for i=1,#positions do positions[i] = positions[i] * 2 end\n"
+            "poly:setSegmentPositions(positions)\n"
+            "assert(math.abs(poly:closestCurveLocation(Vec2(70, 4)):offset() - offset * 2) < 1e-3)\n"
+            "assert(not pcall(path.segment, path, 1000))\n"
+            "assert(not pcall(path.curve, path, -1))\n"
+            "local segs = {}\n"
+            "for i=0,path:segmentCount() - 1 do segs[i] = path:segment(i) end\n"
+            "collectgarbage('stop')\n"
+            "local allocBefore, kbBefore = allocationCount(), collectgarbage('count')\n"
+            "for i=0,path:segmentCount() - 1 do local s = path:segment(i) end\n"
+            "local allocs, kb = allocationCount() - allocBefore, collectgarbage('count') - kbBefore\n"
+            "collectgarbage('restart')\n"
+            "print(string.format('path:segment(i) on held handles: %.3f allocations, %.1f bytes per call', allocs / 1000, kb * 1024 / 1000))\n"
+            "assert(allocs == 0)\n"
+            //once nothing holds them, the handles are collected and the cache entries go away
+            "segs = nil\n"
+            "collectgarbage()\n"
+            "collectgarbage('stop')\n"
+            "allocBefore, kbBefore = allocationCount(), collectgarbage('count')\n"
+            "for i=0,path:segmentCount() - 1 do local s = path:segment(i) end\n"
+            "allocs, kb = allocationCount() - allocBefore, collectgarbage('count') - kbBefore\n"
+            "collectgarbage('restart')\n"
+            "print(string.format('path:segment(i) on new handles: %.3f allocations, %.1f bytes per call', allocs / 1000, kb * 1024 / 1000))\n";
+
+            auto err = luanatic::execute(state, handleTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+
+        //the same handle churn on a pooled state
+        state = createPooledLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String pooledTest =
+            "local doc = paper.Document(\"Doc\")\n"
+            "local path = doc:createPath()\n"
+            "for i=1,1000 do path:addPoint(Vec2(i, math.sin(i))) end\n"
+            "for j=1,20 do\n"
+            "    for i=0,path:segmentCount() - 1 do local p = path:segment(i):position() end\n"
+            "    collectgarbage()\n"
+            "end\n";
+
+            auto err = luanatic::execute(state, pooledTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            void * ud;
+            lua_getallocf(state, &ud);
+            detail::PoolAllocator * pool = static_cast<detail::PoolAllocator *>(ud);
+            printf("pooled state: %lu pooled allocations, %lu malloc allocations\n",
+                   (unsigned long)pool->pooledCount(), (unsigned long)pool->mallocCount());
+            EXPECT(pool->pooledCount() > pool->mallocCount());
+            EXPECT(lua_gettop(state) == 0);
+        }
+        closePooledLuaState(state);
+    },
+    SUITE("Binding Policy Tests")
+    {
+        for (RegistrationMode mode : {RegistrationMode::Eager, RegistrationMode::Lazy})
+        {
+            lua_State * state = createLuaState();
+            {
+                openStandardLibraries(state);
+                initialize(state);
+                crunchLua::registerCrunch(state);
+                registerPaper<BindingPolicy::Unchecked>(state, "paper", mode);
+
+                String policyTest =
+                "local doc = paper.Document()\n"
+                "local path = doc:createPath()\n"
+                "for i=1,10 do path:addPoint(Vec2(i, i * 2)) end\n"
+                "path:setFillColor(ColorRGBA(1, 0, 0, 1))\n"
+                "path:setStrokeColor(ColorRGBA(0, 0, 1, 1))\n"
+                "path:setStrokeWidth(3)\n"
+                "path:setMiterLimit(6)\n"
+                "assert(path:hasFill() and path:hasStroke())\n"
+                "assert(path:strokeWidth() == 3 and path:miterLimit() == 6)\n"
+                "path:setVisible(false)\n"
+                "assert(path:isVisible() == false)\n"
+                "assert(path:segmentCount() == 10 and path:curveCount() == 9)\n"
+                "assert(path:isClosed() == false)\n"
+                "assert(math.abs(path:length() - 9 * math.sqrt(5)) < 0.001)\n"
+                "path:setPosition(Vec2(100, 100))\n"
+                "assert(math.abs(path:position().x - 100) < 0.001)\n"
+                "path:translate(Vec2(10, 0))\n"
+                "assert(math.abs(path:position().x - 110) < 0.001)\n"
+                "path:rotateAround(math.pi, path:position())\n"
+                "path:scale(Vec2(2, 2))\n"
+                "local s = path:segment(0)\n"
+                "s:setPosition(Vec2(1, 2))\n"
+                "assert(s:position().x == 1 and s:position().y == 2)\n"
+                //inherited through Item and Document
+                "local group = doc:createGroup()\n"
+                "group:setFillColor(ColorRGBA(0, 1, 0, 1))\n"
+                "doc:setStrokeWidth(2)\n"
+                "assert(doc:strokeWidth() == 2)\n"
+                //overload sets stay checked and keep working
+                "path:setFill('#ff0000')\n"
+                "path:setStroke(ColorRGBA(0, 0, 0, 1))\n"
+                "checkedPath = path\n";
+
+                auto err = luanatic::execute(state, policyTest);
+                if (err)
+                    printf("%s\n", err.message().cString());
+                EXPECT(!err);
+
+#ifndef NDEBUG
+                //builds without NDEBUG keep the checks
+                String debugTest =
+                "assert(not pcall(checkedPath.setStrokeWidth, checkedPath, 'wide'))\n"
+                "assert(not pcall(checkedPath.setFillColor, checkedPath, Vec2(1, 1)))\n";
+
+                err = luanatic::execute(state, debugTest);
+                if (err)
+                    printf("%s\n", err.message().cString());
+                EXPECT(!err);
+#endif //NDEBUG
+
+                //the class tables hold the unchecked functions themselves, mutators included
+                lua_getglobal(state, "paper");
+                lua_getfield(state, -1, "Path");
+                lua_getfield(state, -1, "length");
+                EXPECT(lua_tocfunction(state, -1) == PAPERLUA_UNCHECKED_FUNCTION(&paper::Path::length));
+                lua_pop(state, 1);
+                lua_getfield(state, -1, "setStrokeWidth");
+                EXPECT(lua_tocfunction(state, -1) == PAPERLUA_UNCHECKED_FUNCTION(&paper::Item::setStrokeWidth));
+                lua_pop(state, 3);
+
+                //and still invalidate the caches
+                String mutationTest =
+                "local probe = paper.Document():createPath()\n"
+                "probe:addPoint(Vec2(0, 0))\n"
+                "probe:addPoint(Vec2(10, 0))\n"
+                "assert(math.abs(probe:closestPoints({5, 5})[3] - 5) < 1e-4)\n"
+                "probe:segment(1):setPosition(Vec2(10, 10))\n"
+                "assert(probe:closestPoints({5, 5})[3] < 1e-4)\n"
+                "probe:segment(1):setPositionXY(10, 0)\n"
+                "assert(math.abs(probe:closestPoints({5, 5})[3] - 5) < 1e-4)\n";
+
+                err = luanatic::execute(state, mutationTest);
+                if (err)
+                    printf("%s\n", err.message().cString());
+                EXPECT(!err);
+
+                EXPECT(lua_gettop(state) == 0);
+            }
+            lua_close(state);
+        }
+    },
+    SUITE("Memory Tests")
+    {
+        const Size budget = 32 * 1024 * 1024;
+        lua_State * state = createPooledLuaState(budget);
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+            lua_pushnumber(state, (lua_Number)budget);
+            lua_setglobal(state, "budget");
+
+            String memoryTest =
+            "local mem = paper.memory()\n"
+            "assert(mem.pooled and mem.budget == budget)\n"
+            "assert(mem.current > 0 and mem.peak >= mem.current)\n"
+            "local doc = paper.Document()\n"
+            "for i=1,100 do\n"
+            "    local p = doc:createPath()\n"
+            "    for j=1,100 do p:addPoint(Vec2(j, i)) end\n"
+            "    for s in p:segments() do local pos = s:position() end\n"
+            "end\n"
+            "local after = paper.memory()\n"
+            "assert(after.peak >= after.current and after.peak >= mem.peak)\n"
+            //going over the budget is a regular memory error
+            "local ok, err = pcall(function() local t = {} for i=1,1e8 do t[i] = i end end)\n"
+            "assert(not ok)\n"
+            "collectgarbage()\n"
+            "local collected = paper.memory(true)\n"
+            "assert(collected.peak <= collected.budget and collected.current < collected.peak)\n"
+            "assert(paper.memory().peak < collected.peak)\n"
+            //the state keeps working after the error
+            "doc:createPath():addPoint(Vec2(1, 1))\n";
+
+            auto err = luanatic::execute(state, memoryTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+            detail::PoolAllocator * pool = detail::luaPoolAllocator(state);
+            EXPECT(pool != nullptr);
+            EXPECT(pool->peakBytes() <= budget);
+            EXPECT(lua_gettop(state) == 0);
+        }
+        closePooledLuaState(state);
+
+        //snapshots and curve indices are allocated from the pool as well and stopped by the budget
+        state = createPooledLuaState(8 * 1024 * 1024);
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            String budgetTest =
+            "local doc = paper.Document()\n"
+            "local path = doc:createPath()\n"
+            "for i=1,300000 do path:addPoint(Vec2(i, i % 7)) end\n"
+            "local before = paper.memory().current\n"
+            "local ok, err = pcall(path.snapshot, path)\n"
+            "assert(not ok and err:find('memory'))\n"
+            //the arrays are given back right away
+            "assert(paper.memory().current < before + 1024 * 1024)\n"
+            "ok, err = pcall(path.closestPoints, path, {1, 1})\n"
+            "assert(not ok and err:find('memory'))\n"
+            //smaller ones still fit and are counted
+            "local small = doc:createPath()\n"
+            "for i=1,1000 do small:addPoint(Vec2(i, i % 7)) end\n"
+            "local mem = paper.memory().current\n"
+            "local snapshot = small:snapshot()\n"
+            "assert(paper.memory().current - mem > 999 * 8 * 4)\n"
+            "assert(math.abs(snapshot:length() - small:length()) < 0.1)\n"
+            "small:closestPoints({1, 1})\n";
+
+            auto err = luanatic::execute(state, budgetTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+            EXPECT(lua_gettop(state) == 0);
+        }
+        closePooledLuaState(state);
+
+        //not pooled, only the current size is known
+        state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            registerPaper(state, "paper");
+
+            String memoryTest =
+            "local mem = paper.memory()\n"
+            "assert(not mem.pooled and mem.budget == 0)\n"
+            "assert(mem.current > 0 and mem.peak == mem.current)\n";
+
+            auto err = luanatic::execute(state, memoryTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+            EXPECT(detail::luaPoolAllocator(state) == nullptr);
+        }
+        lua_close(state);
+    },
+    SUITE("FFI View Tests")
+    {
+        lua_State * state = createLuaState();
+        {
+            openStandardLibraries(state);
+            initialize(state);
+            crunchLua::registerCrunch(state);
+            registerPaper(state, "paper");
+
+            //the buffers themselves work on any lua, only the direct access needs the FFI
+            String bufferTest =
+            "assert(type(paper.ffiCdef()) == 'string')\n"
+            "local doc = paper.Document()\n"
+            "path = doc:createPath()\n"
+            "for i=1,100 do path:addPoint(Vec2(i, math.sin(i))) end\n"
+            "path:smooth(paper.Smoothing.Continuous, false)\n"
+            "local copy = doc:createPath()\n"
+            "local buf, view = path:segmentBuffer()\n"
+            "assert(type(view) == 'userdata')\n"
+            "copy:setSegmentBuffer(buf)\n"
+            "assert(copy:segmentCount() == path:segmentCount())\n"
+            "for i=0,path:segmentCount() - 1 do\n"
+            "    local a, b = path:segment(i), copy:segment(i)\n"
+            "    assert(a:position() == b:position() and a:handleIn() == b:handleIn() and a:handleOut() == b:handleOut())\n"
+            "end\n"
+            //refilling reuses the buffer
+            "local small = doc:createPath()\n"
+            "small:addPoint(Vec2(1, 2))\n"
+            "local same = small:segmentBuffer(buf)\n"
+            "assert(same == buf)\n"
+            "copy:setSegmentBuffer(buf, 5)\n"
+            "assert(copy:segment(5):position() == Vec2(1, 2))\n"
+            "assert(not pcall(copy.setSegmentBuffer, copy, {}))\n"
+            "assert(not pcall(copy.setSegmentBuffer, copy, buf, 1000))\n";
+
+            auto err = luanatic::execute(state, bufferTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+
+#ifdef PAPERLUA_USE_LUAJIT
+            String ffiTest =
+            "local ffi = require('ffi')\n"
+            "ffi.cdef(paper.ffiCdef())\n"
+            "local buf, view = path:segmentBuffer()\n"
+            "local v = ffi.cast('PaperLuaSegmentBuffer *', view)\n"
+            "assert(v.count == path:segmentCount() and v.stride == 6)\n"
+            "for i=0,v.count - 1 do\n"
+            "    local s = path:segment(i)\n"
+            "    local d = v.data + i * v.stride\n"
+            "    assert(d[0] == s:position().x and d[1] == s:position().y)\n"
+            "    assert(d[2] == s:handleIn().x and d[5] == s:handleOut().y)\n"
+            "end\n"
+            //writes go through setSegmentBuffer
+            "for i=0,v.count - 1 do v.data[i * v.stride + 1] = v.data[i * v.stride + 1] + 10 end\n"
+            "path:setSegmentBuffer(buf)\n"
+            "for i=0,v.count - 1 do assert(path:segment(i):position().y == v.data[i * v.stride + 1]) end\n"
+            "local snap = path:snapshot()\n"
+            "local sv = snap:ffiView()\n"
+            "local s = ffi.cast('const PaperLuaSnapshotView *', sv)\n"
+            "assert(s.curveCount == snap:curveCount() and s.pointCount == s.curveCount * 3 + 1)\n"
+            "assert(s.closed == 0 and s.sampleCount == s.curveCount * s.samplesPerCurve)\n"
+            "assert(math.abs(s.lengths[s.sampleCount] - snap:length()) < 0.001)\n"
+            "for i=0,path:segmentCount() - 1 do\n"
+            "    local pos = path:segment(i):position()\n"
+            "    assert(s.x[i * 3] == pos.x and s.y[i * 3] == pos.y)\n"
+            "end\n"
+            //the views keep the snapshot and the buffer they point into alive
+            "local sv2 = path:snapshot():ffiView()\n"
+            "local _, bv2 = path:segmentBuffer()\n"
+            "collectgarbage()\n"
+            "collectgarbage()\n"
+            "local s2 = ffi.cast('const PaperLuaSnapshotView *', sv2)\n"
+            "assert(math.abs(s2.lengths[s2.sampleCount] - snap:length()) < 0.001)\n"
+            "local v2 = ffi.cast('PaperLuaSegmentBuffer *', bv2)\n"
+            "assert(v2.count == path:segmentCount() and v2.data[1] == path:segment(0):position().y)\n";
+
+            err = luanatic::execute(state, ffiTest);
+            if (err)
+                printf("%s\n", err.message().cString());
+            EXPECT(!err);
+#endif //PAPERLUA_USE_LUAJIT
+
+            EXPECT(lua_gettop(state) == 0);
+        }
+        lua_close(state);
+    },
     SUITE("Path Tests")
     {
         // lua_State * state = createLuaState();
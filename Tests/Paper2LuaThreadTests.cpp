@@ -0,0 +1,125 @@
+#include <Stick/Test.hpp>
+#include <Paper2Lua/ScriptRunner.hpp>
+#include <CrunchLua/CrunchLua.hpp>
+
+#include <chrono>
+#include <cstdio>
+
+using namespace stick;
+using namespace paperLua;
+
+static void registerCrunch(lua_State * _state)
+{
+    crunchLua::registerCrunch(_state);
+}
+
+static DynamicArray<ScriptJob> makeJobs(Size _count, const String & _chunk)
+{
+    DynamicArray<ScriptJob> ret;
+    ret.resize(_count);
+    for (Size i = 0; i < _count; ++i)
+    {
+        ret[i].chunk = _chunk;
+        ret[i].name = "job";
+        char input[32];
+        snprintf(input, sizeof(input), "%lu", (unsigned long)(i + 1));
+        ret[i].input = input;
+    }
+    return ret;
+}
+
+const Suite spec[] =
+{
+    SUITE("Script Runner Tests")
+    {
+        String chunk =
+        "local r = tonumber(input)\n"
+        "local c = document:createCircle(Vec2(100, 100), r)\n"
+        "leaked = c\n"
+        "local n = 0\n"
+        "for _ in document:children() do n = n + 1 end\n"
+        "assert(n == 1)\n"
+        "return string.format('%.4f', c:area())\n";
+
+        DynamicArray<ScriptJob> jobs = makeJobs(64, chunk);
+
+        //one job that fails to compile and one that fails while running
+        jobs[10].chunk = "return (";
+        jobs[20].chunk = "error('failed on purpose')";
+
+        ScriptRunner runner(4, registerCrunch);
+        EXPECT(runner.threadCount() == 4);
+        DynamicArray<ScriptResult> results = runner.run(jobs);
+        EXPECT(results.count() == jobs.count());
+
+        ScriptRunner single(1, registerCrunch);
+        DynamicArray<ScriptResult> expected = single.run(jobs);
+
+        for (Size i = 0; i < results.count(); ++i)
+        {
+            EXPECT(results[i].bSuccess == expected[i].bSuccess);
+            EXPECT(results[i].output == expected[i].output);
+            if (i == 10 || i == 20)
+            {
+                EXPECT(!results[i].bSuccess);
+                EXPECT(!results[i].error.isEmpty());
+            }
+            else
+            {
+                if (!results[i].bSuccess)
+                    printf("%s\n", results[i].error.cString());
+                EXPECT(results[i].bSuccess);
+                EXPECT(!results[i].output.isEmpty());
+            }
+        }
+
+        //globals of one job must not leak into the next one and the pool can be reused
+        DynamicArray<ScriptJob> leakJobs = makeJobs(16, "assert(leaked == nil)\nreturn document:exportSVG()");
+        DynamicArray<ScriptResult> leakResults = runner.run(leakJobs);
+        for (const ScriptResult & res : leakResults)
+        {
+            if (!res.bSuccess)
+                printf("%s\n", res.error.cString());
+            EXPECT(res.bSuccess);
+        }
+
+        EXPECT(runner.run(DynamicArray<ScriptJob>()).count() == 0);
+    },
+    SUITE("Script Runner Scaling")
+    {
+        String chunk =
+        "local total = 0\n"
+        "for i=1,200 do\n"
+        "    local c = document:createCircle(Vec2(i, tonumber(input)), 10 + i % 7)\n"
+        "    local positions = c:sampleUniform(64)\n"
+        "    total = total + c:length() + positions[1]\n"
+        "end\n"
+        "return total\n";
+
+        DynamicArray<ScriptJob> jobs = makeJobs(256, chunk);
+        Size hardwareThreads = detail::hardwareThreadCount();
+        double baseline = 0;
+        for (Size threads = 1; ; threads = std::min(threads * 2, hardwareThreads))
+        {
+            ScriptRunner runner(threads, registerCrunch);
+            auto start = std::chrono::high_resolution_clock::now();
+            DynamicArray<ScriptResult> results = runner.run(jobs);
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            for (const ScriptResult & res : results)
+                EXPECT(res.bSuccess);
+
+            double jobsPerSecond = jobs.count() / elapsed.count();
+            if (threads == 1)
+                baseline = jobsPerSecond;
+            printf("%lu threads: %.1f jobs/s, speedup %.2fx\n", (unsigned long)threads, jobsPerSecond, jobsPerSecond / baseline);
+
+            if (threads == hardwareThreads)
+                break;
+        }
+    }
+};
+
+int main(int _argc, const char * _args[])
+{
+    return runTests(spec, _argc, _args);
+}